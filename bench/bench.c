@@ -0,0 +1,585 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <raylib.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "compile.h"
+#include "environment.h"
+#include "expression.h"
+#include "kernels.h"
+#include "parametric.h"
+#include "parser.h"
+#include "render.h"
+#include "sampler.h"
+
+// Benchmark settings
+#define BENCH_SAMPLES     1281 // One frame worth of columns
+#define BENCH_MIN_TIME    0.2  // Seconds spent per evaluation measurement
+#define BENCH_ZOOM_STEPS  13   // Zoom levels swept from ZOOM_MIN_LIMIT to BENCH_ZOOM_MAX
+#define BENCH_ZOOM_MAX    1e3  // Deepest zoom swept around the origin, where floats were still enough
+#define BENCH_DEEP_STEPS  5    // Zoom levels from 1 to ZOOM_MAX_LIMIT measured around BENCH_DEEP_X
+#define BENCH_DEEP_X      1.3  // Point deep zooms are centered on, a pixel is a tiny fraction of it
+#define BENCH_FRAMES      120  // Frames timed per sampling or drawing measurement
+#define BENCH_PAN_PIXELS  PAN_SHORTCUT_SENSITIVITY // Screen pixels panned per frame
+#define BENCH_MAX_UPDATES 64   // Sampler updates before a cold start counts as settled
+#define BENCH_DEEP_DEGREE 40   // Degree of the generated polynomial
+#define BENCH_DEEP_NEST   24   // Depth of the generated function chain
+#define BENCH_CURVE_STEPS 3    // Zoom levels from 1 to BENCH_CURVE_ZOOM measured around the origin
+#define BENCH_CURVE_ZOOM  1e4  // Deepest zoom of parametric and polar curves
+#define BENCH_UNIFORM_MAX (1 << 20) // Most evenly spaced parameter values tried for the same tolerance
+#define BENCH_CURVE_REACH 1e6  // Views beyond each edge a compared segment may reach, poles send it further
+
+// Generated expressions with deep trees
+static char deep_polynomial[1024];
+static char deep_nest[1024];
+
+// Expressions grouped by the kind of work they stress
+static const struct {
+    const char *class;
+    const char *text;
+} corpus[] = {
+    {"arithmetic",         "3*x*x*x - 2*x*x + x - 7"},
+    {"polynomial",         "x^5 - 4*x^4 + 2*x^3 + x^2 - 9*x + 1"},
+    {"rational",           "(x*x + 1) / (x - 2)"},
+    {"asymptotes",         "1 / (x*x - 4) + 1 / sin(x)"},
+    {"pow",                "x^3 - 2^x + x^0.5"},
+    {"nested pow",         "(x^2 + 1)^(1 / (abs(x) + 1))"},
+    {"trig",               "sin(x) + cos(2*x)"},
+    {"tan",                "tan(x)"},
+    {"exp/log",            "exp(-x*x) + ln(abs(x) + 1)"},
+    {"inverse trig",       "arctan(x) + arcsin(x / 10)"},
+    {"nested",             "sin(cos(tan(x))) * sqrt(abs(x))"},
+    {"deep polynomial",    deep_polynomial},
+    {"deep nest",          deep_nest},
+};
+
+#define CORPUS_SIZE ((int)(sizeof(corpus) / sizeof(corpus[0])))
+
+// Related curves plotted together, sharing most of their subexpressions
+static const char *family[] = {
+    "sin(x)",
+    "sin(x)^2",
+    "2*sin(x) + x",
+    "sin(x)^2 + cos(x)^2",
+    "exp(-x*x) * sin(x)",
+    "exp(-x*x) * cos(x) + 2*3",
+};
+
+#define FAMILY_SIZE ((int)(sizeof(family) / sizeof(family[0])))
+
+// Parametric and polar curves, tight loops and long straight runs
+static const struct {
+    const char *class;
+    const char *text;
+} curves[] = {
+    {"lissajous",  "(cos(3t), sin(2t))"},
+    {"rose",       "r = cos(4theta)"},
+    {"cardioid",   "r = 1 + cos(theta)"},
+    {"spiral",     "(t*cos(8*t)/4, t*sin(8*t)/4)"},
+    {"epicycloid", "(5*cos(t) - cos(5*t), 5*sin(t) - sin(5*t))"},
+    {"tan",        "(t, tan(t))"},
+};
+
+#define CURVES_SIZE ((int)(sizeof(curves) / sizeof(curves[0])))
+
+// Heap allocations made anywhere in the process, counted by wrapping the allocator at link time
+static atomic_long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_realloc(pointer, size);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool build_deep_corpus(void) {
+    // Horner form, every coefficient adds a multiply and an add
+    strcpy(deep_polynomial, "1");
+    for (int i = 1; i <= BENCH_DEEP_DEGREE; i++) {
+        char text[sizeof(deep_polynomial)];
+        int length = snprintf(text, sizeof(text), "(%s)*x %c %g", deep_polynomial, i % 2 ? '-' : '+', 1.0 / i);
+        if (length < 0 || length >= (int)sizeof(text)) return false;
+        strcpy(deep_polynomial, text);
+    }
+
+    // Alternating calls wrapped around a single variable
+    char *end = deep_nest;
+    for (int i = 0; i < BENCH_DEEP_NEST; i++) end += sprintf(end, "%s(", i % 2 ? "cos" : "sin");
+    end += sprintf(end, "x");
+    for (int i = 0; i < BENCH_DEEP_NEST; i++) *end++ = ')';
+    *end = '\0';
+
+    return true;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_percentiles(double *times, int count) {
+    // Nearest rank percentiles of frame times, in milliseconds
+    qsort(times, count, sizeof(double), compare_doubles);
+    printf("{\"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+           times[(count - 1) * 50 / 100] * 1e3, times[(count - 1) * 90 / 100] * 1e3,
+           times[(count - 1) * 99 / 100] * 1e3, times[count - 1] * 1e3);
+}
+
+static void print_string(const char *text) {
+    putchar('"');
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') putchar('\\');
+        putchar(*text);
+    }
+    putchar('"');
+}
+
+static double bench_tree(Node *root, SymbolTable *symbol_table, const double *xs, double *ys) {
+    // Repeat whole columns until the minimum time has passed
+    long samples = 0;
+    double start = now(), elapsed;
+
+    do {
+        for (int i = 0; i < BENCH_SAMPLES; i++) {
+            symbol_table_set(symbol_table, "x", 1, xs[i]);
+            ys[i] = env_evaluate(root, symbol_table);
+        }
+        samples += BENCH_SAMPLES;
+    } while ((elapsed = now() - start) < BENCH_MIN_TIME);
+
+    return elapsed * 1e9 / samples;
+}
+
+static double bench_program(Program *program, const double *xs, double *ys) {
+    long samples = 0;
+    double start = now(), elapsed;
+
+    do {
+        program_evaluate(program, xs, ys, BENCH_SAMPLES);
+        samples += BENCH_SAMPLES;
+    } while ((elapsed = now() - start) < BENCH_MIN_TIME);
+
+    return elapsed * 1e9 / samples;
+}
+
+static int count_mismatches(const double *expected, const double *actual) {
+    // Plotting works on floats, so compare at that precision
+    int mismatches = 0;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        float a = (float)expected[i], b = (float)actual[i];
+        if (isnan(a) && isnan(b)) continue;
+        if (a != b) mismatches++;
+    }
+
+    return mismatches;
+}
+
+static void bench_evaluation(ParsedExpression *expressions, SymbolTable *symbol_table) {
+    // Columns spanning the default view
+    static double xs[BENCH_SAMPLES], expected[BENCH_SAMPLES], ys[BENCH_SAMPLES];
+    for (int i = 0; i < BENCH_SAMPLES; i++) xs[i] = -10.24 + i * (20.48 / (BENCH_SAMPLES - 1));
+
+    printf("  \"evaluation\": [\n");
+
+    for (int c = 0; c < CORPUS_SIZE; c++) {
+        ParsedExpression *expression = &expressions[c];
+
+        printf("    {\"class\": ");
+        print_string(corpus[c].class);
+        printf(", \"expression\": ");
+        print_string(corpus[c].text);
+        printf(", \"tree_ns\": %.3f, \"kernels\": {", bench_tree(expression->root, symbol_table, xs, expected));
+
+        // Times are per sample, mismatches count floats differing from the tree walk
+        Program interpreted = expression->program;
+        interpreted.native = NULL;
+        bool first = true;
+        for (int level = 0; level < KERNELS_COUNT && expression->compiled; level++) {
+            kernels = kernels_get((KernelLevel)level);
+            if (kernels == NULL) continue;
+
+            double time = bench_program(&interpreted, xs, ys);
+            printf("%s\"%s\": {\"ns\": %.3f, \"mismatches\": %d}", first ? "" : ", ", kernels->name, time,
+                   count_mismatches(expected, ys));
+            first = false;
+        }
+        kernels_init(false);
+
+        // Native code calls the kernels it was generated with, the fastest ones
+        printf("}");
+        if (expression->compiled && expression->program.native != NULL) {
+            double time = bench_program(&expression->program, xs, ys);
+            printf(", \"jit\": {\"ns\": %.3f, \"mismatches\": %d}", time, count_mismatches(expected, ys));
+        }
+
+        printf("}%s\n", c + 1 < CORPUS_SIZE ? "," : "");
+    }
+
+    printf("  ],\n");
+}
+
+static double bench_shared(Program *program, const double *xs, double *ys) {
+    long samples = 0;
+    double start = now(), elapsed;
+
+    do {
+        program_evaluate_shared(program, xs, ys, BENCH_SAMPLES, BENCH_SAMPLES);
+        samples += BENCH_SAMPLES;
+    } while ((elapsed = now() - start) < BENCH_MIN_TIME);
+
+    return elapsed * 1e9 / samples;
+}
+
+static void bench_sharing(Parser *parser) {
+    static double xs[BENCH_SAMPLES], ys[FAMILY_SIZE * BENCH_SAMPLES];
+    for (int i = 0; i < BENCH_SAMPLES; i++) xs[i] = -10.24 + i * (20.48 / (BENCH_SAMPLES - 1));
+
+    // Every curve compiled on its own, then all of them as one program
+    Node *roots[FAMILY_SIZE];
+    Program programs[FAMILY_SIZE];
+    double separate = 0.0;
+    for (int i = 0; i < FAMILY_SIZE; i++) {
+        roots[i] = parser_parse(parser, family[i]);
+        if (!program_compile(&programs[i], roots[i])) {
+            fprintf(stderr, "Unable to compile '%s'\n", family[i]);
+            return;
+        }
+
+        separate += bench_program(&programs[i], xs, ys);
+        program_free(&programs[i]);
+    }
+
+    Program shared;
+    ProgramSharing sharing;
+    if (!program_compile_shared(&shared, roots, NULL, FAMILY_SIZE, &sharing)) return;
+
+    // Times are per x value, covering every curve
+    printf("  \"sharing\": {\"expressions\": %d, \"tree_nodes\": %d, \"nodes\": %d, \"folded\": %d, "
+           "\"separate_ns\": %.3f, \"shared_ns\": %.3f},\n",
+           FAMILY_SIZE, sharing.tree_nodes, sharing.nodes, sharing.folded, separate, bench_shared(&shared, xs, ys));
+
+    program_free(&shared);
+}
+
+static SampleView centered_view(double zoom, double offset_x) {
+    // Screen sized region around the origin, as the window sees it at the given zoom
+    double scale = GRID_PIXELS_PER_UNIT * zoom;
+    return (SampleView){
+        .min_x = (offset_x - WIDTH / 2.0) / scale,
+        .max_x = (offset_x + WIDTH / 2.0) / scale,
+        .min_y = -HEIGHT / 2.0 / scale,
+        .max_y = HEIGHT / 2.0 / scale,
+        .scale = scale,
+    };
+}
+
+static void bench_sampling(ParsedExpression *expressions) {
+    static double times[BENCH_FRAMES];
+
+    printf("  \"sampling\": [\n");
+
+    for (int step = 0; step < BENCH_ZOOM_STEPS; step++) {
+        double zoom = ZOOM_MIN_LIMIT * pow(BENCH_ZOOM_MAX / ZOOM_MIN_LIMIT, step / (BENCH_ZOOM_STEPS - 1.0));
+        SampleView view = centered_view(zoom, 0.0);
+
+        // Cold start, every curve sampled from an empty cache until nothing is left to refine
+        long cold_evaluations = 0, settle_evaluations = 0;
+        int settle_frames = 0;
+        double cold_time = 0.0, settle_time = 0.0;
+
+        for (int c = 0; c < CORPUS_SIZE; c++) sample_cache_free(&expressions[c].cache);
+
+        for (int frame = 0; frame < BENCH_MAX_UPDATES; frame++) {
+            long evaluations = 0;
+            double start = now();
+            for (int c = 0; c < CORPUS_SIZE; c++) evaluations += sampler_update(&expressions[c], view, 0.0);
+            double elapsed = now() - start;
+
+            if (frame == 0) {
+                cold_time = elapsed;
+                cold_evaluations = evaluations;
+            }
+            if (evaluations == 0) break;
+
+            settle_time += elapsed;
+            settle_evaluations += evaluations;
+            settle_frames++;
+        }
+
+        // Steady panning, only newly exposed columns and their intervals are evaluated
+        long pan_evaluations = 0, pan_allocations = 0;
+        double pan_time = 0.0;
+
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            view = centered_view(zoom, (frame + 1) * BENCH_PAN_PIXELS);
+
+            long evaluations = 0, allocated = atomic_load(&allocations);
+            double start = now();
+            for (int c = 0; c < CORPUS_SIZE; c++) evaluations += sampler_update(&expressions[c], view, 0.0);
+            times[frame] = now() - start;
+
+            pan_allocations += atomic_load(&allocations) - allocated;
+            pan_evaluations += evaluations;
+            pan_time += times[frame];
+        }
+
+        printf("    {\"zoom\": %g, ", zoom);
+        printf("\"cold\": {\"ms\": %.4f, \"evaluations\": %ld, \"settle_ms\": %.4f, \"settle_frames\": %d, "
+               "\"settle_evaluations\": %ld}, ",
+               cold_time * 1e3, cold_evaluations, settle_time * 1e3, settle_frames, settle_evaluations);
+        printf("\"pan\": {\"frame_ms\": ");
+        print_percentiles(times, BENCH_FRAMES);
+        printf(", \"evaluations_per_frame\": %.1f, \"ns_per_sample\": %.3f, \"allocations_per_frame\": %.2f}}%s\n",
+               (double)pan_evaluations / BENCH_FRAMES, pan_evaluations > 0 ? pan_time * 1e9 / pan_evaluations : 0.0,
+               (double)pan_allocations / BENCH_FRAMES, step + 1 < BENCH_ZOOM_STEPS ? "," : "");
+    }
+
+    printf("  ],\n");
+}
+
+static SampleView deep_view(double zoom, double offset_x, double y) {
+    // Same region moved onto a point of the curve away from the origin
+    SampleView view = centered_view(zoom, offset_x);
+    view.min_x += BENCH_DEEP_X;
+    view.max_x += BENCH_DEEP_X;
+    view.min_y += y;
+    view.max_y += y;
+    return view;
+}
+
+static void bench_deep_zoom(ParsedExpression *expressions) {
+    static double times[BENCH_FRAMES];
+
+    // Each curve is followed at its own height, so it stays in view however far the zoom goes
+    double x = BENCH_DEEP_X, ys[CORPUS_SIZE];
+    for (int c = 0; c < CORPUS_SIZE; c++) {
+        expression_evaluate(&expressions[c], &x, &ys[c], 1);
+        if (!isfinite(ys[c])) ys[c] = 0.0;
+    }
+
+    printf("  \"deep_zoom\": [\n");
+
+    for (int step = 0; step < BENCH_DEEP_STEPS; step++) {
+        double zoom = pow(ZOOM_MAX_LIMIT, step / (BENCH_DEEP_STEPS - 1.0));
+
+        // Cold start, a single update of every curve from an empty cache
+        long cold_evaluations = 0;
+        for (int c = 0; c < CORPUS_SIZE; c++) sample_cache_free(&expressions[c].cache);
+
+        double start = now();
+        for (int c = 0; c < CORPUS_SIZE; c++)
+            cold_evaluations += sampler_update(&expressions[c], deep_view(zoom, 0.0, ys[c]), 0.0);
+        double cold_time = now() - start;
+
+        // Steady panning by a few pixels, which are tiny offsets from the point when zoomed in
+        long pan_evaluations = 0;
+        double pan_time = 0.0;
+
+        for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+            long evaluations = 0;
+            start = now();
+            for (int c = 0; c < CORPUS_SIZE; c++) {
+                SampleView view = deep_view(zoom, (frame + 1) * BENCH_PAN_PIXELS, ys[c]);
+                evaluations += sampler_update(&expressions[c], view, 0.0);
+            }
+            times[frame] = now() - start;
+
+            pan_evaluations += evaluations;
+            pan_time += times[frame];
+        }
+
+        printf("    {\"zoom\": %g, \"cold\": {\"ms\": %.4f, \"evaluations\": %ld}, \"pan\": {\"frame_ms\": ",
+               zoom, cold_time * 1e3, cold_evaluations);
+        print_percentiles(times, BENCH_FRAMES);
+        printf(", \"evaluations_per_frame\": %.1f, \"ns_per_sample\": %.3f}}%s\n",
+               (double)pan_evaluations / BENCH_FRAMES, pan_evaluations > 0 ? pan_time * 1e9 / pan_evaluations : 0.0,
+               step + 1 < BENCH_DEEP_STEPS ? "," : "");
+    }
+
+    printf("  ],\n");
+}
+
+static bool reaches_view(const CurveSample *a, const CurveSample *middle, const CurveSample *b, SampleView view) {
+    // Bounds of the three points overlap the view without reaching too far past it
+    double min_x = fmin(fmin(a->x, middle->x), b->x), max_x = fmax(fmax(a->x, middle->x), b->x);
+    double min_y = fmin(fmin(a->y, middle->y), b->y), max_y = fmax(fmax(a->y, middle->y), b->y);
+    double reach_x = (view.max_x - view.min_x) * BENCH_CURVE_REACH;
+    double reach_y = (view.max_y - view.min_y) * BENCH_CURVE_REACH;
+
+    return max_x >= view.min_x && min_x <= view.max_x && max_y >= view.min_y && min_y <= view.max_y &&
+           min_x >= view.min_x - reach_x && max_x <= view.max_x + reach_x &&
+           min_y >= view.min_y - reach_y && max_y <= view.max_y + reach_y;
+}
+
+static bool uniform_within_tolerance(ParsedExpression *expression, SampleView view, int count) {
+    // Every segment reaching the view has its middle within tolerance of the chord
+    double step = (PARAMETRIC_T_MAX - PARAMETRIC_T_MIN) / count, t = PARAMETRIC_T_MIN;
+    CurveSample previous;
+    expression_evaluate_curve(expression, &t, &previous, 1);
+
+    for (int i = 1; i <= count; i++) {
+        double ts[] = {PARAMETRIC_T_MIN + (i - 0.5) * step, PARAMETRIC_T_MIN + i * step};
+        CurveSample samples[2];
+        expression_evaluate_curve(expression, ts, samples, 2);
+
+        CurveSample a = previous, middle = samples[0], b = samples[1];
+        previous = b;
+        if (!isfinite(a.y + b.y + middle.y + a.x + b.x + middle.x) || !reaches_view(&a, &middle, &b, view)) continue;
+
+        double dx = b.x - a.x, dy = b.y - a.y, length = dx * dx + dy * dy;
+        double s = length > 0.0 ? fmin(fmax(((middle.x - a.x) * dx + (middle.y - a.y) * dy) / length, 0.0), 1.0) : 0.0;
+        if (hypot(middle.x - a.x - s * dx, middle.y - a.y - s * dy) * view.scale > SAMPLE_TOLERANCE) return false;
+    }
+
+    return true;
+}
+
+static void bench_curves(Parser *parser) {
+    printf("  \"curves\": [\n");
+
+    for (int c = 0; c < CURVES_SIZE; c++) {
+        ParsedExpression expression = {0};
+        expression_parse(&expression, parser, curves[c].text);
+        printf("    {\"class\": \"%s\", \"zooms\": [", curves[c].class);
+
+        for (int step = 0; step < BENCH_CURVE_STEPS; step++) {
+            double zoom = pow(BENCH_CURVE_ZOOM, step / (BENCH_CURVE_STEPS - 1.0));
+            SampleView view = centered_view(zoom, 0.0);
+
+            double start = now();
+            int evaluations = parametric_update(&expression, view);
+            double time = now() - start;
+
+            // Evenly spaced parameter values needed to draw the view as closely, doubled until they do
+            int uniform = PARAMETRIC_SEEDS;
+            while (uniform < BENCH_UNIFORM_MAX && !uniform_within_tolerance(&expression, view, uniform)) uniform *= 2;
+
+            printf("{\"zoom\": %g, \"ms\": %.4f, \"evaluations\": %d, \"uniform_evaluations\": %d}%s", zoom,
+                   time * 1e3, evaluations, uniform + 1, step + 1 < BENCH_CURVE_STEPS ? ", " : "");
+        }
+
+        printf("]}%s\n", c + 1 < CURVES_SIZE ? "," : "");
+        expression_free(&expression);
+    }
+
+    printf("  ],\n");
+}
+
+static void bench_layer(const char *name, void (*draw)(Image *image, RenderJob *job), Image *image, RenderJob *job,
+                        bool last) {
+    static double times[BENCH_FRAMES];
+    long allocated = atomic_load(&allocations);
+
+    // Pan between frames so labels and line positions change as they would on screen
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        double offset = frame * BENCH_PAN_PIXELS / GRID_PIXELS_PER_UNIT;
+        job->min_x = -WIDTH / 2.0 / GRID_PIXELS_PER_UNIT + offset;
+        job->max_x = WIDTH / 2.0 / GRID_PIXELS_PER_UNIT + offset;
+
+        double start = now();
+        draw(image, job);
+        times[frame] = now() - start;
+    }
+
+    printf("    \"%s\": {\"frame_ms\": ", name);
+    print_percentiles(times, BENCH_FRAMES);
+    printf(", \"allocations_per_frame\": %.2f}%s\n", (double)(atomic_load(&allocations) - allocated) / BENCH_FRAMES,
+           last ? "" : ",");
+}
+
+static void draw_curves(Image *image, RenderJob *job) {
+    for (int i = 0; i < job->count; i++) render_curve(image, job, &job->expressions[i]);
+}
+
+static void bench_drawing(ParsedExpression *expressions) {
+    // The window's layers need a GPU, their software counterparts share the same layout and text
+    RenderJob job = {
+        .min_y = -HEIGHT / 2.0 / GRID_PIXELS_PER_UNIT,
+        .max_y = HEIGHT / 2.0 / GRID_PIXELS_PER_UNIT,
+        .width = WIDTH,
+        .height = HEIGHT,
+        .expressions = expressions,
+        .count = CORPUS_SIZE,
+    };
+    Image image = GenImageColor(WIDTH, HEIGHT, COLOR_BLACK);
+
+    printf("  \"drawing\": {\n");
+    bench_layer("grid", render_grid, &image, &job, false);
+    bench_layer("curves", draw_curves, &image, &job, false);
+    bench_layer("grid_labels", render_grid_labels, &image, &job, false);
+    bench_layer("legend", render_legend, &image, &job, true);
+    printf("  }\n");
+
+    UnloadImage(image);
+}
+
+int main(void) {
+    // Only the JSON report goes to stdout
+    SetTraceLogLevel(LOG_NONE);
+    kernels_init(false);
+    if (!build_deep_corpus()) {
+        fprintf(stderr, "Unable to fit a degree %d polynomial in the deep corpus\n", BENCH_DEEP_DEGREE);
+        return 1;
+    }
+
+    Parser parser = parser_init();
+    SymbolTable symbol_table = symbol_table_init();
+    Color colors[] = COLOR_POOL;
+
+    ParsedExpression expressions[CORPUS_SIZE] = {0};
+    for (int c = 0; c < CORPUS_SIZE; c++) {
+        ParsedExpression *expression = &expressions[c];
+        *expression = (ParsedExpression){
+            .text = corpus[c].text,
+            .root = parser_parse(&parser, corpus[c].text),
+            .color = colors[c % (sizeof(colors) / sizeof(colors[0]))],
+            .visible = true,
+        };
+
+        if (expression->root == NULL) {
+            fprintf(stderr, "Unable to parse '%s'\n", corpus[c].text);
+            return 1;
+        }
+        if (!expression_compile(expression)) fprintf(stderr, "Unable to compile '%s'\n", corpus[c].text);
+    }
+
+    printf("{\n");
+    bench_evaluation(expressions, &symbol_table);
+    bench_sharing(&parser);
+    bench_sampling(expressions);
+    bench_deep_zoom(expressions);
+    bench_curves(&parser);
+    bench_drawing(expressions);
+    printf("}\n");
+
+    for (int c = 0; c < CORPUS_SIZE; c++) expression_free(&expressions[c]);
+    expression_thread_free();
+    symbol_table_free(&symbol_table);
+    parser_free(&parser);
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include "expression.h"
+
+// Points of interest found on curves
+typedef enum {
+    FEATURE_ROOT,
+    FEATURE_MINIMUM,
+    FEATURE_MAXIMUM,
+    FEATURE_INTERSECTION, // Between two curves
+} FeatureKind;
+
+typedef struct {
+    FeatureKind kind;
+    double x, y; // Math units
+    int curve;   // Expression the feature lies on
+    int other;   // Second expression of an intersection, -1 otherwise
+    Color color;
+} Feature;
+
+/**
+ * Set up analysis of the plotted expressions, with markers shown.
+ */
+void analysis_init(ParsedExpression *expressions, int count);
+
+/**
+ * Publish features found by the last scan, then scan the parts of the view not scanned yet at a similar zoom
+ * on the worker pool. Only visible functions whose samples are settled are scanned, for roots and extrema
+ * of each and intersections of each pair. Never waits for the pool.
+ */
+void analysis_schedule(SampleView view);
+
+/**
+ * Check whether scans are running or their features are waiting to be published.
+ */
+bool analysis_pending(void);
+
+/**
+ * Get the published features of visible curves.
+ */
+const Feature *analysis_features(int *count);
+
+/**
+ * Get the name of a kind of feature.
+ */
+const char *analysis_kind_name(FeatureKind kind);
+
+/**
+ * Forget the features of an expression about to change. Scans it's part of may evaluate it, so they're cancelled
+ * and waited for, which takes at most a step of their solver. Scans of other curves keep running.
+ */
+void analysis_invalidate(int index);
+
+/**
+ * Show or hide markers, curves aren't scanned while they're hidden.
+ */
+void analysis_toggle_markers(void);
+
+/**
+ * Check whether markers are shown.
+ */
+bool analysis_markers_shown(void);
+
+/**
+ * Cancel the running scans, wait for them and free every feature. Must be called before the expressions are freed.
+ */
+void analysis_free(void);
+
+#endif
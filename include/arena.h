@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Chain of heap blocks handing out memory by bumping an offset, freed all at once
+typedef struct ArenaBlock {
+    struct ArenaBlock *next; // Previously filled block
+    size_t size;
+    size_t used;
+    max_align_t data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;   // Block being filled
+    size_t block_size;  // Smallest block allocated
+    size_t total;       // Bytes handed out since the last reset
+} Arena;
+
+// Expression trees' companions and everything else living as long as the window
+extern Arena persistent_arena;
+
+// Scratch memory of the render thread, reset at the start of every frame
+extern Arena frame_arena;
+
+/**
+ * Set up an empty arena taking blocks of at least `block_size` bytes.
+ */
+void arena_init(Arena *arena, size_t block_size);
+
+/**
+ * Get `size` bytes aligned for any type, valid until the arena is reset or freed.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * Get a zeroed array of `count` elements of `size` bytes.
+ */
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+
+/**
+ * Copy a string into the arena.
+ */
+char *arena_strdup(Arena *arena, const char *text);
+
+/**
+ * Release everything at once. Blocks are merged into one as large as all of them,
+ * so an arena reset every frame stops touching the heap once it has seen its largest frame.
+ */
+void arena_reset(Arena *arena);
+
+/**
+ * Free every block.
+ */
+void arena_free(Arena *arena);
+
+#endif
@@ -2,15 +2,22 @@
 #define COMMON_H
 
 // Window parameters
-#define WIDTH   1280
+#define WIDTH   1280 // Initial size in screen coordinates, and the default size of headless renders
 #define HEIGHT  720
 #define FPS     60
 
+// Display quality settings
+#define QUALITY_DEFAULT      1.0f        // Samples per framebuffer pixel, columns are SAMPLE_COLUMN_STEP apart
+#define QUALITY_MIN          0.25f       // Lowest quality slow frames lower it to
+#define QUALITY_FRAME_BUDGET (1.0 / FPS) // Seconds a drawn frame may take before the quality is lowered
+#define QUALITY_SLOW_FRAMES  4           // Drawn frames in a row over budget that halve the quality
+#define QUALITY_FAST_FRAMES  30          // Drawn frames in a row under half the budget that double it back
+
 // Camera settings
 #define CAMERA_INITIAL_ZOOM     1.0f
 #define CAMERA_INITIAL_ROTATION 0.0f
 #define CAMERA_INITIAL_TARGET   (Vector2){0, 0}
-#define CAMERA_OFFSET_CENTER    (Vector2){WIDTH / 2.0f, HEIGHT / 2.0f}
+#define CAMERA_REBASE_PIXELS    65536.0f // Screen pixels between target and world origin before the origin moves
 
 // Translate config
 #define PAN_SENSITIVITY          1.0f
@@ -20,38 +27,128 @@
 #define ZOOM_SENSITIVITY          0.15f
 #define ZOOM_SHORTCUT_SENSITIVITY 0.08f
 #define ZOOM_MIN_LIMIT            0.001f
-#define ZOOM_MAX_LIMIT            1000.0f
+#define ZOOM_MAX_LIMIT            1e12f // Doubles place points around the unit square to a fraction of a pixel
 
 // Grid config
 #define GRID_INITIAL_SPACING 50.0f // Pixels
 #define GRID_MIN_SPACING     30.0f
 #define GRID_MAX_SPACING     70.0f
 #define GRID_UNITS_PER_SPACE 0.4f // Math units per spacing in pixels
+#define GRID_PIXELS_PER_UNIT (GRID_INITIAL_SPACING / GRID_UNITS_PER_SPACE) // World pixels per math unit at zoom 1
 #define GRID_MAJOR_STEP      5
 #define GRID_MINOR_OPACITY   51  // 20%
 #define GRID_MAJOR_OPACITY   153 // 60%
-#define GRID_RENDER_BUFFER   2.0f
-#define GRID_AXIS_THRESHOLD  0.001f
+#define GRID_CACHE_MARGIN    256 // Pixels rasterized beyond each screen edge
 
 // Grid label config
 #define GRID_LABEL_SIZE         20
 #define GRID_LABEL_OFFSET       5.0f
 #define GRID_LABEL_CLAMP_OFFSET 10.0f
+#define GRID_LABEL_CACHE_SIZE   256 // Formatted labels kept
+#define GRID_LABEL_DIGITS       4   // Significant digits of the step between labels shown
 
 // Coords display config
-#define COORDS_DISPLAY_SIZE    20
-#define COORDS_DISPLAY_SPACING 2
-#define COORDS_DISPLAY_OFFSET  35
+#define COORDS_DISPLAY_SIZE     20
+#define COORDS_DISPLAY_SPACING  2
+#define COORDS_DISPLAY_OFFSET   35
+#define COORDS_DISPLAY_DECIMALS 4 // Fewest decimals shown, more once a pixel is smaller
 
 // Graphing settings
-#define ASYMPTOTE_THRESHOLD (HEIGHT * 2)
-#define LINE_THICKNESS      2.0f
+#define LINE_THICKNESS   2.0f
+#define LINE_MITER_LIMIT 4.0f // Longest miter join, in half thicknesses, before it is beveled
+
+// Adaptive sampling settings (framebuffer pixels at full quality)
+#define SAMPLE_COLUMN_STEP      4.0  // Spacing between evaluated columns
+#define SAMPLE_TOLERANCE        0.25 // Max distance between a segment and the curve
+#define SAMPLE_MAX_ANGLE        0.1  // Radians turned at a column before its intervals are refined
+#define SAMPLE_MAX_DEPTH        5    // Halvings of a column interval
+#define SAMPLE_EDGE_DEPTH       16   // Halvings used to locate the edge of the domain
+#define SAMPLE_EDGE_COLUMNS     1    // Columns evaluated past each side of the view, so bends at its edges are seen
+#define SAMPLE_JUMP_PIXELS      8.0  // Jumps taller than this are checked for discontinuities
+#define SAMPLE_JUMP_RATIO       4.0  // How much taller a jump must be than its neighbors to be checked
+#define SAMPLE_JUMP_ITERATIONS  32   // Bisections used to classify a jump
+#define SAMPLE_TANGENTS         1    // Evaluate slopes with the samples to place segments and classify jumps
+#define SAMPLE_BUDGET           8    // Refinement evaluations per curve per frame, for each column in view
+#define SAMPLE_TIME_BUDGET      (0.5 / FPS) // Seconds of evaluation per curve per frame, the rest waits
+#define SAMPLE_COARSE_STRIDE    8    // One in this many columns is evaluated first after a zoom
+#define SAMPLE_FILL_COLUMNS     128  // Columns filled in at once after a coarse pass
+#define SAMPLE_GROUP            64   // Intervals refined together, always finished once started
+#define SAMPLE_MERGE_RUN        64   // Max points merged into a single segment
+#define SAMPLE_CHUNK            64   // Evaluations per task when a batch is split across workers
+#define SAMPLE_SHARED_BLOCKS    4    // Column ranges evaluated for every curve at once, kept for the other curves
+
+// Implicit curve settings
+#define IMPLICIT_CELL_PIXELS  4    // Widest marching squares cell on screen, cells are at least half as wide
+#define IMPLICIT_TILE_CELLS   32   // Cells along each side of a tile
+#define IMPLICIT_BLOCK_CELLS  8    // Cells along each side of a block checked for the curve on its own
+#define IMPLICIT_REFINE_STEPS 4    // Regula falsi steps moving each crossing onto the curve
+#define IMPLICIT_CACHE_TILES  1024 // Tiles kept per relation, more are added while the view needs them
+
+// Field settings
+#define FIELD_TEXEL_PIXELS    2    // Widest texel on screen, texels are at least half as wide
+#define FIELD_TILE_TEXELS     128  // Texels along each side of a tile
+#define FIELD_CACHE_MEGABYTES 64   // Values and textures of the tiles kept per field
+#define FIELD_PREVIEW_LEVELS  2    // Levels above the visible one evaluated first, as a preview
+#define FIELD_FALLBACK_LEVELS 4    // Coarser levels searched for a tile to draw in place of a missing one
+#define FIELD_RANGE_SAMPLES   256  // Values per tile sorted to find its range
+#define FIELD_RANGE_CUTOFF    0.02 // Fraction of the values at each end left out of a tile's range
+#define FIELD_RANGE_SLACK     0.1  // Change of the visible range, relative to its span, that colors tiles again
+#define FIELD_OPACITY         191  // 75%
+
+// Parametric and polar curve settings (framebuffer pixels at full quality, tolerance is SAMPLE_TOLERANCE)
+#define PARAMETRIC_T_MIN       0.0               // Range of t, and of θ for polar curves
+#define PARAMETRIC_T_MAX       6.283185307179586 // 2π
+#define PARAMETRIC_SEEDS       128               // Evenly spaced parameter values evaluated first, one batch
+#define PARAMETRIC_MAX_SPLIT   8                 // Most pieces an interval is split into by one pass
+#define PARAMETRIC_MAX_DEPTH   40                // Halvings of the seed spacing down to the shortest interval
+#define PARAMETRIC_MAX_SAMPLES 65536             // Evaluations per curve for one view
+#define PARAMETRIC_MARGIN      0.25              // Fraction of the view sampled beyond each edge, covering short pans
+
+// Curve analysis settings
+#define ANALYSIS_ITERATIONS    64   // Most steps a solver takes to refine a feature
+#define ANALYSIS_TOLERANCE     1e-6 // Pixels a refined feature may be off by
+#define ANALYSIS_MAX_ERROR     1.0  // Pixels a root may be off the axis, or curves apart, before it's taken for a pole
+#define ANALYSIS_MERGE_PIXELS  0.5  // Features of a kind closer than this are the same
+#define ANALYSIS_RESCAN_ZOOM   4.0  // Zooming in this much scans the view again for features too close to tell apart
+#define ANALYSIS_MARKER_RADIUS 4.0f
+#define ANALYSIS_HOVER_RADIUS  8.0f // Cursor distance from a marker that shows its tooltip
+
+// Headless render settings
+#define RENDER_MAX_UPDATES 64 // Sampler updates per curve before it's drawn as is
+
+// Worker pool settings
+#define POOL_THREADS 0 // Worker threads, 0 for one per core besides the render thread
+
+// Arena settings
+#define ARENA_BLOCK_SIZE     (64 * 1024)   // Smallest block taken from the heap by the long-lived arena
+#define ARENA_FRAME_SIZE     (1024 * 1024) // Starting size of the per-frame arena
+#define ARENA_WARMUP_FRAMES  FPS           // Frames before debug builds report heap allocations in the main loop
+
+// Data series settings
+#define SERIES_WINDOW    (1 << 22) // Latest points kept by default
+#define SERIES_BLOCK     256       // Points per block summary, used to skip over dense data
+#define SERIES_READ_SIZE 65536     // Bytes read from the input at once
+#define SERIES_MAX_LINE  256       // Longest CSV line, longer ones are cut short
+#define SERIES_POLL_MS   50        // Wait between checks for new input
+
+// Profiler overlay settings
+#define PROFILER_TEXT_SIZE        10
+#define PROFILER_SPACING          10
+#define PROFILER_WIDTH            320
+#define PROFILER_OPACITY          204 // 80%
+#define PROFILER_HISTORY          240 // Frames kept for the histogram
+#define PROFILER_HISTOGRAM_BINS   34  // One per millisecond, the last one holds slower frames
+#define PROFILER_HISTOGRAM_HEIGHT 60
 
 // Legend settings
 #define LEGEND_SPACING        15
 #define LEGEND_OPACITY        102 // 40%
 #define LEGEND_ELEM_SIZE      20
 #define LEGEND_RECT_THICKNESS 2
+#define LEGEND_ERROR_SIZE     10
+#define LEGEND_CARET_WIDTH    2
+#define LEGEND_EDIT_LENGTH    256 // Longest text typed into an entry
+#define LEGEND_EXTRA_SLOTS    16  // Expressions that can be added from the window
 
 // Colors (Gruvbox Dark)
 #define COLOR_BRIGHT_BLACK  (Color){146, 131, 116, 255}
@@ -71,4 +168,7 @@
 #define COLOR_WHITE         (Color){168, 153, 132, 255}
 #define COLOR_YELLOW        (Color){215, 153,  33, 255}
 
+// Colors given to plotted functions in order
+#define COLOR_POOL {COLOR_BLUE, COLOR_CYAN, COLOR_GREEN, COLOR_RED, COLOR_YELLOW, COLOR_PURPLE}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdbool.h>
+
+#include "parser.h"
+
+// Program settings
+#define PROGRAM_BATCH         128  // Samples evaluated per pass through the program
+#define PROGRAM_MAX_REGISTERS 32   // Programs needing more fall back to the tree-walking evaluator
+#define PROGRAM_JIT           1    // Generate native code for programs where supported, 0 to always interpret
+#define PROGRAM_JIT_CHECKS    256  // Samples compared with the tree walk before native code is used
+#define PROGRAM_JIT_TOLERANCE 1e-9 // Relative difference allowed by the comparison
+
+// Bytecode operations, all of them applied to a whole batch of samples
+typedef enum {
+    OP_CONST, // Load constant
+    OP_X,     // Load independent variable
+    OP_Y,     // Load second variable, only in relations
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_POW,
+    OP_CALL,  // Apply math function
+    OP_STORE, // Copy register to an output
+} OpCode;
+
+// Math functions callable from a program
+typedef enum {
+    FUNC_SIN,
+    FUNC_COS,
+    FUNC_TAN,
+    FUNC_ASIN,
+    FUNC_ACOS,
+    FUNC_ATAN,
+    FUNC_SINH,
+    FUNC_COSH,
+    FUNC_TANH,
+    FUNC_EXP,
+    FUNC_LN,
+    FUNC_LOG,
+    FUNC_SQRT,
+    FUNC_ABS,
+    FUNC_COUNT,
+} FuncId;
+
+typedef struct {
+    OpCode op;
+    FuncId func;  // OP_CALL only
+    double value; // OP_CONST only
+    int dst;      // Register written, or output index for OP_STORE
+    int a;        // Operand registers
+    int b;
+} Instruction;
+
+// Machine code running a whole program over vectors of samples, output i written `stride` bytes after output i - 1
+typedef void (*NativeProgram)(double (*registers)[PROGRAM_BATCH], const double *xs, const double *ys_in, double *ys,
+                              long stride, long vectors);
+
+// Register program lowered from one or more expression trees, each subexpression evaluated once
+typedef struct {
+    Instruction *code;
+    int count;
+    int capacity;
+    int registers;
+    int outputs;
+    NativeProgram native; // Generated code used instead of the interpreter, if not NULL
+    size_t native_size;
+    int native_lanes;     // Samples per vector of the generated code
+} Program;
+
+// How much of a set of trees was merged when compiling them together
+typedef struct {
+    int tree_nodes; // Nodes in the parsed trees
+    int nodes;      // Operations left after folding and merging
+    int folded;     // Operations replaced by constants
+} ProgramSharing;
+
+/**
+ * Lower expression tree into a flat program with `x` as the only variable,
+ * folding constants and merging repeated subexpressions.
+ * Returns false on nodes the program cannot represent, leaving it empty.
+ */
+bool program_compile(Program *program, Node *root);
+
+/**
+ * Lower several expression trees into one program with an output per tree, so subexpressions
+ * they have in common are evaluated once. Output `i` is the derivative of order `orders[i]` of its tree,
+ * or the tree itself if `orders` is NULL. Fills in sharing statistics if not NULL.
+ * Returns false if any tree can't be represented, leaving the program empty.
+ */
+bool program_compile_shared(Program *program, Node **roots, const int *orders, int count, ProgramSharing *sharing);
+
+/**
+ * Lower the derivative of order `order` of an expression tree with respect to `x`, built by forward-mode
+ * differentiation of its operations so the program evaluates the exact derivative rather than a difference.
+ * Returns false on nodes the program cannot represent, leaving it empty.
+ */
+bool program_compile_derivative(Program *program, Node *root, int order);
+
+/**
+ * Lower the left-hand side of a relation `f(x, y) = 0` into a program reading both `x` and `y`.
+ * Returns false on nodes the program cannot represent, leaving it empty.
+ */
+bool program_compile_relation(Program *program, Node *root);
+
+/**
+ * Evaluate program over an array of x values using the active kernels, through its native code if it has any.
+ * Scalar kernels are bit-compatible with `env_evaluate`, vector ones agree to a few ulps.
+ */
+void program_evaluate(const Program *program, const double *xs, double *ys, int count);
+
+/**
+ * Evaluate every output of a shared program over an array of x values,
+ * output `i` being written to `ys + i * stride`.
+ */
+void program_evaluate_shared(const Program *program, const double *xs, double *ys, int stride, int count);
+
+/**
+ * Evaluate relation program at arrays of x and y values.
+ */
+void program_evaluate_relation(const Program *program, const double *xs, const double *ys, double *values, int count);
+
+/**
+ * Free program code, native code included.
+ */
+void program_free(Program *program);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <raylib.h>
+
+// Size of the window, which everything is laid out in, and how finely the plot is computed for its framebuffer
+typedef struct {
+    int width, height;  // Screen coordinates, like the mouse position
+    float scale;        // Framebuffer pixels per screen coordinate, above 1 on high DPI displays
+    float quality;      // Samples per framebuffer pixel, lowered while drawn frames run over budget
+    float max_quality;  // Quality asked for
+    int slow_frames;    // Drawn frames in a row over budget
+    int fast_frames;    // Drawn frames in a row well under budget
+} Display;
+
+// Window of the app, kept up to date by `display_update`
+extern Display display;
+
+/**
+ * Read the size and scale of the opened window, sampling at `quality` samples per framebuffer pixel.
+ */
+void display_init(float quality);
+
+/**
+ * Read the size and scale of the window again. Returns whether either changed, which calls for textures
+ * covering the window to be loaded again. Nothing changes while the window is minimized.
+ */
+bool display_update(void);
+
+/**
+ * Get the center of the window in screen coordinates.
+ */
+Vector2 display_center(void);
+
+/**
+ * Lower the quality while drawn frames take longer than QUALITY_FRAME_BUDGET, and raise it back towards
+ * the one asked for once they're fast again. Takes the time spent on a drawn frame, without the buffer swap.
+ * Returns whether the quality changed, so the plot has to be sampled again.
+ */
+bool display_adapt(double frame_time);
+
+/**
+ * Create a render texture covering `width` by `height` screen coordinates at framebuffer resolution.
+ */
+RenderTexture2D display_load_texture(int width, int height);
+
+/**
+ * Start drawing to a texture from `display_load_texture`, in screen coordinates.
+ */
+void display_begin_texture(RenderTexture2D target);
+
+/**
+ * Draw a texture from `display_load_texture` with its top-left corner at `position`, in screen coordinates.
+ */
+void display_draw_texture(RenderTexture2D target, Vector2 position);
+
+#endif
@@ -4,23 +4,148 @@
 #include <raylib.h>
 #include <raymath.h>
 
-#include "environment.h"
-#include "parser.h"
+#include "common.h"
+#include "expression.h"
+
+// Grid label text and width, cached by value
+typedef struct {
+    double value;
+    int digits; // Significant digits it was formatted with
+    char text[32];
+    int width;
+    bool used;
+} GridLabel;
+
+// Indices of the first and last grid lines around a range, lines sit at `index * step` in math units
+typedef struct {
+    long first;
+    long last;
+} GridRange;
+
+// How the y axis labels sit in their column, which only follows the axis while they're all on one side of it
+typedef enum {
+    GRID_LABELS_ALIGNED, // Right-aligned to the axis, or to the right edge of the screen
+    GRID_LABELS_CLAMPED, // Left-aligned to the left edge of the screen
+    GRID_LABELS_MIXED,   // Some of each, laid out again whenever the axis moves
+} GridLabelLayout;
+
+// Off-screen copies of the grid lines and labels, reused while the view allows it
+typedef struct {
+    RenderTexture2D lines;
+    Vector2 lines_min; // World region covered by the lines texture, and by the labels along it
+    Vector2 lines_max;
+    float lines_zoom;
+    float lines_spacing;
+    unsigned int lines_origin; // Version of the world origin the lines were placed from
+    bool lines_valid;
+
+    RenderTexture2D x_labels;      // Row of x axis labels as wide as the lines texture, moved onto the axis
+    RenderTexture2D y_labels;      // Column of y axis labels as tall as the lines texture, moved next to the axis
+    GridLabelLayout labels_layout; // Layout of the column
+    float labels_edge;             // Right edge of the y axis labels the column was laid out for, in screen coordinates
+    int labels_min_width;          // Narrowest and widest labels in the column
+    int labels_max_width;
+    GridLabel labels[GRID_LABEL_CACHE_SIZE];
+} GridCache;
+
+/**
+ * Get color of the grid line with the given index, counted from the axis.
+ */
+Color grid_line_color(long index);
+
+/**
+ * Get spacing between grid lines in world units, kept within limits on screen at the given zoom.
+ */
+float grid_spacing(float zoom);
+
+/**
+ * Get indices of the grid lines `step` math units apart covering the range from `min` to `max`.
+ */
+GridRange grid_range(double min, double max, double step);
+
+/**
+ * Get significant digits a label needs to tell `value` apart from the labels `step` away.
+ */
+int grid_label_digits(double value, double step);
+
+/**
+ * Get top of the x axis labels, under the axis at `axis_y` and kept inside a screen `height` tall.
+ */
+float grid_label_row_y(float axis_y, float height);
+
+/**
+ * Get right edge of the y axis labels, left of the axis at `axis_x` and kept inside a screen `width` wide.
+ */
+float grid_label_edge(float axis_x, float width);
+
+/**
+ * Get left of a y axis label `text_width` wide, right-aligned to `edge` unless that would take it off screen.
+ */
+float grid_label_column_x(float edge, int text_width);
+
+/**
+ * Create render textures of the grid cache.
+ */
+void grid_cache_load(GridCache *cache);
+
+/**
+ * Rasterize grid lines and labels again if the camera or spacing changed too much for the cached ones.
+ * Pans within the covered region only move them.
+ * Must be called outside of texture mode.
+ */
+void grid_cache_update(GridCache *cache, Camera2D *camera, float dynamic_spacing);
+
+/**
+ * Free render textures of the grid cache.
+ */
+void grid_cache_unload(GridCache *cache);
+
+/**
+ * Draw infinite grid with dynamic spacing between lines over the whole screen, blended over any fields.
+ */
+void draw_grid(GridCache *cache, Camera2D *camera);
+
+/**
+ * Draw scale labels for grid with dynamic spacing between lines, kept on screen along the axes.
+ */
+void draw_grid_labels(GridCache *cache, Camera2D *camera);
+
+/**
+ * Plot function expression using its color, sampled adaptively over the visible range on the worker pool.
+ */
+void plot_function(Camera2D *camera, ParsedExpression *expression);
+
+/**
+ * Plot relation f(x, y) = 0 using its color, traced over tiles of the visible plane on the worker pool.
+ */
+void plot_relation(Camera2D *camera, ParsedExpression *expression);
+
+/**
+ * Plot parametric or polar curve using its color, its parameter swept for the visible region on the worker pool.
+ */
+void plot_curve(Camera2D *camera, ParsedExpression *expression);
+
+/**
+ * Color field z = f(x, y) over the visible plane, evaluated over tiles on the worker pool and drawn under the grid.
+ */
+void plot_field(Camera2D *camera, ParsedExpression *expression);
 
 /**
- * Draw infinite grid with dynamic spacing between lines.
+ * Plot data series using its color, reduced to the extremes of every pixel column of the visible range.
  */
-void draw_grid(Camera2D *camera, float dynamic_spacing);
+void plot_series(Camera2D *camera, ParsedExpression *expression);
 
 /**
- * Draw scale labels for grid with dynamic spacing between lines.
+ * Plot pyramid file using its color, from the level with one bucket per screen pixel of the visible range.
  */
-void draw_grid_labels(Camera2D *camera, float dynamic_spacing);
+void plot_pyramid(Camera2D *camera, ParsedExpression *expression);
 
 /**
- * Evaluate function expression through symbol table and plot the result using the given color.
+ * Scan visible curves for features in the background and mark the ones found, in screen space.
+ * Shows the coordinates of the marker under the cursor unless it's over the legend.
+ * Returns whether a tooltip is shown.
  */
-void plot_function(Camera2D *camera, Node *expression, SymbolTable *symbol_table, Color color);
+bool draw_features(Camera2D *camera, bool over_legend);
 
 /**
  * Display cursor coords in world space.
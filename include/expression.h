@@ -0,0 +1,219 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <pthread.h>
+#include <raylib.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "compile.h"
+#include "environment.h"
+#include "mesh.h"
+#include "parser.h"
+#include "pool.h"
+#include "pyramid.h"
+#include "samples.h"
+#include "series.h"
+
+// Prefix asking for the derivative of an expression, repeated for higher orders
+#define EXPRESSION_DERIVATIVE_PREFIX "d/dx"
+
+// Longest message explaining why an expression can't be plotted
+#define EXPRESSION_ERROR_LENGTH 64
+
+// Point of a parametric or polar curve, along with its parameter
+struct CurveSample;
+
+// Columns evaluated for every member of a group at once
+typedef struct {
+    double step;
+    long long first;
+    int count;
+    double *values; // Row of count values per member
+    int capacity;
+    struct ColumnChunk *chunks;
+    int chunk_capacity;
+    TaskGroup job;       // Chunks still being evaluated
+    int readers;         // Jobs waiting on or copying the block, which can't be reused meanwhile
+    unsigned long stamp; // Last use, the least recently used free block is reused first
+    bool valid;
+} ColumnBlock;
+
+// Visible expressions compiled together, so the subexpressions they share are evaluated once per column
+typedef struct {
+    Program program;
+    bool compiled;
+    int members;
+    pthread_mutex_t lock;
+    ColumnBlock blocks[SAMPLE_SHARED_BLOCKS];
+    unsigned long stamp;
+} ExpressionGroup;
+
+// Helper to hold parsed expressions and their plot color
+typedef struct {
+    const char *text;
+    char *buffer;   // Copy of the text of a parsed expression, the tree points into it. NULL for data
+    char *equation; // Difference of the sides of an equation, or components of a curve, parsed instead of the text
+    char error[EXPRESSION_ERROR_LENGTH]; // Why the text can't be plotted, empty if it can
+    Node *root;
+    DataSeries *series; // Streamed data plotted instead of a function, if not NULL
+    Pyramid *pyramid;   // Mapped data plotted instead of a function, if not NULL
+    struct ImplicitCache *implicit;     // Tiles of a relation f(x, y) = 0, NULL for functions of x
+    struct FieldCache *field;           // Tiles of a field z = f(x, y) colored under the grid, NULL otherwise
+    struct ParametricCurve *parametric; // Parameter sweep of a parametric or polar curve, NULL otherwise
+    Color color;
+    bool visible;
+    int order;        // Derivatives of the tree plotted instead of the tree itself, only compiled programs have them
+    Program program;
+    bool compiled;
+    Program tangent;  // Plotted function and its derivative evaluated in one pass, placing segments along the curve
+    bool tangents;    // Tangent program compiled, otherwise the curve is sampled from its values alone
+    ExpressionGroup *group; // Group this expression is evaluated with, NULL if not a member
+    int output;             // Row of the expression in its group
+    int slope_output;       // Row of its derivative in the group, -1 if the group doesn't evaluate it
+    SampleCache cache;   // Owned by the sampling job while it runs
+    SampleView view;     // View sampled by the last job
+    bool settled;        // Last job had nothing left to evaluate
+    TaskGroup job;
+    atomic_int evaluations; // Done by finished jobs, taken by the profiler
+    SamplePath path;     // Published samples, only touched by the render thread
+    CurveMesh mesh;
+} ParsedExpression;
+
+/**
+ * Check whether expression holds a function or data to plot.
+ */
+static inline bool expression_plottable(const ParsedExpression *expression) {
+    return expression->root != NULL || expression->series != NULL || expression->pyramid != NULL;
+}
+
+/**
+ * Check whether expression is evaluated over the plane rather than along x, as a relation or a field.
+ */
+static inline bool expression_planar(const ParsedExpression *expression) {
+    return expression->implicit != NULL || expression->field != NULL;
+}
+
+/**
+ * Check whether expression is a function of x sampled along the screen's columns, rather than data, a curve swept
+ * along a parameter, or evaluated over the plane.
+ */
+static inline bool expression_columnar(const ParsedExpression *expression) {
+    return expression->root != NULL && expression->parametric == NULL && !expression_planar(expression);
+}
+
+/**
+ * Check whether expression was parsed from text that can be edited, rather than read from data.
+ */
+static inline bool expression_editable(const ParsedExpression *expression) {
+    return expression->buffer != NULL;
+}
+
+/**
+ * Skip the `d/dx` prefixes of an expression's text, setting `order` to how many there are.
+ * Returns the text of the function being differentiated.
+ */
+const char *expression_strip_derivatives(const char *text, int *order);
+
+/**
+ * Generate native code for a program compiled from `count` trees, reading `y` too if it's a relation.
+ * Output `i` is the derivative of order `orders[i]` of its tree, or the tree itself if `orders` is NULL.
+ * The code is only kept if every output agrees with walking its tree, or with the interpreter for derivatives,
+ * on a set of probe points. Returns whether the program now runs natively.
+ */
+bool expression_jit(Program *program, Node **roots, const int *orders, int count, bool relation);
+
+/**
+ * Compile the derivative of order `order` of a function of x along with the next one, so sampling gets
+ * the slope of the plotted curve in the same pass as its values. Returns false if tangents are disabled
+ * or the tree can't be differentiated, leaving the program empty.
+ */
+bool expression_compile_tangent(Program *tangent, Node *root, int order);
+
+/**
+ * Compile expression tree into a program, reading `y` too if it's a relation or a field, with native code where
+ * supported.
+ * Functions also get their tangent program, curves compile every component and its derivative into one program.
+ * Returns whether the compiled program is used, otherwise evaluation walks the tree, which can't take derivatives.
+ */
+bool expression_compile(ParsedExpression *expression);
+
+/**
+ * Parse text into the tree of an empty expression and set up how it's plotted: as a field after a `z =` prefix,
+ * a polar curve after `r =`, a parametric curve if it's a pair `(f(t), g(t))`, a relation if it's an equation or
+ * uses y, or a function of x otherwise, compiled where possible.
+ * On failure the tree stays NULL and `error` says why. Returns whether the expression can be plotted.
+ */
+bool expression_parse(ParsedExpression *expression, Parser *parser, const char *text);
+
+/**
+ * Replace the text of an expression and parse it again, keeping its color and visibility. Only waits for the
+ * expression's own job, then drops its samples, tiles, mesh and programs, so its curve starts over while others
+ * keep theirs. The expression leaves its group until the group is built again.
+ */
+void expression_edit(ParsedExpression *expression, Parser *parser, const char *text);
+
+/**
+ * Evaluate expression over an array of x values. Safe to call from several threads at once.
+ */
+void expression_evaluate(ParsedExpression *expression, const double *xs, double *ys, int count);
+
+/**
+ * Evaluate expression and its slope over an array of x values in one pass. The tangent program must be compiled.
+ * Safe to call from several threads at once.
+ */
+void expression_evaluate_tangent(ParsedExpression *expression, const double *xs, double *ys, double *slopes,
+                                 int count);
+
+/**
+ * Evaluate relation or field at pairs of x and y values. Safe to call from several threads at once.
+ */
+void expression_evaluate_relation(ParsedExpression *expression, const double *xs, const double *ys, double *values,
+                                  int count);
+
+/**
+ * Evaluate the points of a parametric or polar curve, along with their derivatives with respect to the parameter
+ * where the program has them, at an array of parameter values. Every component comes from the same pass.
+ * Safe to call from several threads at once.
+ */
+void expression_evaluate_curve(ParsedExpression *expression, const double *ts, struct CurveSample *samples,
+                               int count);
+
+/**
+ * Evaluate columns of the sample lattice for a group member, reusing the values if another member
+ * already asked for the same columns or evaluating them for every member otherwise. Slopes are filled in
+ * too if not NULL, NaN where the group doesn't evaluate them.
+ * Returns false if the group can't take the request, in which case nothing was evaluated.
+ */
+bool expression_evaluate_columns(ParsedExpression *expression, double step, long long first, const double *xs,
+                                 double *ys, double *slopes, int count);
+
+/**
+ * Set up an empty group.
+ */
+void expression_group_init(ExpressionGroup *group);
+
+/**
+ * Compile every visible expression into the group, replacing its previous members.
+ * Waits for the sampling jobs of all expressions first.
+ */
+void expression_group_build(ExpressionGroup *group, ParsedExpression *expressions, int count);
+
+/**
+ * Free group program and column blocks. Members must be removed or freed first.
+ */
+void expression_group_free(ExpressionGroup *group);
+
+/**
+ * Free evaluation state of the calling thread.
+ */
+void expression_thread_free(void);
+
+/**
+ * Wait for the sampling job, then free text, compiled programs, data, samples, curve mesh, field tiles and curve
+ * sweep.
+ * Must be called before the window is closed.
+ */
+void expression_free(ParsedExpression *expression);
+
+#endif
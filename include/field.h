@@ -0,0 +1,82 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <raylib.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "expression.h"
+#include "implicit.h"
+
+// Square of the plane on the lattice of one zoom level, with the field's values at the centers of its texels
+typedef struct {
+    int level;           // Texels are 2^level math units wide
+    long long tx, ty;    // Position in tiles
+    atomic_int state;
+    unsigned long stamp; // Last frame the tile was visible in
+    ParsedExpression *expression;
+    float *values;       // Rows from the top as offsets from `base`, only read once ready
+    double base;
+    double lo, hi;       // Range of most values, leaving out the extremes around poles
+
+    // Colored values, only touched by the render thread
+    Texture2D texture;
+    bool colored;
+    double colored_lo, colored_hi; // Range the texture was colored for
+
+    int bucket_next;  // Next tile in the same hash bucket, -1 if last
+    int newer, older; // Neighbours in the recency list, -1 at its ends
+} FieldTile;
+
+// Part of a tile drawn over a square of the view, from a coarser level while the right one is missing
+typedef struct {
+    FieldTile *tile;
+    Rectangle source;     // Texels drawn
+    double min_x, max_x;  // Region covered in math units
+    double min_y, max_y;
+} FieldPatch;
+
+// Evaluated tiles of a field, least recently visible ones are replaced once the memory budget is used up
+typedef struct FieldCache {
+    FieldTile *tiles;
+    int capacity; // Tiles fitting the budget
+    int used;
+    int *buckets; // First tile of each hash bucket by level and position, -1 if empty
+    int bucket_mask;
+    int newest, oldest;
+    unsigned long frame;
+    double lo, hi; // Range spanned by the colormap
+    FieldPatch *patches; // Drawn this frame
+    int patch_count;
+    int patch_capacity;
+    bool complete; // Every visible tile is ready
+} FieldCache;
+
+/**
+ * Skip the `z =` prefix of an expression's text, which plots a function of x and y as a field.
+ * Returns the text of the function, or NULL if the text isn't a field.
+ */
+const char *field_strip_prefix(const char *text);
+
+/**
+ * Set up an empty tile cache, with as many tiles as fit FIELD_CACHE_MEGABYTES.
+ */
+void field_init(FieldCache *cache);
+
+/**
+ * Start evaluating the tiles of the visible region missing from the cache on the worker pool, coarse previews
+ * first, and color the finished ones. Lists the patches to draw, falling back to coarser levels for missing tiles.
+ */
+void field_schedule(ParsedExpression *expression, SampleView view);
+
+/**
+ * Check whether a field has tiles of the visible region still being evaluated.
+ */
+bool field_pending(ParsedExpression *expression);
+
+/**
+ * Free tile values and textures. The expression's job must be finished.
+ */
+void field_free(FieldCache *cache);
+
+#endif
@@ -3,20 +3,70 @@
 
 #include <raylib.h>
 
+#include "common.h"
+#include "expression.h"
 #include "parser.h"
 
-// Helper to hold parsed expressions and their plot color
+// Entries of the legend, with room for expressions added from the window
 typedef struct {
-    const char *text;
-    Node *root;
-    Color color;
-    bool visible;
-} ParsedExpression;
+    ParsedExpression *expressions;
+    int count;    // Slots in use, removed expressions leave theirs empty until another one takes it
+    int capacity; // Slots allocated, expressions never move since jobs point at them
+    Parser *parser;
+
+    // Entry being edited, -1 if none, with its text as typed and as it was before
+    int editing;
+    char text[LEGEND_EDIT_LENGTH];
+    int length;
+    int caret;
+    char original[LEGEND_EDIT_LENGTH];
+    bool added; // Entry was added by this edit, so cancelling removes it
+} Legend;
+
+// What handling the legend changed, each one implies the ones before it
+typedef enum {
+    LEGEND_UNCHANGED,
+    LEGEND_REDRAW,  // Only the legend itself, like the caret
+    LEGEND_EDITED,  // An expression was edited or removed, its curve starts over
+    LEGEND_REGROUP, // Visibility changed or an edit finished, the evaluation group is out of date
+} LegendChange;
+
+/**
+ * Set up the legend of the first `count` of `capacity` expressions.
+ */
+void legend_init(Legend *legend, ParsedExpression *expressions, int count, int capacity, Parser *parser);
+
+/**
+ * Check whether the cursor is hovering over the legend box, changing its shape accordingly.
+ */
+bool legend_hovered(Legend *legend);
+
+/**
+ * Handle clicks and typing on the legend. Clicking a color square toggles visibility, clicking an expression's text
+ * edits it and clicking the last row adds one. Every change of the text parses the edited expression again.
+ * Enter or clicking elsewhere finishes the edit, escape restores the text from before it, and an expression
+ * left empty is removed. Returns what changed.
+ */
+LegendChange legend_update(Legend *legend);
+
+/**
+ * Display legend of plotted functions, with the errors of those that can't be plotted.
+ */
+void display_legend(Legend *legend);
+
+/**
+ * Get box around a legend of `rows` entries, the widest text of which is `text_width` pixels wide.
+ */
+Rectangle legend_box_rect(int rows, int text_width);
+
+/**
+ * Get color square of the legend entry in the given row, counted from the top.
+ */
+Rectangle legend_toggle_rect(int row);
 
 /**
- * Display legend of plotted functions.
- * Returns whether the cursor is hovering over the legend box.
+ * Get left of the text of every legend entry, after its color square.
  */
-bool display_legend(ParsedExpression *expressions, int count);
+int legend_text_x(void);
 
-#endif
\ No newline at end of file
+#endif
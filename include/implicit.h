@@ -0,0 +1,79 @@
+#ifndef IMPLICIT_H
+#define IMPLICIT_H
+
+#include <stdatomic.h>
+
+#include "common.h"
+#include "expression.h"
+#include "parser.h"
+
+// Lifecycle of a cached tile
+typedef enum {
+    TILE_FREE,
+    TILE_PENDING, // Being traced by a task
+    TILE_READY,
+} TileState;
+
+// Square of the plane on the lattice of one zoom level, with the pieces of the curve crossing it
+typedef struct {
+    int level;           // Cells are 2^level math units wide
+    long long tx, ty;    // Position in tiles
+    atomic_int state;
+    unsigned long stamp; // Last frame the tile was visible in
+    ParsedExpression *expression;
+
+    // Polylines in math units separated by NaN points, only read once ready
+    SamplePoint *points;
+    int count;
+    int capacity;
+} ImplicitTile;
+
+// Traced tiles of a relation, reused while they stay on screen at the same level
+typedef struct ImplicitCache {
+    ImplicitTile **tiles; // Allocated one by one, so tasks keep their tile when the list grows
+    int tile_count;
+    int tile_capacity;
+    unsigned long frame;
+    ImplicitTile **visible; // Tiles of the current view, row by row
+    int visible_capacity;
+
+    // Tiles whose curve is in the published path
+    int level;
+    long long min_tx, min_ty;
+    long long max_tx, max_ty;
+    int ready;
+    bool complete; // Every visible tile is in the path
+} ImplicitCache;
+
+/**
+ * Check whether an expression tree uses `y`, making it a relation f(x, y) = 0 rather than a function.
+ */
+bool implicit_is_relation(const Node *root);
+
+/**
+ * Set up an empty tile cache.
+ */
+void implicit_init(ImplicitCache *cache);
+
+/**
+ * Start tracing the tiles of the visible region missing from the cache on the worker pool, and rebuild
+ * the path from the finished ones. While zooming the old path stays until the new level is complete.
+ */
+void implicit_schedule(ParsedExpression *expression, SampleView view);
+
+/**
+ * Check whether a relation has tiles still being traced or missing from its path.
+ */
+bool implicit_pending(ParsedExpression *expression);
+
+/**
+ * Free tracing buffers of the calling thread.
+ */
+void implicit_thread_free(void);
+
+/**
+ * Free tile points. The expression's job must be finished.
+ */
+void implicit_free(ImplicitCache *cache);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "compile.h"
+
+/**
+ * Generate x86-64 machine code for a program, running every instruction on a pair of samples before moving
+ * to the next pair. Functions without an instruction of their own call the active kernels on the whole batch.
+ * Returns false on other architectures or if executable memory can't be mapped, leaving the program interpreted.
+ */
+bool jit_compile(Program *program);
+
+/**
+ * Unmap generated code, the program is interpreted again.
+ */
+void jit_free(Program *program);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "compile.h"
+
+// Instruction sets with a kernel table, from slowest to fastest
+typedef enum {
+    KERNELS_SCALAR,
+    KERNELS_SSE2,
+    KERNELS_AVX2,
+    KERNELS_COUNT,
+} KernelLevel;
+
+// Batch operations used by the program evaluator, results are written over the first operand
+typedef struct {
+    const char *name;
+    void (*neg)(double *a, int n);
+    void (*add)(double *a, const double *b, int n);
+    void (*sub)(double *a, const double *b, int n);
+    void (*mul)(double *a, const double *b, int n);
+    void (*div)(double *a, const double *b, int n);
+    void (*pow)(double *a, const double *b, int n);
+    void (*call[FUNC_COUNT])(double *a, int n);
+} Kernels;
+
+// Kernel table used by program evaluation
+extern const Kernels *kernels;
+
+/**
+ * Select the kernel table used by program evaluation: the fastest one supported by the running CPU, or the
+ * scalar one if `scalar` is set, which gives the same results as the tree walk bit for bit.
+ */
+void kernels_init(bool scalar);
+
+/**
+ * Get kernel table for the given instruction set.
+ * Returns NULL if the running CPU or the build doesn't support it.
+ */
+const Kernels *kernels_get(KernelLevel level);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <raylib.h>
+#include <stdbool.h>
+
+// Thick polyline of a curve as indexed triangles, uploaded once and redrawn until it changes
+typedef struct {
+    float *vertices; // Interleaved x and y in world space
+    int vertex_count;
+    int vertex_capacity;
+    unsigned short *indices;
+    int index_count;
+    int index_capacity;
+    int segment_count;
+
+    // GPU buffers and their capacity
+    unsigned int vao;
+    unsigned int vbo;
+    unsigned int ebo;
+    int gpu_vertex_capacity;
+    int gpu_index_capacity;
+    bool uploaded;
+
+    // Inputs the mesh was built from, used to tell when it must be rebuilt
+    unsigned int version;
+    unsigned int origin; // Version of the world origin vertices are placed from
+    float thickness;
+    double min_y;        // Band of math y clipped to, in doubles to tell it apart at any zoom
+    double max_y;
+    bool built;
+} CurveMesh;
+
+/**
+ * Build triangles covering every run of points with the given thickness, using miter joins
+ * and bevel joins past the miter limit. Runs are separated by points with a NaN coordinate.
+ * Returns false if the mesh doesn't fit in 16-bit indices, leaving it empty.
+ */
+bool curve_mesh_build(CurveMesh *mesh, const Vector2 *points, int count, float thickness);
+
+/**
+ * Upload mesh to the GPU, reusing its buffers when they are big enough.
+ */
+void curve_mesh_upload(CurveMesh *mesh);
+
+/**
+ * Draw uploaded mesh with the current 2D transform in a single call.
+ */
+void curve_mesh_draw(CurveMesh *mesh, Color color);
+
+/**
+ * Free mesh memory and GPU buffers.
+ */
+void curve_mesh_unload(CurveMesh *mesh);
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef PARAMETRIC_H
+#define PARAMETRIC_H
+
+#include "common.h"
+#include "expression.h"
+#include "samples.h"
+
+// How the components of a curve are given
+typedef enum {
+    PARAMETRIC_XY,    // (f(t), g(t))
+    PARAMETRIC_POLAR, // r = f(θ), plotted at (f(θ) cos θ, f(θ) sin θ)
+} ParametricKind;
+
+// Point of a curve at a value of its parameter, with its derivative along the curve, NaN where it isn't known
+typedef struct CurveSample {
+    double t;
+    double x, y;
+    double dx, dy;
+} CurveSample;
+
+// Parameter sweep of a parametric or polar curve, resampled by a job on the worker pool for every view
+typedef struct ParametricCurve {
+    ParametricKind kind;
+    Node *y_root;     // Second component of a parametric curve, the expression's tree being the first or the radius
+    bool derivatives; // Program evaluates the derivatives of the components after the components themselves
+
+    // Samples in order of the parameter, rebuilt from the seeds by every job
+    CurveSample *samples;
+    int count;
+    int capacity;
+    CurveSample *spare_samples; // Same capacity, the next pass is built in it
+    double *ts;                 // Parameter values evaluated in a pass
+    int *slots;                 // Sample each of them fills in
+    int pending;                // Values listed for the pass so far
+    int pending_capacity;
+
+    SamplePath path;      // Built by the job, swapped with the expression's once it's done
+    unsigned int version; // Version given to the next built path
+} ParametricCurve;
+
+/**
+ * Check whether text is a parametric curve `(f(t), g(t))` or a polar curve `r = f(θ)`, where θ may also be spelled
+ * `theta`. Returns the components rewritten as functions of x, each followed by a null character, the x one first,
+ * or NULL if the text is neither. Sets `error` if it's a curve that can't be plotted.
+ */
+char *parametric_rewrite(const char *text, ParametricKind *kind, char *error);
+
+/**
+ * Set up a curve with no samples, taking the tree of the y component of a parametric curve.
+ */
+void parametric_init(ParametricCurve *curve, ParametricKind kind, Node *y_root);
+
+/**
+ * Sample the parameter range of a curve for the visible region and build its path. Intervals of the parameter
+ * are split until their segments are within SAMPLE_TOLERANCE of the curve on screen, so the step follows the
+ * length and bends of the curve in pixels, and the ones lying outside the view are left out without being split.
+ * Returns the number of evaluations performed.
+ */
+int parametric_update(ParsedExpression *expression, SampleView view);
+
+/**
+ * Publish the path of the last finished update and sample the curve for the visible region on the worker pool
+ * if it moved. Never blocks, while an update is running the previously published path stays in place.
+ */
+void parametric_schedule(ParsedExpression *expression, SampleView view);
+
+/**
+ * Check whether a curve has samples still being computed or waiting to be published.
+ */
+bool parametric_pending(ParsedExpression *expression);
+
+/**
+ * Free samples and path. The expression's job must be finished.
+ */
+void parametric_free(ParametricCurve *curve);
+
+#endif
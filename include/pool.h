@@ -0,0 +1,45 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Set of submitted tasks that can be waited on together
+typedef struct {
+    atomic_int pending;
+} TaskGroup;
+
+/**
+ * Start worker threads, or one per core besides the calling thread if `threads` is 0.
+ * Each worker calls `thread_exit` (if not NULL) before it stops.
+ */
+void pool_init(int threads, void (*thread_exit)(void));
+
+/**
+ * Run task on the pool as part of a group. Runs it right away if the pool has no workers.
+ */
+void pool_submit(TaskGroup *group, void (*run)(void *arg), void *arg);
+
+/**
+ * Get whether any task of the group is queued or running.
+ */
+bool pool_busy(TaskGroup *group);
+
+/**
+ * Wait until every task of the group is done, running queued tasks meanwhile.
+ * Only tasks of the same group are run, on workers and other threads alike, so a waiting task never has
+ * another one started under it. They're taken from any queue, even from under tasks queued after them.
+ */
+void pool_wait(TaskGroup *group);
+
+/**
+ * Get number of worker threads.
+ */
+int pool_thread_count(void);
+
+/**
+ * Finish queued tasks and stop every worker.
+ */
+void pool_free(void);
+
+#endif
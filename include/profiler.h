@@ -0,0 +1,88 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+
+#include "expression.h"
+
+// Stages of a frame, in the order they run
+typedef enum {
+    PROFILE_UPDATE,
+    PROFILE_GRID,
+    PROFILE_CURVES,
+    PROFILE_LABELS,
+    PROFILE_LEGEND,
+    PROFILE_END_DRAWING,
+    PROFILE_STAGE_COUNT,
+} ProfileStage;
+
+// Trace file layouts
+typedef enum {
+    PROFILE_CSV,    // One row per frame
+    PROFILE_JSON,   // Array of frame objects
+    PROFILE_CHROME, // Chrome trace event format, for chrome://tracing or Perfetto
+} ProfileFormat;
+
+// Whether timings are recorded, only true while the overlay is shown or a trace is written
+extern bool profiler_active;
+
+/**
+ * Parse a trace format name (csv, json or chrome).
+ * Returns whether the name is known.
+ */
+bool profiler_format(const char *name, ProfileFormat *format);
+
+/**
+ * Set up the profiler for the plotted expressions, writing a trace of every frame to path unless it's NULL.
+ */
+void profiler_init(ParsedExpression *expressions, int count, ProfileFormat format, const char *path);
+
+/**
+ * Show or hide the overlay.
+ */
+void profiler_toggle_overlay(void);
+
+/**
+ * Draw overlay with the timings of the last frames in screen space, if shown.
+ */
+void profiler_draw_overlay(void);
+
+/**
+ * Finish the trace file and free profiler memory.
+ */
+void profiler_free(void);
+
+// Recording functions behind the hooks below, only called while active
+void profiler_record_frame_begin(void);
+void profiler_record_frame_end(bool drawn);
+void profiler_record_begin(ProfileStage stage);
+void profiler_record_end(ProfileStage stage);
+void profiler_record_curve_begin(int index);
+void profiler_record_curve_end(int index);
+
+// Timing hooks, a single branch when the profiler isn't active
+static inline void profile_frame_begin(void) {
+    if (profiler_active) profiler_record_frame_begin();
+}
+
+static inline void profile_frame_end(bool drawn) {
+    if (profiler_active) profiler_record_frame_end(drawn);
+}
+
+static inline void profile_begin(ProfileStage stage) {
+    if (profiler_active) profiler_record_begin(stage);
+}
+
+static inline void profile_end(ProfileStage stage) {
+    if (profiler_active) profiler_record_end(stage);
+}
+
+static inline void profile_curve_begin(int index) {
+    if (profiler_active) profiler_record_curve_begin(index);
+}
+
+static inline void profile_curve_end(int index) {
+    if (profiler_active) profiler_record_curve_end(index);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "samples.h"
+
+#define PYRAMID_MAGIC      "GCPYRAMD"
+#define PYRAMID_VERSION    1
+#define PYRAMID_MAX_LEVELS 48
+#define PYRAMID_BASE_SHIFT 4 // Raw points per bucket of the finest level, as a power of two
+
+/*
+ * File layout, every field native-endian and every section aligned to 8 bytes:
+ *   PyramidHeader
+ *   level 0:  the raw points, as SamplePoint in increasing x
+ *   level k:  one PyramidBucket per 2^(base_shift + k - 1) raw points, the last one possibly shorter
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t level_count;
+    uint32_t base_shift;
+    uint32_t reserved;
+    uint64_t offsets[PYRAMID_MAX_LEVELS]; // Byte offset of each level in the file
+    uint64_t counts[PYRAMID_MAX_LEVELS];  // Points or buckets in each level
+} PyramidHeader;
+
+// Lowest and highest point of a run of raw points, in the order they appear.
+// Both have a NaN y if the run only holds gaps, smaller gaps are too narrow to show at its level
+typedef struct {
+    SamplePoint first;
+    SamplePoint second;
+} PyramidBucket;
+
+// Pyramid file mapped into memory, read in place
+typedef struct {
+    int fd;
+    const unsigned char *data;
+    size_t size;
+    const PyramidHeader *header;
+    const SamplePoint *points; // Raw points, level 0
+    SampleView view;           // View of the last decimation
+} Pyramid;
+
+/**
+ * Write a pyramid file from CSV or raw float64 input, with the same layout as data series input.
+ * Levels are built from the file as it's written, so the input never has to fit in memory.
+ * Returns whether the file was written.
+ */
+bool pyramid_build(FILE *input, bool binary, const char *path);
+
+/**
+ * Map a pyramid file.
+ * Returns whether it's a valid pyramid.
+ */
+bool pyramid_open(Pyramid *pyramid, const char *path);
+
+/**
+ * Read the visible points from the coarsest level with at least one bucket per screen pixel.
+ * Only the pages of that level holding the view are touched.
+ */
+void pyramid_decimate(Pyramid *pyramid, SampleView view, SamplePath *path);
+
+/**
+ * Unmap the file.
+ */
+void pyramid_close(Pyramid *pyramid);
+
+#endif
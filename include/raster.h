@@ -0,0 +1,33 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <raylib.h>
+
+// Software drawing into RGBA images, usable without a window or GPU
+
+/**
+ * Blend filled rectangle into image, covering the pixels whose centers lie inside it.
+ */
+void raster_rectangle(Image *image, Rectangle rect, Color color);
+
+/**
+ * Blend rectangle outline of the given thickness into image, drawn inside the rectangle.
+ */
+void raster_rectangle_lines(Image *image, Rectangle rect, int thickness, Color color);
+
+/**
+ * Blend anti-aliased line with round ends into image.
+ */
+void raster_line(Image *image, Vector2 start, Vector2 end, float thickness, Color color);
+
+/**
+ * Blend text into image using the built-in bitmap font, with its top-left corner at the given position.
+ */
+void raster_text(Image *image, const char *text, int x, int y, int size, Color color);
+
+/**
+ * Measure width of text drawn with the built-in bitmap font.
+ */
+int raster_measure_text(const char *text, int size);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <raylib.h>
+#include <stdbool.h>
+
+#include "expression.h"
+
+// Plot rendered straight to an image file, without a window
+typedef struct {
+    const char *output;
+    double min_x, max_x; // Visible region in math units
+    double min_y, max_y;
+    int width;
+    int height;
+    ParsedExpression *expressions;
+    int count;
+    bool rendered;
+} RenderJob;
+
+/**
+ * Draw the grid lines of a plot in software.
+ */
+void render_grid(Image *image, RenderJob *job);
+
+/**
+ * Draw the axis labels of a plot in software.
+ */
+void render_grid_labels(Image *image, RenderJob *job);
+
+/**
+ * Sample an expression until fully refined for the plot, then draw its curve in software.
+ */
+void render_curve(Image *image, RenderJob *job, ParsedExpression *expression);
+
+/**
+ * Draw the legend of a plot in software.
+ */
+void render_legend(Image *image, RenderJob *job);
+
+/**
+ * Draw grid, labels, curves and legend of a plot in software and save it to its output file.
+ * Returns whether the image was saved.
+ */
+bool render_plot(RenderJob *job);
+
+/**
+ * Run the headless command line (--render or --manifest), rendering every plot on the worker pool.
+ * Returns the process exit code.
+ */
+int render_main(int argc, char **argv);
+
+#endif
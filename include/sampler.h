@@ -0,0 +1,25 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "expression.h"
+
+/**
+ * Bring the samples of an expression up to date for the visible region. Evaluates missing columns,
+ * refines intervals within the evaluation budget and rebuilds the path if anything changed.
+ * With a time `budget` in seconds, a window of new columns starts with a coarse pass and no more work is
+ * started once it runs out; 0 means no time limit. Returns the number of evaluations performed.
+ */
+int sampler_update(ParsedExpression *expression, SampleView view, double budget);
+
+/**
+ * Publish the path of the last finished update and start updating for the visible region on the worker pool.
+ * Never blocks, while an update is running the previously published path stays in place.
+ */
+void sampler_schedule(ParsedExpression *expression, SampleView view);
+
+/**
+ * Check whether an expression has samples still being computed or waiting to be published.
+ */
+bool sampler_pending(ParsedExpression *expression);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <stdbool.h>
+
+// Point of a curve in math units, a NaN y marks a discontinuity
+typedef struct {
+    double x;
+    double y;
+} SamplePoint;
+
+// Visible region in math units
+typedef struct {
+    double min_x, max_x;
+    double min_y, max_y;
+    double scale; // Screen pixels per math unit
+} SampleView;
+
+// Points of a curve in order, with NaN breaks between its pieces
+typedef struct {
+    SamplePoint *points;
+    int count;
+    int capacity;
+    unsigned int version; // Increases every time the path is rebuilt
+} SamplePath;
+
+// Refined points lying strictly between two consecutive columns
+typedef struct {
+    int start; // First point in the cache's point pool
+    int count;
+    bool refined;
+} SampleInterval;
+
+// Evaluated columns of one expression, at math x coordinates `index * step`
+typedef struct {
+    double step;
+    long long first;           // Lattice index of the first column
+    int count;
+    int capacity;
+    double *ys;
+    double *slopes;            // Derivative at every column, NaN where the expression has no tangents
+    bool *known;               // Column has been evaluated, coarse passes leave gaps to fill in later
+    int unknown;               // Columns not evaluated yet
+    SampleInterval *intervals; // Interval i lies between columns i and i + 1
+
+    // Refined points of every interval, in no particular order between intervals
+    SamplePoint *points;
+    int point_count;
+    int point_capacity;
+    SamplePoint *spare_points; // Same capacity, used to compact the pool after a move
+
+    // Columns and refined points in order, with flat runs merged
+    SamplePath path;
+    unsigned int version; // Version given to the next rebuilt path
+
+    bool valid;
+    bool changed; // Path must be rebuilt
+} SampleCache;
+
+// Run of lattice columns the cache doesn't hold yet
+typedef struct {
+    long long first;
+    int count;
+} SampleRange;
+
+/**
+ * Move cache to a new window of columns, keeping the columns and refined intervals it already holds.
+ * Returns how many columns of the window must still be evaluated.
+ */
+int sample_cache_move(SampleCache *cache, double step, long long first, int count);
+
+/**
+ * Mark a column as evaluated once its value is stored.
+ */
+void sample_cache_fill(SampleCache *cache, int column);
+
+/**
+ * Store the refined points of an interval, sorted by x.
+ */
+void sample_cache_refine(SampleCache *cache, int interval, const SamplePoint *points, int count);
+
+/**
+ * Append point to a path.
+ */
+void sample_path_push(SamplePath *path, SamplePoint point);
+
+/**
+ * Clip segment to a horizontal band, so points far off screen don't overflow floats.
+ * Returns whether any part of it is left.
+ */
+bool sample_clip_segment(SamplePoint *p0, SamplePoint *p1, double min_y, double max_y);
+
+/**
+ * Free path points.
+ */
+void sample_path_free(SamplePath *path);
+
+/**
+ * Drop every cached column, e.g. after the expression changes.
+ */
+void sample_cache_invalidate(SampleCache *cache);
+
+/**
+ * Free cached columns.
+ */
+void sample_cache_free(SampleCache *cache);
+
+#endif
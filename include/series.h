@@ -0,0 +1,74 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "samples.h"
+
+// Extremes of an aligned block of points in the ring, so decimation can skip over it
+typedef struct {
+    long long min_index; // Absolute index of the lowest and highest point
+    long long max_index;
+    double min_y;
+    double max_y;
+    bool has_nan;
+} SeriesBlock;
+
+// Measured points streamed in from a file or pipe by a reader thread, the latest ones kept in a ring
+typedef struct {
+    int fd;
+    bool binary;      // Raw float64 y values instead of CSV text
+    bool follow;      // Regular file tailed for appended data instead of ending at EOF
+    pthread_t reader;
+    atomic_bool stopping;
+    atomic_bool live; // Reader still running
+
+    // Ring of points with increasing x, guarded by the lock
+    pthread_mutex_t lock;
+    SamplePoint *points;
+    SeriesBlock *blocks;
+    long long capacity;
+    long long window;     // Most points kept, older ones are overwritten
+    long long total;      // Points received so far
+    atomic_uint version;  // Increases whenever points are added
+    unsigned int drawn_version;
+} DataSeries;
+
+/**
+ * Open a CSV or raw float64 data file, or stdin if path is "-", and start streaming it in the background.
+ * CSV lines hold `x,y` or just `y`, single values and binary input use the point index as x.
+ * Input ends at EOF, unless `follow` is set and it's a regular file, which is then tailed as it's appended to.
+ * Returns whether the input could be opened.
+ */
+bool series_open(DataSeries *series, const char *path, bool binary, bool follow, long long window);
+
+/**
+ * Parse a CSV line holding `x,y` or `y`, separated by a comma, semicolon, tab or spaces.
+ * Returns how many values were stored, 0 if the line doesn't start with a number.
+ */
+int series_parse_line(const char *line, double values[2]);
+
+/**
+ * Reduce the points in the visible region to the lowest and highest one in every screen pixel column,
+ * in the order they were received, with NaN breaks where the data has gaps.
+ */
+void series_decimate(DataSeries *series, SampleView view, SamplePath *path);
+
+/**
+ * Check whether points arrived since the series was last decimated.
+ */
+bool series_pending(DataSeries *series);
+
+/**
+ * Check whether the reader is still waiting for more input.
+ */
+bool series_live(DataSeries *series);
+
+/**
+ * Stop the reader, close the input and free the points.
+ */
+void series_close(DataSeries *series);
+
+#endif
@@ -4,24 +4,48 @@
 #include <raylib.h>
 #include <raymath.h>
 
+// Math coordinates of the world's origin, kept under the camera so world coordinates stay small for floats.
+// World coordinates are pixels at zoom 1 from here, with y growing downwards.
+typedef struct {
+    double x, y;
+    unsigned int version; // Increases every time the origin moves
+} WorldOrigin;
+
+extern WorldOrigin world_origin;
+
 /**
- * Reset camera properties.
+ * Reset camera properties, and the world's origin back onto the math origin.
  */
 void camera_reset(Camera2D *camera);
 
+/**
+ * Move the world's origin onto the camera target once the target is too far from it to draw at pixel precision,
+ * keeping the view in place. Returns whether it moved, so anything kept in world coordinates is out of date.
+ */
+bool camera_rebase(Camera2D *camera);
+
+/**
+ * Handle window resizing and moves between displays of different DPI, keeping the view centered.
+ * Returns whether the window's size or scale changed.
+ */
+bool resize(Camera2D *camera);
+
 /**
  * Handle grid panning.
+ * Returns whether the view moved.
  */
-void pan(Camera2D *camera);
+bool pan(Camera2D *camera);
 
 /**
  * Handle grid zooming.
+ * Returns whether the view moved.
  */
-void zoom(Camera2D *camera);
+bool zoom(Camera2D *camera);
 
 /**
  * Handle keyboard shortcuts.
+ * Returns whether the view moved.
  */
-void shortcuts(Camera2D *camera);
+bool shortcuts(Camera2D *camera);
 
 #endif
\ No newline at end of file
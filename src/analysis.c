@@ -0,0 +1,505 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "arena.h"
+#include "pool.h"
+#include "sampler.h"
+
+// Features of one curve, or intersections of a pair of curves, with the range of x already scanned for them
+typedef struct {
+    int first;
+    int second; // -1 for a single curve
+    Feature *features;
+    int count;
+    int capacity;
+
+    // Scanned range, empty while min_x > max_x, and the coarsest scale it was scanned at
+    double min_x, max_x;
+    double scale;
+
+    // Parts of the view the running scan covers
+    double ranges[2][2];
+    int range_count;
+
+    // Scan running on the pool, stopped early once one of its curves changes
+    TaskGroup job;
+    atomic_bool cancelled;
+} FeatureSet;
+
+// Zero of this function is the refined feature
+typedef struct {
+    FeatureKind kind;
+    ParsedExpression *first;
+    ParsedExpression *second;
+    atomic_bool *cancelled; // Set of the scan refining it
+} Objective;
+
+static struct {
+    ParsedExpression *expressions;
+    int count;
+    bool shown;
+
+    // Set of curve i alone at i * (count + 1), of the pair i < j at i * (count + 1) + j + 1
+    FeatureSet *sets;
+    SamplePath *paths; // Copies of the published paths, read by the running scans
+    bool finished;     // Scans done, their features aren't published yet
+
+    // Published features, only touched by the render thread
+    Feature *features;
+    int feature_count;
+    int feature_capacity;
+} analysis;
+
+static const char *kind_names[] = {
+    [FEATURE_ROOT] = "root",
+    [FEATURE_MINIMUM] = "minimum",
+    [FEATURE_MAXIMUM] = "maximum",
+    [FEATURE_INTERSECTION] = "intersection",
+};
+
+static void reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return;
+
+    *capacity = count * 2;
+    *buffer = realloc(*buffer, size * *capacity);
+}
+
+static FeatureSet *get_set(int first, int second) {
+    return &analysis.sets[first * (analysis.count + 1) + second + 1];
+}
+
+static bool cancelled(atomic_bool *flag) {
+    return atomic_load_explicit(flag, memory_order_relaxed);
+}
+
+static bool scanning(void) {
+    for (int i = 0; i < analysis.count * (analysis.count + 1); i++) {
+        if (pool_busy(&analysis.sets[i].job)) return true;
+    }
+
+    return false;
+}
+
+static double value(ParsedExpression *expression, double x) {
+    double y;
+    expression_evaluate(expression, &x, &y, 1);
+    return y;
+}
+
+static double slope(ParsedExpression *expression, double x) {
+    double y, s;
+    expression_evaluate_tangent(expression, &x, &y, &s, 1);
+    return s;
+}
+
+static double objective(const Objective *objective, double x) {
+    switch (objective->kind) {
+        case FEATURE_ROOT:         return value(objective->first, x);
+        case FEATURE_INTERSECTION: return value(objective->first, x) - value(objective->second, x);
+        default:                   return slope(objective->first, x);
+    }
+}
+
+static bool brent(const Objective *o, double a, double b, double fa, double fb, double tolerance, double *root) {
+    // Inverse quadratic interpolation and secant steps, falling back to bisection whenever they don't close in fast
+    double c = a, fc = fa, d = b - a, e = d;
+
+    for (int i = 0; i < ANALYSIS_ITERATIONS; i++) {
+        if (cancelled(o->cancelled)) return false;
+
+        // Keep the zero between b and c, b being the best estimate
+        if ((fb > 0.0) == (fc > 0.0)) {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (fabs(fc) < fabs(fb)) {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        double step_tolerance = 2.0 * DBL_EPSILON * fabs(b) + tolerance / 2.0;
+        double middle = (c - b) / 2.0;
+        if (fabs(middle) <= step_tolerance || fb == 0.0) break;
+
+        if (fabs(e) >= step_tolerance && fabs(fa) > fabs(fb)) {
+            double s = fb / fa, p, q;
+            if (a == c) {
+                p = 2.0 * middle * s;
+                q = 1.0 - s;
+            } else {
+                double qa = fa / fc, r = fb / fc;
+                p = s * (2.0 * middle * qa * (qa - r) - (b - a) * (r - 1.0));
+                q = (qa - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+
+            if (p > 0.0) q = -q;
+            p = fabs(p);
+
+            // Take the interpolated step only if it stays well inside the bracket and keeps shrinking
+            if (2.0 * p < fmin(3.0 * middle * q - fabs(step_tolerance * q), fabs(e * q))) {
+                e = d;
+                d = p / q;
+            } else {
+                d = e = middle;
+            }
+        } else {
+            d = e = middle;
+        }
+
+        a = b;
+        fa = fb;
+        b += fabs(d) > step_tolerance ? d : copysign(step_tolerance, middle);
+        fb = objective(o, b);
+        if (isnan(fb)) return false;
+    }
+
+    *root = b;
+    return true;
+}
+
+static double golden_section(ParsedExpression *expression, double a, double b, bool maximum, double tolerance,
+                             atomic_bool *cancel) {
+    // Shrink the bracket around the extremum by the golden ratio, reusing one point every step
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double sign = maximum ? -1.0 : 1.0;
+    double c = b - ratio * (b - a), d = a + ratio * (b - a);
+    double fc = sign * value(expression, c), fd = sign * value(expression, d);
+
+    for (int i = 0; i < ANALYSIS_ITERATIONS && b - a > tolerance && !cancelled(cancel); i++) {
+        if (fc < fd) {
+            b = d;
+            d = c;
+            fd = fc;
+            c = b - ratio * (b - a);
+            fc = sign * value(expression, c);
+        } else {
+            a = c;
+            c = d;
+            fc = fd;
+            d = a + ratio * (b - a);
+            fd = sign * value(expression, d);
+        }
+    }
+
+    return (a + b) / 2.0;
+}
+
+static void add_feature(FeatureSet *set, FeatureKind kind, double x, double y, double scale) {
+    // Scans of overlapping ranges or at another zoom find the same features again
+    for (int i = 0; i < set->count; i++) {
+        if (set->features[i].kind == kind && fabs(set->features[i].x - x) * scale < ANALYSIS_MERGE_PIXELS) return;
+    }
+
+    reserve((void **)&set->features, &set->capacity, set->count + 1, sizeof(Feature));
+    set->features[set->count++] = (Feature){kind, x, y, set->first, set->second, BLANK};
+}
+
+static bool is_finite(double y) {
+    return !isnan(y) && !isinf(y);
+}
+
+static void refine_root(FeatureSet *set, SamplePoint p0, SamplePoint p1, double scale) {
+    ParsedExpression *expression = &analysis.expressions[set->first];
+    Objective o = {FEATURE_ROOT, expression, NULL, &set->cancelled};
+    double x;
+
+    // Sign changes across a pole the samples didn't break at are too far from zero once refined
+    if (!brent(&o, p0.x, p1.x, p0.y, p1.y, ANALYSIS_TOLERANCE / scale, &x)) return;
+    double y = value(expression, x);
+    if (is_finite(y) && fabs(y) * scale <= ANALYSIS_MAX_ERROR) add_feature(set, FEATURE_ROOT, x, 0.0, scale);
+}
+
+static void refine_extremum(FeatureSet *set, SamplePoint p0, SamplePoint p2, bool maximum, double scale) {
+    ParsedExpression *expression = &analysis.expressions[set->first];
+    FeatureKind kind = maximum ? FEATURE_MAXIMUM : FEATURE_MINIMUM;
+    double x = NAN;
+
+    // Exact slopes locate the extremum as their zero, otherwise the value itself is bracketed
+    if (expression->tangents) {
+        Objective o = {kind, expression, NULL, &set->cancelled};
+        double s0 = slope(expression, p0.x), s2 = slope(expression, p2.x);
+        if (s0 * s2 < 0.0 && !brent(&o, p0.x, p2.x, s0, s2, ANALYSIS_TOLERANCE / scale, &x)) return;
+    }
+    if (isnan(x)) x = golden_section(expression, p0.x, p2.x, maximum, ANALYSIS_TOLERANCE / scale, &set->cancelled);
+
+    double y = value(expression, x);
+    if (is_finite(y)) add_feature(set, kind, x, y, scale);
+}
+
+static bool owned(double x, const double range[2]) {
+    // Brackets belong to the range their left end is in, so neighboring ranges don't both refine them
+    return x >= range[0] && x < range[1];
+}
+
+static void scan_curve(FeatureSet *set, const double range[2], double scale) {
+    SamplePath *path = &analysis.paths[set->first];
+    SamplePoint *points = path->points;
+
+    for (int i = 1; i < path->count && !cancelled(&set->cancelled); i++) {
+        SamplePoint p0 = points[i - 1], p1 = points[i];
+        if (isnan(p0.y) || isnan(p1.y)) continue;
+
+        // Zeros on a sample are already exact
+        if (owned(p0.x, range) && p0.y == 0.0) add_feature(set, FEATURE_ROOT, p0.x, 0.0, scale);
+        else if (owned(p0.x, range) && (p0.y < 0.0) != (p1.y < 0.0) && p1.y != 0.0) refine_root(set, p0, p1, scale);
+
+        // Turning points are bracketed by their neighbors
+        if (i + 1 >= path->count || isnan(points[i + 1].y) || !owned(p1.x, range)) continue;
+        double rise = p1.y - p0.y, next = points[i + 1].y - p1.y;
+        if (rise * next < 0.0) refine_extremum(set, p0, points[i + 1], rise > 0.0, scale);
+    }
+}
+
+static bool interpolate(SamplePath *path, int *cursor, double x, double *y) {
+    // Move to the segment holding x, cursors only go forward since x increases
+    while (*cursor + 1 < path->count && path->points[*cursor + 1].x <= x) (*cursor)++;
+    if (*cursor + 1 >= path->count || path->points[*cursor].x > x) return false;
+
+    SamplePoint p0 = path->points[*cursor], p1 = path->points[*cursor + 1];
+    if (isnan(p0.y) || isnan(p1.y)) return false;
+
+    *y = p0.y + (p1.y - p0.y) * (x - p0.x) / (p1.x - p0.x);
+    return true;
+}
+
+static void scan_pair(FeatureSet *set, const double range[2], double scale) {
+    SamplePath *a = &analysis.paths[set->first], *b = &analysis.paths[set->second];
+    Objective o = {FEATURE_INTERSECTION, &analysis.expressions[set->first], &analysis.expressions[set->second],
+                   &set->cancelled};
+    int i = 0, j = 0, cursor_a = 0, cursor_b = 0;
+    double last_x = NAN, last_difference = NAN;
+
+    // Walk the points of both paths in order, comparing the curves wherever either has a sample
+    while ((i < a->count || j < b->count) && !cancelled(&set->cancelled)) {
+        double x;
+        if (j >= b->count || (i < a->count && a->points[i].x <= b->points[j].x)) x = a->points[i++].x;
+        else x = b->points[j++].x;
+        if (x == last_x) continue;
+
+        double ya, yb;
+        if (!interpolate(a, &cursor_a, x, &ya) || !interpolate(b, &cursor_b, x, &yb)) {
+            last_x = x;
+            last_difference = NAN;
+            continue;
+        }
+
+        double difference = ya - yb;
+        if (!isnan(last_difference) && owned(last_x, range) && last_difference * difference < 0.0) {
+            double root;
+            if (brent(&o, last_x, x, last_difference, difference, ANALYSIS_TOLERANCE / scale, &root)) {
+                double y0 = value(o.first, root), y1 = value(o.second, root);
+                if (is_finite(y0) && is_finite(y1) && fabs(y0 - y1) * scale <= ANALYSIS_MAX_ERROR)
+                    add_feature(set, FEATURE_INTERSECTION, root, y0, scale);
+            }
+        }
+
+        last_x = x;
+        last_difference = difference;
+    }
+}
+
+static void scan_task(void *arg) {
+    FeatureSet *set = arg;
+    for (int i = 0; i < set->range_count; i++) {
+        if (set->second < 0) scan_curve(set, set->ranges[i], set->scale);
+        else scan_pair(set, set->ranges[i], set->scale);
+    }
+}
+
+static bool eligible(int index) {
+    // Settled samples of a visible function of x, anything still sampling is scanned once it's done
+    ParsedExpression *expression = &analysis.expressions[index];
+    return expression_columnar(expression) && expression->visible && !sampler_pending(expression);
+}
+
+static bool plan_scan(FeatureSet *set, SampleView view) {
+    // Far into a zoom, or away from the scanned range, the view is scanned again from scratch
+    bool empty = set->min_x > set->max_x;
+    if (empty || view.scale > set->scale * ANALYSIS_RESCAN_ZOOM || view.max_x < set->min_x ||
+        view.min_x > set->max_x) {
+        // Features off the view go, the rest may be found again and are merged
+        int kept = 0;
+        for (int i = 0; i < set->count; i++) {
+            Feature *feature = &set->features[i];
+            if (feature->x >= view.min_x && feature->x <= view.max_x) set->features[kept++] = *feature;
+        }
+
+        set->count = kept;
+        set->min_x = view.min_x;
+        set->max_x = view.max_x;
+        set->scale = view.scale;
+        set->ranges[0][0] = view.min_x;
+        set->ranges[0][1] = view.max_x;
+        set->range_count = 1;
+        return true;
+    }
+
+    // Otherwise only the parts of the view uncovered by a pan
+    set->range_count = 0;
+    if (view.min_x < set->min_x) {
+        set->ranges[set->range_count][0] = view.min_x;
+        set->ranges[set->range_count++][1] = set->min_x;
+        set->min_x = view.min_x;
+    }
+    if (view.max_x > set->max_x) {
+        set->ranges[set->range_count][0] = set->max_x;
+        set->ranges[set->range_count++][1] = view.max_x;
+        set->max_x = view.max_x;
+    }
+
+    set->scale = fmin(set->scale, view.scale);
+    return set->range_count > 0;
+}
+
+static void copy_path(int index, bool *copied) {
+    if (copied[index]) return;
+
+    SamplePath *copy = &analysis.paths[index], *path = &analysis.expressions[index].path;
+    reserve((void **)&copy->points, &copy->capacity, path->count, sizeof(SamplePoint));
+    memcpy(copy->points, path->points, sizeof(SamplePoint) * path->count);
+    copy->count = path->count;
+    copied[index] = true;
+}
+
+static void publish(void) {
+    analysis.feature_count = 0;
+
+    // Features of curves since hidden stay in their sets, ready for when they're shown again
+    for (int i = 0; i < analysis.count; i++) {
+        if (!analysis.expressions[i].visible) continue;
+
+        for (int j = -1; j < analysis.count; j++) {
+            if (j >= 0 && (j <= i || !analysis.expressions[j].visible)) continue;
+
+            FeatureSet *set = get_set(i, j);
+            reserve((void **)&analysis.features, &analysis.feature_capacity, analysis.feature_count + set->count,
+                    sizeof(Feature));
+
+            for (int k = 0; k < set->count; k++) {
+                Feature feature = set->features[k];
+                feature.color = j < 0 ? analysis.expressions[i].color : COLOR_BRIGHT_WHITE;
+                analysis.features[analysis.feature_count++] = feature;
+            }
+        }
+    }
+}
+
+void analysis_init(ParsedExpression *expressions, int count) {
+    analysis.expressions = expressions;
+    analysis.count = count;
+    analysis.shown = true;
+    analysis.sets = calloc((size_t)count * (count + 1), sizeof(FeatureSet));
+    analysis.paths = calloc(count, sizeof(SamplePath));
+
+    for (int i = 0; i < count; i++) {
+        for (int j = -1; j < count; j++) *get_set(i, j) = (FeatureSet){.first = i, .second = j, .min_x = 1.0};
+    }
+}
+
+void analysis_schedule(SampleView view) {
+    if (!analysis.shown || scanning()) return;
+
+    // Rebuilt every frame so toggled curves show up or vanish right away
+    analysis.finished = false;
+    publish();
+
+    // Curves and pairs with unscanned parts of the view, each scanned by a task of its own
+    bool *ready = arena_alloc(&frame_arena, sizeof(bool) * 2 * analysis.count);
+    bool *copied = ready + analysis.count;
+    for (int i = 0; i < analysis.count; i++) {
+        ready[i] = eligible(i);
+        copied[i] = false;
+    }
+
+    for (int i = 0; i < analysis.count; i++) {
+        if (!ready[i]) continue;
+
+        for (int j = -1; j < analysis.count; j++) {
+            if (j >= 0 && (j <= i || !ready[j])) continue;
+
+            FeatureSet *set = get_set(i, j);
+            if (!plan_scan(set, view)) continue;
+
+            copy_path(i, copied);
+            if (j >= 0) copy_path(j, copied);
+            atomic_store(&set->cancelled, false);
+            pool_submit(&set->job, scan_task, set);
+            analysis.finished = true;
+        }
+    }
+}
+
+bool analysis_pending(void) {
+    return scanning() || analysis.finished;
+}
+
+const Feature *analysis_features(int *count) {
+    *count = analysis.shown ? analysis.feature_count : 0;
+    return analysis.features;
+}
+
+const char *analysis_kind_name(FeatureKind kind) {
+    return kind_names[kind];
+}
+
+static FeatureSet *set_with(int index, int j) {
+    // The curve alone for j < 0, otherwise its pair with j, kept under the lower index
+    return j < 0 || j > index ? get_set(index, j) : get_set(j, index);
+}
+
+void analysis_invalidate(int index) {
+    // Scans the curve is part of stop at their next step, the others keep running
+    for (int j = -1; j < analysis.count; j++) {
+        if (j != index) atomic_store(&set_with(index, j)->cancelled, true);
+    }
+
+    for (int j = -1; j < analysis.count; j++) {
+        if (j == index) continue;
+
+        FeatureSet *set = set_with(index, j);
+        pool_wait(&set->job);
+        set->count = 0;
+        set->min_x = 1.0;
+        set->max_x = 0.0;
+    }
+
+    // Its published features go right away, the rest are rebuilt from the sets once the running scans are done
+    int kept = 0;
+    for (int i = 0; i < analysis.feature_count; i++) {
+        Feature *feature = &analysis.features[i];
+        if (feature->curve != index && feature->other != index) analysis.features[kept++] = *feature;
+    }
+    analysis.feature_count = kept;
+}
+
+void analysis_toggle_markers(void) {
+    analysis.shown = !analysis.shown;
+}
+
+bool analysis_markers_shown(void) {
+    return analysis.shown;
+}
+
+void analysis_free(void) {
+    // Running scans are dropped rather than finished
+    for (int i = 0; i < analysis.count * (analysis.count + 1); i++) atomic_store(&analysis.sets[i].cancelled, true);
+    for (int i = 0; i < analysis.count * (analysis.count + 1); i++) pool_wait(&analysis.sets[i].job);
+
+    for (int i = 0; i < analysis.count; i++) {
+        for (int j = -1; j < analysis.count; j++) free(get_set(i, j)->features);
+        sample_path_free(&analysis.paths[i]);
+    }
+
+    free(analysis.sets);
+    free(analysis.paths);
+    free(analysis.features);
+    memset(&analysis, 0, sizeof(analysis));
+}
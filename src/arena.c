@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+Arena persistent_arena;
+Arena frame_arena;
+
+static size_t align_up(size_t size) {
+    return (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+}
+
+static void add_block(Arena *arena, size_t size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    *block = (ArenaBlock){.next = arena->head, .size = size};
+    arena->head = block;
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    *arena = (Arena){.block_size = align_up(block_size)};
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size);
+
+    // Start a new block when the current one is full, large requests get one of their own size
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        add_block(arena, size > arena->block_size ? size : arena->block_size);
+        block = arena->head;
+    }
+
+    void *memory = (char *)block->data + block->used;
+    block->used += size;
+    arena->total += size;
+    return memory;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    void *memory = arena_alloc(arena, count * size);
+    memset(memory, 0, count * size);
+    return memory;
+}
+
+char *arena_strdup(Arena *arena, const char *text) {
+    size_t length = strlen(text) + 1;
+    return memcpy(arena_alloc(arena, length), text, length);
+}
+
+void arena_reset(Arena *arena) {
+    // A single block already fits everything the arena held
+    if (arena->head != NULL && arena->head->next == NULL) {
+        arena->head->used = 0;
+        arena->total = 0;
+        return;
+    }
+
+    size_t size = 0;
+    for (ArenaBlock *block = arena->head; block != NULL; block = block->next) size += block->size;
+
+    arena_free(arena);
+    if (size > 0) add_block(arena, size);
+}
+
+void arena_free(Arena *arena) {
+    while (arena->head != NULL) {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+
+    arena->total = 0;
+}
@@ -0,0 +1,535 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compile.h"
+#include "jit.h"
+#include "kernels.h"
+
+// Function names recognized by the parser
+static const char *function_names[FUNC_COUNT] = {
+    [FUNC_SIN] = "sin",
+    [FUNC_COS] = "cos",
+    [FUNC_TAN] = "tan",
+    [FUNC_ASIN] = "arcsin",
+    [FUNC_ACOS] = "arccos",
+    [FUNC_ATAN] = "arctan",
+    [FUNC_SINH] = "sinh",
+    [FUNC_COSH] = "cosh",
+    [FUNC_TANH] = "tanh",
+    [FUNC_EXP] = "exp",
+    [FUNC_LN] = "ln",
+    [FUNC_LOG] = "log",
+    [FUNC_SQRT] = "sqrt",
+    [FUNC_ABS] = "abs",
+};
+
+static bool name_equals(const char *name, int length, const char *other) {
+    return (int)strlen(other) == length && strncmp(name, other, length) == 0;
+}
+
+// Operation in the merged graph, operands always come before the nodes using them
+typedef struct {
+    OpCode op;
+    FuncId func;
+    double value;
+    int a; // Operand nodes, -1 if unused
+    int b;
+} DagNode;
+
+// Hash-consed graph of every subexpression, identical operations are only added once
+typedef struct {
+    DagNode *nodes;
+    int count;
+    int capacity;
+    int *table; // Open addressing on node contents, -1 for empty slots
+    int table_capacity;
+    int tree_nodes;
+    int folded;
+    bool relation; // Accepts `y` as a second variable
+} Dag;
+
+static unsigned long long hash_node(const DagNode *node) {
+    unsigned long long bits;
+    memcpy(&bits, &node->value, sizeof(bits));
+
+    // FNV-1a style mixing of every field
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned long long fields[] = {node->op, node->func, bits, (unsigned long long)node->a, (unsigned long long)node->b};
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) hash = (hash ^ fields[i]) * 1099511628211ULL;
+
+    return hash;
+}
+
+static bool node_equals(const DagNode *a, const DagNode *b) {
+    // Constants compare by bits so -0 and 0 stay apart
+    return a->op == b->op && a->func == b->func && a->a == b->a && a->b == b->b &&
+           memcmp(&a->value, &b->value, sizeof(double)) == 0;
+}
+
+static void dag_grow_table(Dag *dag) {
+    free(dag->table);
+    dag->table_capacity = dag->table_capacity == 0 ? 64 : dag->table_capacity * 2;
+    dag->table = malloc(sizeof(int) * dag->table_capacity);
+    for (int i = 0; i < dag->table_capacity; i++) dag->table[i] = -1;
+
+    // Reinsert every node
+    for (int n = 0; n < dag->count; n++) {
+        int slot = (int)(hash_node(&dag->nodes[n]) & (dag->table_capacity - 1));
+        while (dag->table[slot] != -1) slot = (slot + 1) & (dag->table_capacity - 1);
+        dag->table[slot] = n;
+    }
+}
+
+static int dag_intern(Dag *dag, DagNode node) {
+    // Keep table at most half full
+    if (2 * (dag->count + 1) > dag->table_capacity) dag_grow_table(dag);
+
+    int slot = (int)(hash_node(&node) & (dag->table_capacity - 1));
+    for (; dag->table[slot] != -1; slot = (slot + 1) & (dag->table_capacity - 1)) {
+        if (node_equals(&dag->nodes[dag->table[slot]], &node)) return dag->table[slot];
+    }
+
+    // Grow node array if needed
+    if (dag->count == dag->capacity) {
+        dag->capacity = dag->capacity == 0 ? 64 : dag->capacity * 2;
+        dag->nodes = realloc(dag->nodes, sizeof(DagNode) * dag->capacity);
+    }
+
+    dag->nodes[dag->count] = node;
+    dag->table[slot] = dag->count;
+    return dag->count++;
+}
+
+static int dag_constant(Dag *dag, double value) {
+    return dag_intern(dag, (DagNode){.op = OP_CONST, .value = value, .a = -1, .b = -1});
+}
+
+static bool is_constant(Dag *dag, int node) {
+    return dag->nodes[node].op == OP_CONST;
+}
+
+static int dag_unary(Dag *dag, OpCode op, FuncId func, int a) {
+    // Fold with the scalar kernels so results match the tree walk
+    if (is_constant(dag, a)) {
+        const Kernels *scalar = kernels_get(KERNELS_SCALAR);
+        double value = dag->nodes[a].value;
+        if (op == OP_NEG) scalar->neg(&value, 1);
+        else scalar->call[func](&value, 1);
+
+        dag->folded++;
+        return dag_constant(dag, value);
+    }
+
+    return dag_intern(dag, (DagNode){.op = op, .func = func, .a = a, .b = -1});
+}
+
+static int dag_binary(Dag *dag, OpCode op, int a, int b) {
+    if (is_constant(dag, a) && is_constant(dag, b)) {
+        const Kernels *scalar = kernels_get(KERNELS_SCALAR);
+        double value = dag->nodes[a].value, other = dag->nodes[b].value;
+        switch (op) {
+            case OP_ADD: scalar->add(&value, &other, 1); break;
+            case OP_SUB: scalar->sub(&value, &other, 1); break;
+            case OP_MUL: scalar->mul(&value, &other, 1); break;
+            case OP_DIV: scalar->div(&value, &other, 1); break;
+            default:     scalar->pow(&value, &other, 1); break;
+        }
+
+        dag->folded++;
+        return dag_constant(dag, value);
+    }
+
+    // Addition and multiplication are exactly commutative, so operand order is irrelevant
+    if ((op == OP_ADD || op == OP_MUL) && a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+
+    return dag_intern(dag, (DagNode){.op = op, .a = a, .b = b});
+}
+
+static int dag_add(Dag *dag, Node *node) {
+    dag->tree_nodes++;
+
+    switch (node->type) {
+        case NODE_NUMBER:
+            return dag_constant(dag, node->as.number);
+
+        case NODE_VARIABLE:
+            // Every other variable is only known to the symbol table
+            if (name_equals(node->as.variable.name, node->as.variable.length, "x"))
+                return dag_intern(dag, (DagNode){.op = OP_X, .a = -1, .b = -1});
+            if (dag->relation && name_equals(node->as.variable.name, node->as.variable.length, "y"))
+                return dag_intern(dag, (DagNode){.op = OP_Y, .a = -1, .b = -1});
+            return -1;
+
+        case NODE_UNARY: {
+            int operand = dag_add(dag, node->as.unary.operand);
+            if (operand < 0) return -1;
+            if (node->as.unary.op == TOKEN_PLUS) return operand;
+            if (node->as.unary.op != TOKEN_MINUS) return -1;
+            return dag_unary(dag, OP_NEG, 0, operand);
+        }
+
+        case NODE_BINARY: {
+            int left = dag_add(dag, node->as.binary.left);
+            if (left < 0) return -1;
+            int right = dag_add(dag, node->as.binary.right);
+            if (right < 0) return -1;
+
+            OpCode op;
+            switch (node->as.binary.op) {
+                case TOKEN_PLUS:  op = OP_ADD; break;
+                case TOKEN_MINUS: op = OP_SUB; break;
+                case TOKEN_STAR:  op = OP_MUL; break;
+                case TOKEN_SLASH: op = OP_DIV; break;
+                case TOKEN_CARET: op = OP_POW; break;
+                default: return -1;
+            }
+
+            return dag_binary(dag, op, left, right);
+        }
+
+        case NODE_CALL: {
+            int operand = dag_add(dag, node->as.call.argument);
+            if (operand < 0) return -1;
+
+            for (int i = 0; i < FUNC_COUNT; i++) {
+                if (name_equals(node->as.call.name, node->as.call.length, function_names[i]))
+                    return dag_unary(dag, OP_CALL, (FuncId)i, operand);
+            }
+
+            return -1;
+        }
+
+        default:
+            return -1;
+    }
+}
+
+static bool is_value(Dag *dag, int node, double value) {
+    return is_constant(dag, node) && dag->nodes[node].value == value;
+}
+
+// Tangent arithmetic drops the terms known to vanish, so derivatives of the usual curves stay short.
+// Zero tangents are exact: a term multiplied by one is zero even where the other factor is infinite.
+static int tangent_add(Dag *dag, int a, int b) {
+    if (is_value(dag, a, 0.0)) return b;
+    if (is_value(dag, b, 0.0)) return a;
+    return dag_binary(dag, OP_ADD, a, b);
+}
+
+static int tangent_sub(Dag *dag, int a, int b) {
+    if (is_value(dag, b, 0.0)) return a;
+    if (is_value(dag, a, 0.0)) return dag_unary(dag, OP_NEG, 0, b);
+    return dag_binary(dag, OP_SUB, a, b);
+}
+
+static int tangent_mul(Dag *dag, int a, int b) {
+    if (is_value(dag, a, 0.0) || is_value(dag, b, 0.0)) return dag_constant(dag, 0.0);
+    if (is_value(dag, a, 1.0)) return b;
+    if (is_value(dag, b, 1.0)) return a;
+    return dag_binary(dag, OP_MUL, a, b);
+}
+
+static int tangent_div(Dag *dag, int a, int b) {
+    if (is_value(dag, a, 0.0)) return a;
+    if (is_value(dag, b, 1.0)) return a;
+    return dag_binary(dag, OP_DIV, a, b);
+}
+
+static int call(Dag *dag, FuncId func, int a) {
+    return dag_unary(dag, OP_CALL, func, a);
+}
+
+static int derivative_factor(Dag *dag, int n) {
+    // Derivative of a function at its argument, the node itself standing for the function's value
+    DagNode node = dag->nodes[n];
+    int one = dag_constant(dag, 1.0), a = node.a;
+
+    switch (node.func) {
+        case FUNC_SIN:  return call(dag, FUNC_COS, a);
+        case FUNC_COS:  return dag_unary(dag, OP_NEG, 0, call(dag, FUNC_SIN, a));
+        case FUNC_TAN:  return dag_binary(dag, OP_ADD, one, dag_binary(dag, OP_MUL, n, n));
+        case FUNC_ASIN:
+        case FUNC_ACOS: {
+            // 1 / sqrt(1 - a^2), negated for arccos
+            int root = call(dag, FUNC_SQRT, dag_binary(dag, OP_SUB, one, dag_binary(dag, OP_MUL, a, a)));
+            int factor = dag_binary(dag, OP_DIV, one, root);
+            return node.func == FUNC_ASIN ? factor : dag_unary(dag, OP_NEG, 0, factor);
+        }
+
+        case FUNC_ATAN: {
+            int square = dag_binary(dag, OP_MUL, a, a);
+            return dag_binary(dag, OP_DIV, one, dag_binary(dag, OP_ADD, one, square));
+        }
+
+        case FUNC_SINH: return call(dag, FUNC_COSH, a);
+        case FUNC_COSH: return call(dag, FUNC_SINH, a);
+        case FUNC_TANH: return dag_binary(dag, OP_SUB, one, dag_binary(dag, OP_MUL, n, n));
+        case FUNC_EXP:  return n;
+        case FUNC_LN:   return dag_binary(dag, OP_DIV, one, a);
+        case FUNC_LOG:  return dag_binary(dag, OP_DIV, one, dag_binary(dag, OP_MUL, a, dag_constant(dag, log(10.0))));
+        case FUNC_SQRT: return dag_binary(dag, OP_DIV, dag_constant(dag, 0.5), n);
+        default:        return dag_binary(dag, OP_DIV, a, n); // Sign of the argument, undefined at zero
+    }
+}
+
+static int dag_derivative(Dag *dag, int root) {
+    // Only nodes the root depends on need a tangent
+    bool *needed = calloc(root + 1, sizeof(bool));
+    int *tangents = malloc(sizeof(int) * (root + 1));
+    needed[root] = true;
+    for (int n = root; n >= 0; n--) {
+        if (!needed[n]) continue;
+        if (dag->nodes[n].a >= 0) needed[dag->nodes[n].a] = true;
+        if (dag->nodes[n].b >= 0) needed[dag->nodes[n].b] = true;
+    }
+
+    // Forward mode: nodes come after their operands, so each tangent is built from tangents already known.
+    // New nodes are appended past the root, so the graph is copied from rather than pointed into.
+    for (int n = 0; n <= root; n++) {
+        if (!needed[n]) continue;
+
+        DagNode node = dag->nodes[n];
+        int a = node.a, b = node.b;
+        int ta = a >= 0 ? tangents[a] : -1, tb = b >= 0 ? tangents[b] : -1;
+
+        switch (node.op) {
+            case OP_X:   tangents[n] = dag_constant(dag, 1.0); break;
+            case OP_NEG: tangents[n] = dag_unary(dag, OP_NEG, 0, ta); break;
+            case OP_ADD: tangents[n] = tangent_add(dag, ta, tb); break;
+            case OP_SUB: tangents[n] = tangent_sub(dag, ta, tb); break;
+
+            case OP_MUL:
+                tangents[n] = tangent_add(dag, tangent_mul(dag, ta, b), tangent_mul(dag, a, tb));
+                break;
+
+            case OP_DIV:
+                // (a / b)' = (a' - (a / b) b') / b
+                tangents[n] = tangent_div(dag, tangent_sub(dag, ta, tangent_mul(dag, n, tb)), b);
+                break;
+
+            case OP_POW:
+                // Constant exponents keep negative bases in the domain, otherwise (a^b)' = a^b (b' ln a + b a' / a)
+                if (is_value(dag, tb, 0.0)) {
+                    int exponent = dag_binary(dag, OP_SUB, b, dag_constant(dag, 1.0));
+                    int power;
+                    if (is_value(dag, exponent, 0.0)) power = dag_constant(dag, 1.0);
+                    else if (is_value(dag, exponent, 1.0)) power = a;
+                    else power = dag_binary(dag, OP_POW, a, exponent);
+                    tangents[n] = tangent_mul(dag, tangent_mul(dag, b, power), ta);
+                } else {
+                    int log_term = tangent_mul(dag, tb, call(dag, FUNC_LN, a));
+                    int base_term = tangent_div(dag, tangent_mul(dag, b, ta), a);
+                    tangents[n] = tangent_mul(dag, n, tangent_add(dag, log_term, base_term));
+                }
+                break;
+
+            case OP_CALL:
+                tangents[n] = is_value(dag, ta, 0.0) ? ta : tangent_mul(dag, derivative_factor(dag, n), ta);
+                break;
+
+            default:
+                // Constants, and y which never varies with x in a function
+                tangents[n] = dag_constant(dag, 0.0);
+                break;
+        }
+    }
+
+    int tangent = tangents[root];
+    free(needed);
+    free(tangents);
+    return tangent;
+}
+
+static void dag_free(Dag *dag) {
+    free(dag->nodes);
+    free(dag->table);
+    *dag = (Dag){0};
+}
+
+static void emit(Program *program, Instruction instruction) {
+    // Grow code array if needed
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity == 0 ? 16 : program->capacity * 2;
+        program->code = realloc(program->code, sizeof(Instruction) * program->capacity);
+    }
+
+    program->code[program->count++] = instruction;
+}
+
+static bool lower(Program *program, Dag *dag, const int *roots, int count, int *node_count) {
+    int *uses = calloc(dag->count, sizeof(int));
+    int *registers = malloc(sizeof(int) * dag->count);
+    int free_registers[PROGRAM_MAX_REGISTERS], free_count = 0;
+    bool ok = true;
+
+    // Count uses of every node reachable from the roots, walking back from the last node
+    for (int i = 0; i < count; i++) uses[roots[i]]++;
+    for (int n = dag->count - 1; n >= 0; n--) {
+        if (uses[n] == 0) continue;
+        if (dag->nodes[n].a >= 0) uses[dag->nodes[n].a]++;
+        if (dag->nodes[n].b >= 0) uses[dag->nodes[n].b]++;
+    }
+
+    // Nodes are already in dependency order, registers are released after their last use
+    *node_count = 0;
+    for (int n = 0; n < dag->count && ok; n++) {
+        if (uses[n] == 0) continue;
+        (*node_count)++;
+
+        DagNode *node = &dag->nodes[n];
+        if (node->a >= 0) uses[node->a]--;
+        if (node->b >= 0) uses[node->b]--;
+        bool a_done = node->a >= 0 && uses[node->a] == 0;
+        bool b_done = node->b >= 0 && uses[node->b] == 0;
+
+        // Write over the first operand when it's no longer needed
+        int dst;
+        if (a_done) dst = registers[node->a];
+        else if (free_count > 0) dst = free_registers[--free_count];
+        else if (program->registers < PROGRAM_MAX_REGISTERS) dst = program->registers++;
+        else {
+            ok = false;
+            break;
+        }
+
+        if (b_done && registers[node->b] != dst) free_registers[free_count++] = registers[node->b];
+        registers[n] = dst;
+
+        int a = node->a >= 0 ? registers[node->a] : 0;
+        int b = node->b >= 0 ? registers[node->b] : 0;
+        emit(program, (Instruction){.op = node->op, .func = node->func, .value = node->value, .dst = dst, .a = a, .b = b});
+
+        for (int i = 0; i < count; i++) {
+            if (roots[i] != n) continue;
+            emit(program, (Instruction){.op = OP_STORE, .dst = i, .a = dst});
+            uses[n]--;
+        }
+
+        if (uses[n] == 0) free_registers[free_count++] = dst;
+    }
+
+    program->outputs = count;
+    free(uses);
+    free(registers);
+    return ok;
+}
+
+static bool compile(Program *program, Node **roots, const int *orders, int count, ProgramSharing *sharing,
+                    bool relation) {
+    *program = (Program){0};
+    Dag dag = {.relation = relation};
+    int *indices = malloc(sizeof(int) * (count > 0 ? count : 1));
+    bool ok = count > 0;
+
+    // Merge every tree into the same graph, derivatives sharing it with the functions they come from
+    for (int i = 0; i < count && ok; i++) {
+        indices[i] = roots[i] != NULL ? dag_add(&dag, roots[i]) : -1;
+        ok = indices[i] >= 0;
+        for (int order = 0; ok && orders != NULL && order < orders[i]; order++)
+            indices[i] = dag_derivative(&dag, indices[i]);
+    }
+
+    int nodes = 0;
+    if (ok) ok = lower(program, &dag, indices, count, &nodes);
+    if (!ok) program_free(program);
+
+    if (sharing != NULL) *sharing = (ProgramSharing){dag.tree_nodes, nodes, dag.folded};
+
+    free(indices);
+    dag_free(&dag);
+    return ok;
+}
+
+bool program_compile_shared(Program *program, Node **roots, const int *orders, int count, ProgramSharing *sharing) {
+    return compile(program, roots, orders, count, sharing, false);
+}
+
+bool program_compile(Program *program, Node *root) {
+    return compile(program, &root, NULL, 1, NULL, false);
+}
+
+bool program_compile_derivative(Program *program, Node *root, int order) {
+    return compile(program, &root, &order, 1, NULL, false);
+}
+
+bool program_compile_relation(Program *program, Node *root) {
+    return compile(program, &root, NULL, 1, NULL, true);
+}
+
+static void move(double *dst, const double *src, int n) {
+    if (dst != src) memcpy(dst, src, sizeof(double) * n);
+}
+
+static void evaluate_batch(const Program *program, const double *xs, const double *ys_in, double *ys, int stride,
+                           int n) {
+    double registers[PROGRAM_MAX_REGISTERS][PROGRAM_BATCH];
+
+    for (int pc = 0; pc < program->count; pc++) {
+        const Instruction *in = &program->code[pc];
+        double *dst = registers[in->dst];
+        const double *a = registers[in->a], *b = registers[in->b];
+
+        // Each operation runs over the whole batch before moving on
+        switch (in->op) {
+            case OP_CONST:
+                for (int i = 0; i < n; i++) dst[i] = in->value;
+                break;
+
+            case OP_X:    memcpy(dst, xs, sizeof(double) * n); break;
+            case OP_Y:    memcpy(dst, ys_in, sizeof(double) * n); break;
+            case OP_NEG:  move(dst, a, n); kernels->neg(dst, n); break;
+            case OP_ADD:  move(dst, a, n); kernels->add(dst, b, n); break;
+            case OP_SUB:  move(dst, a, n); kernels->sub(dst, b, n); break;
+            case OP_MUL:  move(dst, a, n); kernels->mul(dst, b, n); break;
+            case OP_DIV:  move(dst, a, n); kernels->div(dst, b, n); break;
+            case OP_POW:  move(dst, a, n); kernels->pow(dst, b, n); break;
+            case OP_CALL: move(dst, a, n); kernels->call[in->func](dst, n); break;
+            case OP_STORE: memcpy(ys + (size_t)in->dst * stride, a, sizeof(double) * n); break;
+        }
+    }
+}
+
+static void evaluate_native(const Program *program, const double *xs, const double *ys_in, double *ys, int stride,
+                            int n) {
+    // Aligned for the memory operands of SSE2 instructions
+    _Alignas(32) double registers[PROGRAM_MAX_REGISTERS][PROGRAM_BATCH];
+
+    // Native code works on whole vectors, samples left over go through the interpreter with the same kernels
+    int vectors = n / program->native_lanes, done = vectors * program->native_lanes;
+    if (vectors > 0) program->native(registers, xs, ys_in, ys, (long)stride * (long)sizeof(double), vectors);
+    if (done < n) evaluate_batch(program, xs + done, ys_in != NULL ? ys_in + done : NULL, ys + done, stride, n - done);
+}
+
+static void evaluate(const Program *program, const double *xs, const double *ys_in, double *ys, int stride, int count) {
+    // Split input into batches that fit the registers
+    for (int start = 0; start < count; start += PROGRAM_BATCH) {
+        int n = count - start < PROGRAM_BATCH ? count - start : PROGRAM_BATCH;
+        const double *batch_ys_in = ys_in != NULL ? ys_in + start : NULL;
+
+        if (program->native != NULL) evaluate_native(program, xs + start, batch_ys_in, ys + start, stride, n);
+        else evaluate_batch(program, xs + start, batch_ys_in, ys + start, stride, n);
+    }
+}
+
+void program_evaluate_shared(const Program *program, const double *xs, double *ys, int stride, int count) {
+    evaluate(program, xs, NULL, ys, stride, count);
+}
+
+void program_evaluate(const Program *program, const double *xs, double *ys, int count) {
+    program_evaluate_shared(program, xs, ys, 0, count);
+}
+
+void program_evaluate_relation(const Program *program, const double *xs, const double *ys, double *values, int count) {
+    evaluate(program, xs, ys, values, 0, count);
+}
+
+void program_free(Program *program) {
+    jit_free(program);
+    free(program->code);
+    *program = (Program){0};
+}
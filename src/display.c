@@ -0,0 +1,88 @@
+#include <math.h>
+#include <raylib.h>
+#include <rlgl.h>
+
+#include "common.h"
+#include "display.h"
+
+Display display;
+
+static bool read_window(int *width, int *height, float *scale) {
+    // Minimized windows report no size
+    *width = GetScreenWidth();
+    *height = GetScreenHeight();
+    if (IsWindowMinimized() || *width <= 0 || *height <= 0) return false;
+
+    // Framebuffer is larger than the window on high DPI displays
+    *scale = (float)GetRenderWidth() / *width;
+    if (*scale <= 0.0f) *scale = 1.0f;
+
+    return true;
+}
+
+void display_init(float quality) {
+    display = (Display){.width = WIDTH, .height = HEIGHT, .scale = 1.0f, .quality = quality, .max_quality = quality};
+    read_window(&display.width, &display.height, &display.scale);
+}
+
+bool display_update(void) {
+    int width, height;
+    float scale;
+    if (!read_window(&width, &height, &scale)) return false;
+    if (width == display.width && height == display.height && scale == display.scale) return false;
+
+    display.width = width;
+    display.height = height;
+    display.scale = scale;
+    return true;
+}
+
+Vector2 display_center(void) {
+    return (Vector2){display.width / 2.0f, display.height / 2.0f};
+}
+
+bool display_adapt(double frame_time) {
+    // Count drawn frames in a row on either side of the budget, the ones in between break both runs
+    display.slow_frames = frame_time > QUALITY_FRAME_BUDGET ? display.slow_frames + 1 : 0;
+    display.fast_frames = frame_time < QUALITY_FRAME_BUDGET / 2.0 ? display.fast_frames + 1 : 0;
+
+    // Halve the quality after a run of slow frames
+    if (display.slow_frames >= QUALITY_SLOW_FRAMES && display.quality / 2.0f >= QUALITY_MIN) {
+        display.quality /= 2.0f;
+        display.slow_frames = 0;
+        TraceLog(LOG_INFO, "Frames over budget, sampling at %g samples per pixel", display.quality);
+        return true;
+    }
+
+    // Double it back after a longer run of fast ones
+    if (display.fast_frames >= QUALITY_FAST_FRAMES && display.quality < display.max_quality) {
+        display.quality = fminf(display.quality * 2.0f, display.max_quality);
+        display.fast_frames = 0;
+        return true;
+    }
+
+    return false;
+}
+
+RenderTexture2D display_load_texture(int width, int height) {
+    return LoadRenderTexture((int)ceilf(width * display.scale), (int)ceilf(height * display.scale));
+}
+
+void display_begin_texture(RenderTexture2D target) {
+    BeginTextureMode(target);
+
+    // Project screen coordinates onto every framebuffer pixel of the texture
+    rlMatrixMode(RL_PROJECTION);
+    rlLoadIdentity();
+    rlOrtho(0, target.texture.width / display.scale, target.texture.height / display.scale, 0, 0.0, 1.0);
+    rlMatrixMode(RL_MODELVIEW);
+}
+
+void display_draw_texture(RenderTexture2D target, Vector2 position) {
+    // Render textures are stored upside down
+    Texture2D texture = target.texture;
+    Rectangle source = {0, 0, texture.width, -texture.height};
+    Rectangle dest = {position.x, position.y, texture.width / display.scale, texture.height / display.scale};
+
+    DrawTexturePro(texture, source, dest, (Vector2){0, 0}, 0.0f, WHITE);
+}
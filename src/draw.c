@@ -1,9 +1,23 @@
+#include <float.h>
+#include <limits.h>
 #include <math.h>
 #include <raylib.h>
 #include <raymath.h>
+#include <rlgl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "analysis.h"
+#include "arena.h"
 #include "common.h"
+#include "display.h"
 #include "draw.h"
+#include "field.h"
+#include "implicit.h"
+#include "parametric.h"
+#include "sampler.h"
+#include "update.h"
 
 // Helper to hold view bounds
 typedef struct {
@@ -15,166 +29,455 @@ static ViewContext get_view_context(Camera2D *camera) {
     // Get screen vertices in world space
     return (ViewContext){
         .min = GetScreenToWorld2D((Vector2){0, 0}, *camera),
-        .max = GetScreenToWorld2D((Vector2){WIDTH, HEIGHT}, *camera),
+        .max = GetScreenToWorld2D((Vector2){display.width, display.height}, *camera),
     };
 }
 
-static Vector2 get_grid_range(float min, float max, float spacing) {
-    // Compute start and end points for grid lines
-    float start = floorf(min / spacing) * spacing;
-    float end = ceilf(max / spacing) * spacing;
+static double world_to_math_x(float x) {
+    // Convert to math units, from the world's origin
+    return world_origin.x + x / (double)GRID_PIXELS_PER_UNIT;
+}
 
-    return (Vector2){start, end};
+static double world_to_math_y(float y) {
+    return world_origin.y - y / (double)GRID_PIXELS_PER_UNIT;
 }
 
-static float pixels_to_math(float px) {
-    // Convert to math units
-    return px / GRID_INITIAL_SPACING * GRID_UNITS_PER_SPACE;
+static Vector2 math_to_world(double x, double y) {
+    // Convert to pixels, only the offset from the world's origin is narrowed to floats
+    return (Vector2){(float)((x - world_origin.x) * GRID_PIXELS_PER_UNIT),
+                     (float)((world_origin.y - y) * GRID_PIXELS_PER_UNIT)};
 }
 
-static float math_to_pixels(float math) {
-    // Convert to pixels
-    return math / GRID_UNITS_PER_SPACE * GRID_INITIAL_SPACING;
+Color grid_line_color(long index) {
+    // Make major lines brighter, and axes brightest
+    Color color = COLOR_BRIGHT_WHITE;
+    color.a = (index % GRID_MAJOR_STEP == 0) ? GRID_MAJOR_OPACITY : GRID_MINOR_OPACITY;
+    if (index == 0) color.a = 255;
+
+    return color;
 }
 
-void draw_grid(Camera2D *camera, float dynamic_spacing) {
+static void rasterize_grid_lines(GridCache *cache, Camera2D *camera, float dynamic_spacing) {
+    // Cover the screen plus a margin, so pans only rasterize again once they leave it
+    float margin = GRID_CACHE_MARGIN / camera->zoom;
     ViewContext ctx = get_view_context(camera);
-    Vector2 x_range = get_grid_range(ctx.min.x, ctx.max.x, dynamic_spacing);
-    Vector2 y_range = get_grid_range(ctx.min.y, ctx.max.y, dynamic_spacing);
-
-    // Apply grid render buffer to coordinates so that a few lines are rendered beyond the screen
-    x_range.x -= GRID_RENDER_BUFFER * dynamic_spacing;
-    x_range.y += GRID_RENDER_BUFFER * dynamic_spacing;
-    y_range.x -= GRID_RENDER_BUFFER * dynamic_spacing;
-    y_range.y += GRID_RENDER_BUFFER * dynamic_spacing;
-
-    // Draw vertical lines
-    for (float x = x_range.x; x <= x_range.y; x += dynamic_spacing) {
-        // Make major lines brighter
-        Color color = COLOR_BRIGHT_WHITE;
-        int line_index = (int)lroundf(x / dynamic_spacing);
-        color.a = (line_index % GRID_MAJOR_STEP == 0) ? GRID_MAJOR_OPACITY : GRID_MINOR_OPACITY;
-        if (fabsf(x) < GRID_AXIS_THRESHOLD) color.a = 255;
-
-        DrawLineV((Vector2){x, ctx.min.y}, (Vector2){x, ctx.max.y}, color);
+    ctx.min = Vector2SubtractValue(ctx.min, margin);
+    ctx.max = Vector2AddValue(ctx.max, margin);
+
+    double step = dynamic_spacing / (double)GRID_PIXELS_PER_UNIT;
+    GridRange x_range = grid_range(world_to_math_x(ctx.min.x), world_to_math_x(ctx.max.x), step);
+    GridRange y_range = grid_range(world_to_math_y(ctx.max.y), world_to_math_y(ctx.min.y), step);
+
+    // Texture's top-left corner sits on the covered region's, at the same zoom
+    Camera2D texture_camera = {.target = ctx.min, .zoom = camera->zoom};
+
+    // Lines are kept with premultiplied coverage like the labels, so fields show through between them
+    display_begin_texture(cache->lines);
+    ClearBackground(BLANK);
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD,
+                              RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+    BeginMode2D(texture_camera);
+
+    // Draw vertical lines, placed in math units so they stay on multiples of the step at any zoom
+    for (long i = x_range.first; i <= x_range.last; i++) {
+        float x = math_to_world(i * step, 0.0).x;
+        DrawLineV((Vector2){x, ctx.min.y}, (Vector2){x, ctx.max.y}, grid_line_color(i));
     }
 
     // Draw horizontal lines
-    for (float y = y_range.x; y <= y_range.y; y += dynamic_spacing) {
-        // Make major lines brighter
-        Color color = COLOR_BRIGHT_WHITE;
-        int line_index = (int)lroundf(y / dynamic_spacing);
-        color.a = (line_index % GRID_MAJOR_STEP == 0) ? GRID_MAJOR_OPACITY : GRID_MINOR_OPACITY;
-        if (fabsf(y) < GRID_AXIS_THRESHOLD) color.a = 255;
-
-        DrawLineV((Vector2){ctx.min.x, y}, (Vector2){ctx.max.x, y}, color);
+    for (long i = y_range.first; i <= y_range.last; i++) {
+        float y = math_to_world(0.0, i * step).y;
+        DrawLineV((Vector2){ctx.min.x, y}, (Vector2){ctx.max.x, y}, grid_line_color(i));
     }
-}
 
-void draw_grid_labels(Camera2D *camera, float dynamic_spacing) {
-    ViewContext ctx = get_view_context(camera);
-    Vector2 x_range = get_grid_range(ctx.min.x, ctx.max.x, dynamic_spacing);
-    Vector2 y_range = get_grid_range(ctx.min.y, ctx.max.y, dynamic_spacing);
-    Vector2 origin_screen = GetWorldToScreen2D((Vector2){0, 0}, *camera);
-
-    // Calculate text width
-    const char *zero_text = "0";
-    int zero_width = MeasureText(zero_text, GRID_LABEL_SIZE);
-
-    // Clamp X and Y positions so origin label stays visible at screen edges
-    float zero_x = Clamp(origin_screen.x, GRID_LABEL_CLAMP_OFFSET + zero_width + GRID_LABEL_OFFSET,
-                         (float)WIDTH + GRID_LABEL_OFFSET - GRID_LABEL_CLAMP_OFFSET);
-    float zero_y = Clamp(origin_screen.y, GRID_LABEL_CLAMP_OFFSET - GRID_LABEL_OFFSET,
-                         (float)HEIGHT - GRID_LABEL_SIZE - GRID_LABEL_CLAMP_OFFSET);
-
-    // Draw origin label at clamped X and Y positions
-    DrawText(zero_text, (int)zero_x - zero_width - (int)GRID_LABEL_OFFSET, (int)zero_y + (int)GRID_LABEL_OFFSET,
-        GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
-
-    // Draw X labels
-    for (float x = x_range.x; x <= x_range.y; x += dynamic_spacing) {
-        // Skip if zero or not a major grid line
-        int line_index = (int)lroundf(x / dynamic_spacing);
-        if (line_index % GRID_MAJOR_STEP != 0 || line_index == 0) continue;
+    EndMode2D();
+    EndBlendMode();
+    EndTextureMode();
 
-        // Get X position in screen space
-        Vector2 pos_world = {x, 0};
-        Vector2 pos_screen = GetWorldToScreen2D(pos_world, *camera);
+    cache->lines_min = ctx.min;
+    cache->lines_max = ctx.max;
+    cache->lines_zoom = camera->zoom;
+    cache->lines_spacing = dynamic_spacing;
+    cache->lines_origin = world_origin.version;
+    cache->lines_valid = true;
+}
 
-        // Calculate text width
-        float math_value = pixels_to_math(x);
-        const char* text = TextFormat("%g", math_value);
-        int text_width = MeasureText(text, GRID_LABEL_SIZE);
+GridRange grid_range(double min, double max, double step) {
+    // Compute indices of the lines around the range in math units, positions are `index * step`
+    return (GridRange){(long)floor(min / step), (long)ceil(max / step)};
+}
 
-        // Clamp Y position so labels stay visible at screen edges
-        float label_y = Clamp(origin_screen.y, GRID_LABEL_CLAMP_OFFSET - GRID_LABEL_OFFSET,
-                              (float)HEIGHT - GRID_LABEL_SIZE - GRID_LABEL_CLAMP_OFFSET);
+int grid_label_digits(double value, double step) {
+    // Enough digits to tell labels `step` apart, however far they are from zero
+    int digits = (int)ceil(log10(fmax(fabs(value), step) / step)) + GRID_LABEL_DIGITS;
+    return digits > DBL_DECIMAL_DIG ? DBL_DECIMAL_DIG : digits;
+}
 
-        // Draw labels at line X position and clamped Y position
-        DrawText(text, (int)pos_screen.x - text_width / 2, (int)label_y + (int)GRID_LABEL_OFFSET,
-                 GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+static const GridLabel *get_label(GridCache *cache, double value, double step) {
+    int digits = grid_label_digits(value, step);
+
+    // Look label up by value, formatting and measuring it only on a miss
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits ^= bits >> 32;
+    GridLabel *label = &cache->labels[(bits ^ (bits >> 13)) * 2654435761u % GRID_LABEL_CACHE_SIZE];
+
+    if (!label->used || label->value != value || label->digits != digits) {
+        snprintf(label->text, sizeof(label->text), "%.*g", digits, value);
+        label->width = MeasureText(label->text, GRID_LABEL_SIZE);
+        label->value = value;
+        label->digits = digits;
+        label->used = true;
     }
 
-    // Draw Y labels
-    for (float y = y_range.x; y <= y_range.y; y += dynamic_spacing) {
+    return label;
+}
+
+float grid_label_row_y(float axis_y, float height) {
+    float bottom = height - GRID_LABEL_SIZE - GRID_LABEL_CLAMP_OFFSET;
+    return Clamp(axis_y, GRID_LABEL_CLAMP_OFFSET - GRID_LABEL_OFFSET, bottom) + GRID_LABEL_OFFSET;
+}
+
+float grid_label_edge(float axis_x, float width) {
+    return fminf(axis_x, width + GRID_LABEL_OFFSET - GRID_LABEL_CLAMP_OFFSET) - GRID_LABEL_OFFSET;
+}
+
+float grid_label_column_x(float edge, int text_width) {
+    // Labels too wide to fit left of the edge stop at the left edge of the screen
+    return fmaxf(edge - text_width, GRID_LABEL_CLAMP_OFFSET);
+}
+
+static float label_edge(float axis_x) {
+    return grid_label_edge(axis_x, (float)display.width);
+}
+
+static GridLabelLayout label_layout(GridCache *cache, float edge) {
+    if (edge - cache->labels_max_width >= GRID_LABEL_CLAMP_OFFSET) return GRID_LABELS_ALIGNED;
+    if (edge - cache->labels_min_width <= GRID_LABEL_CLAMP_OFFSET) return GRID_LABELS_CLAMPED;
+    return GRID_LABELS_MIXED;
+}
+
+static void begin_label_texture(RenderTexture2D target) {
+    // Keep coverage in the alpha channel and premultiply colors, so the texture blends like direct drawing
+    display_begin_texture(target);
+    ClearBackground(BLANK);
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD,
+                              RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+}
+
+static void end_label_texture(void) {
+    EndBlendMode();
+    EndTextureMode();
+}
+
+static void rasterize_grid_labels(GridCache *cache, Camera2D *camera) {
+    // Labels of the major lines in the region covered by the lines, placed from its top-left corner
+    double step = cache->lines_spacing / (double)GRID_PIXELS_PER_UNIT;
+    double label_step = step * GRID_MAJOR_STEP;
+    GridRange x_range = grid_range(world_to_math_x(cache->lines_min.x), world_to_math_x(cache->lines_max.x), step);
+    GridRange y_range = grid_range(world_to_math_y(cache->lines_max.y), world_to_math_y(cache->lines_min.y), step);
+    Camera2D texture_camera = {.target = cache->lines_min, .zoom = cache->lines_zoom};
+
+    // Draw X labels centered on their lines, the row is moved onto the axis when drawn
+    begin_label_texture(cache->x_labels);
+    for (long i = x_range.first; i <= x_range.last; i++) {
         // Skip if zero or not a major grid line
-        int line_index = (int)lroundf(y / dynamic_spacing);
-        if (line_index % GRID_MAJOR_STEP != 0 || line_index == 0) continue;
+        if (i % GRID_MAJOR_STEP != 0 || i == 0) continue;
 
-        // Get Y position in screen space
-        Vector2 pos_world = {0, y};
-        Vector2 pos_screen = GetWorldToScreen2D(pos_world, *camera);
+        const GridLabel *label = get_label(cache, i * step, label_step);
+        float x = GetWorldToScreen2D(math_to_world(i * step, 0.0), texture_camera).x;
+        DrawText(label->text, (int)x - label->width / 2, 0, GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+    }
+    end_label_texture();
 
-        // Calculate text width
-        float math_value = pixels_to_math(-y);
-        const char* text = TextFormat("%g", math_value);
-        int text_width = MeasureText(text, GRID_LABEL_SIZE);
+    // Widths of the Y labels decide whether the column can follow the axis as a whole
+    cache->labels_min_width = INT_MAX;
+    cache->labels_max_width = 0;
+    for (long i = y_range.first; i <= y_range.last; i++) {
+        if (i % GRID_MAJOR_STEP != 0 || i == 0) continue;
 
-        // Clamp X position so labels stay visible at screen edges
-        float label_x = Clamp(origin_screen.x, GRID_LABEL_CLAMP_OFFSET + text_width + GRID_LABEL_OFFSET,
-                              (float)WIDTH + GRID_LABEL_OFFSET - GRID_LABEL_CLAMP_OFFSET);
+        int width = get_label(cache, i * step, label_step)->width;
+        cache->labels_min_width = width < cache->labels_min_width ? width : cache->labels_min_width;
+        cache->labels_max_width = width > cache->labels_max_width ? width : cache->labels_max_width;
+    }
 
-        // Draw labels at clamped X position and line Y position
-        DrawText(text, (int)label_x - text_width - (int)GRID_LABEL_OFFSET, (int)pos_screen.y - GRID_LABEL_SIZE / 2,
-                 GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+    float edge = label_edge(GetWorldToScreen2D(math_to_world(0.0, 0.0), *camera).x);
+    cache->labels_edge = edge;
+    cache->labels_layout = label_layout(cache, edge);
+
+    // Right-aligned labels sit against the column's right edge, the others where they go on screen
+    float column_width = cache->y_labels.texture.width / display.scale;
+    begin_label_texture(cache->y_labels);
+    for (long i = y_range.first; i <= y_range.last; i++) {
+        if (i % GRID_MAJOR_STEP != 0 || i == 0) continue;
+
+        const GridLabel *label = get_label(cache, i * step, label_step);
+        float x = cache->labels_layout == GRID_LABELS_ALIGNED ? column_width - label->width
+                                                              : grid_label_column_x(edge, label->width);
+        float y = GetWorldToScreen2D(math_to_world(0.0, i * step), texture_camera).y;
+        DrawText(label->text, (int)x, (int)y - GRID_LABEL_SIZE / 2, GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
     }
+    end_label_texture();
 }
 
-void plot_function(Camera2D *camera, Node *expression, SymbolTable *symbol_table, Color color) {
+float grid_spacing(float zoom) {
+    // Increase/Decrease adaptive spacing when zooming out/in
+    float spacing = GRID_INITIAL_SPACING;
+    while (spacing * zoom < GRID_MIN_SPACING) spacing *= 2.0f;
+    while (spacing * zoom > GRID_MAX_SPACING) spacing /= 2.0f;
+
+    return spacing;
+}
+
+void grid_cache_load(GridCache *cache) {
+    *cache = (GridCache){0};
+    cache->lines = display_load_texture(display.width + 2 * GRID_CACHE_MARGIN, display.height + 2 * GRID_CACHE_MARGIN);
+    cache->x_labels = display_load_texture(display.width + 2 * GRID_CACHE_MARGIN, GRID_LABEL_SIZE);
+    cache->y_labels = display_load_texture(display.width, display.height + 2 * GRID_CACHE_MARGIN);
+}
+
+void grid_cache_update(GridCache *cache, Camera2D *camera, float dynamic_spacing) {
+    // Lines only change with the zoom and the world's origin, or once the view leaves the region they cover
     ViewContext ctx = get_view_context(camera);
+    bool covered = ctx.min.x >= cache->lines_min.x && ctx.min.y >= cache->lines_min.y &&
+                   ctx.max.x <= cache->lines_max.x && ctx.max.y <= cache->lines_max.y;
+    bool rebased = cache->lines_origin != world_origin.version;
+    bool rescaled = cache->lines_zoom != camera->zoom || cache->lines_spacing != dynamic_spacing;
+    if (!cache->lines_valid || rescaled || rebased || !covered) {
+        rasterize_grid_lines(cache, camera, dynamic_spacing);
+        rasterize_grid_labels(cache, camera);
+        return;
+    }
 
-    // Get sampling pixel step
-    int samples = WIDTH;
-    float pixel_step = (ctx.max.x - ctx.min.x) / samples;
+    // Labels cover the same region and are only moved by pans, unless the y axis labels are split by the left edge
+    // of the screen, compared exactly since moves get tiny when zoomed in
+    float edge = label_edge(GetWorldToScreen2D(math_to_world(0.0, 0.0), *camera).x);
+    GridLabelLayout layout = label_layout(cache, edge);
+    if (layout != cache->labels_layout || (layout == GRID_LABELS_MIXED && edge != cache->labels_edge))
+        rasterize_grid_labels(cache, camera);
+}
 
-    Vector2 previous_point = {0};
-    bool has_previous = false;
+void grid_cache_unload(GridCache *cache) {
+    UnloadRenderTexture(cache->lines);
+    UnloadRenderTexture(cache->x_labels);
+    UnloadRenderTexture(cache->y_labels);
+    *cache = (GridCache){0};
+}
+
+void draw_grid(GridCache *cache, Camera2D *camera) {
+    // Blend the covered region over the whole screen at its exact position, like the curves drawn over it
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    display_draw_texture(cache->lines, GetWorldToScreen2D(cache->lines_min, *camera));
+    EndBlendMode();
+}
+
+void draw_grid_labels(GridCache *cache, Camera2D *camera) {
+    // Row and column follow the covered region along the axes, and are kept on screen across them
+    Vector2 corner = GetWorldToScreen2D(cache->lines_min, *camera);
+    Vector2 axes = GetWorldToScreen2D(math_to_world(0.0, 0.0), *camera);
+    float edge = label_edge(axes.x), row_y = grid_label_row_y(axes.y, (float)display.height);
+    float column_x = cache->labels_layout == GRID_LABELS_ALIGNED ? edge - cache->y_labels.texture.width / display.scale
+                                                                 : 0.0f;
+
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    display_draw_texture(cache->x_labels, (Vector2){corner.x, row_y});
+    display_draw_texture(cache->y_labels, (Vector2){column_x, corner.y});
+    EndBlendMode();
+
+    // Origin label is kept on screen along both axes, so it's drawn on its own. Zero reads the same at any step
+    const GridLabel *zero = get_label(cache, 0.0, 1.0);
+    DrawText(zero->text, (int)grid_label_column_x(edge, zero->width), (int)row_y, GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+}
 
-    for (int i = 0; i <= samples; i++) {
-        // Get X coordinate and update symbol table
-        float x_world = ctx.min.x + (i * pixel_step);
-        float x_math = pixels_to_math(x_world);
-        symbol_table_set(symbol_table, "x", 1, x_math);
+static int build_world_path(SamplePath *path, double min_y, double max_y, Vector2 **points) {
+    int count = 0;
+    bool connected = false;
 
-        // Evaluate expression
-        float y_math = (float)env_evaluate(expression, symbol_table);
-        if (isnan(y_math) || isinf(y_math)) {
-            has_previous = false;
+    // Worst case every segment starts its own run, the points only live until the mesh is built this frame
+    Vector2 *buffer = arena_alloc(&frame_arena, sizeof(Vector2) * 3 * path->count);
+
+    for (int i = 1; i < path->count; i++) {
+        SamplePoint p0 = path->points[i - 1], p1 = path->points[i];
+
+        // Breaks in the path are discontinuities or holes in the domain
+        if (isnan(p0.y) || isnan(p1.y) || !sample_clip_segment(&p0, &p1, min_y, max_y)) {
+            connected = false;
             continue;
         }
 
-        float y_world = math_to_pixels(-y_math);
-        Vector2 current_point = {x_world, y_world};
+        // Start a new run after a break or where the curve comes back into the band
+        if (!connected || p0.y != path->points[i - 1].y) {
+            if (count > 0) buffer[count++] = (Vector2){NAN, NAN};
+            buffer[count++] = math_to_world(p0.x, p0.y);
+        }
+
+        buffer[count++] = math_to_world(p1.x, p1.y);
+        connected = p1.y == path->points[i].y;
+    }
 
-        if (has_previous) {
-            // Connect previous and current point unless an asymptote is present
-            if (fabsf(current_point.y - previous_point.y) < ASYMPTOTE_THRESHOLD)
-                DrawLineEx(previous_point, current_point, LINE_THICKNESS / camera->zoom, color);
+    *points = buffer;
+    return count;
+}
+
+static SampleView get_sample_view(Camera2D *camera) {
+    ViewContext ctx = get_view_context(camera);
+
+    // Visible region in math units, sampled at the quality's share of framebuffer pixels
+    return (SampleView){
+        .min_x = world_to_math_x(ctx.min.x),
+        .max_x = world_to_math_x(ctx.max.x),
+        .min_y = world_to_math_y(ctx.max.y),
+        .max_y = world_to_math_y(ctx.min.y),
+        .scale = GRID_PIXELS_PER_UNIT * (double)camera->zoom * display.scale * display.quality,
+    };
+}
+
+static void draw_path(Camera2D *camera, ParsedExpression *expression, SamplePath *path, SampleView view) {
+    CurveMesh *mesh = &expression->mesh;
+
+    // Rebuild the mesh only when the path, the thickness or the band it was clipped to changes
+    float thickness = LINE_THICKNESS / camera->zoom;
+    bool inside = mesh->min_y <= view.min_y && mesh->max_y >= view.max_y;
+    bool rebased = mesh->origin != world_origin.version;
+    if (!mesh->built || mesh->version != path->version || mesh->thickness != thickness || !inside || rebased) {
+        // Vertical band kept when drawing, one screen beyond each edge
+        double band = view.max_y - view.min_y;
+        double min_y = view.min_y - band;
+        double max_y = view.max_y + band;
+
+        Vector2 *points;
+        int count = build_world_path(path, min_y, max_y, &points);
+
+        // Curves too detailed for one mesh are drawn segment by segment instead
+        if (!curve_mesh_build(mesh, points, count, thickness)) {
+            for (int i = 1; i < count; i++) {
+                if (isnan(points[i - 1].x) || isnan(points[i].x)) continue;
+                DrawLineEx(points[i - 1], points[i], thickness, expression->color);
+                mesh->segment_count++;
+            }
+
+            mesh->built = false;
+            return;
         }
 
-        previous_point = current_point;
-        has_previous = true;
+        curve_mesh_upload(mesh);
+        mesh->version = path->version;
+        mesh->thickness = thickness;
+        mesh->origin = world_origin.version;
+        mesh->min_y = min_y;
+        mesh->max_y = max_y;
+        mesh->built = true;
+    }
+
+    curve_mesh_draw(mesh, expression->color);
+}
+
+void plot_function(Camera2D *camera, ParsedExpression *expression) {
+    // Sample the visible region in the background, drawing the latest finished samples
+    SampleView view = get_sample_view(camera);
+    sampler_schedule(expression, view);
+
+    draw_path(camera, expression, &expression->path, view);
+}
+
+void plot_relation(Camera2D *camera, ParsedExpression *expression) {
+    // Trace tiles of the visible plane in the background, drawing the finished ones
+    SampleView view = get_sample_view(camera);
+    implicit_schedule(expression, view);
+
+    draw_path(camera, expression, &expression->path, view);
+}
+
+void plot_curve(Camera2D *camera, ParsedExpression *expression) {
+    // Sweep the parameter for the visible region in the background, drawing the latest finished path
+    SampleView view = get_sample_view(camera);
+    parametric_schedule(expression, view);
+
+    draw_path(camera, expression, &expression->path, view);
+}
+
+void plot_field(Camera2D *camera, ParsedExpression *expression) {
+    // Evaluate tiles of the visible plane in the background, drawing coarser ones in place of missing tiles
+    SampleView view = get_sample_view(camera);
+    field_schedule(expression, view);
+
+    FieldCache *cache = expression->field;
+    Color tint = {255, 255, 255, FIELD_OPACITY};
+    for (int i = 0; i < cache->patch_count; i++) {
+        FieldPatch *patch = &cache->patches[i];
+        Vector2 top_left = math_to_world(patch->min_x, patch->max_y);
+        Vector2 bottom_right = math_to_world(patch->max_x, patch->min_y);
+        Rectangle dest = {top_left.x, top_left.y, bottom_right.x - top_left.x, bottom_right.y - top_left.y};
+        DrawTexturePro(patch->tile->texture, patch->source, dest, (Vector2){0, 0}, 0.0f, tint);
+    }
+}
+
+void plot_series(Camera2D *camera, ParsedExpression *expression) {
+    SampleView view = get_sample_view(camera);
+    SampleView *last = &expression->view;
+
+    // Decimate again only when points arrived or the view moved
+    bool moved = last->min_x != view.min_x || last->max_x != view.max_x || last->scale != view.scale;
+    if (moved || series_pending(expression->series)) {
+        series_decimate(expression->series, view, &expression->path);
+        *last = view;
     }
+
+    draw_path(camera, expression, &expression->path, view);
+}
+
+void plot_pyramid(Camera2D *camera, ParsedExpression *expression) {
+    SampleView view = get_sample_view(camera);
+    SampleView *last = &expression->pyramid->view;
+
+    // Levels are read in place, so only a moved view needs another pass
+    bool moved = last->min_x != view.min_x || last->max_x != view.max_x || last->scale != view.scale;
+    if (moved) pyramid_decimate(expression->pyramid, view, &expression->path);
+
+    draw_path(camera, expression, &expression->path, view);
+}
+
+bool draw_features(Camera2D *camera, bool over_legend) {
+    // Scan settled curves of the visible region in the background, markers are drawn over the cached frame
+    SampleView view = get_sample_view(camera);
+    analysis_schedule(view);
+
+    int count;
+    const Feature *features = analysis_features(&count);
+    Vector2 mouse = GetMousePosition();
+    const Feature *hovered = NULL;
+    Vector2 hovered_position = {0};
+    float hovered_distance = ANALYSIS_HOVER_RADIUS;
+
+    for (int i = 0; i < count; i++) {
+        const Feature *feature = &features[i];
+        if (feature->x < view.min_x || feature->x > view.max_x || feature->y < view.min_y || feature->y > view.max_y)
+            continue;
+
+        Vector2 position = GetWorldToScreen2D(math_to_world(feature->x, feature->y), *camera);
+        DrawCircleV(position, ANALYSIS_MARKER_RADIUS + 1.0f, COLOR_BLACK);
+        DrawCircleV(position, ANALYSIS_MARKER_RADIUS, feature->color);
+
+        // Closest marker under the cursor gets the tooltip
+        float distance = Vector2Distance(mouse, position);
+        if (!over_legend && distance <= hovered_distance) {
+            hovered = feature;
+            hovered_position = position;
+            hovered_distance = distance;
+        }
+    }
+
+    if (hovered == NULL) return false;
+
+    const char *text = TextFormat("%s (%.6g, %.6g)", analysis_kind_name(hovered->kind), hovered->x, hovered->y);
+    int text_width = MeasureText(text, COORDS_DISPLAY_SIZE);
+    Vector2 text_pos = Vector2Add(hovered_position, (Vector2){-text_width / 2.0f, -COORDS_DISPLAY_OFFSET});
+
+    DrawCircleLinesV(hovered_position, ANALYSIS_HOVER_RADIUS, hovered->color);
+    DrawTextEx(GetFontDefault(), text, text_pos, COORDS_DISPLAY_SIZE, COORDS_DISPLAY_SPACING, COLOR_BRIGHT_WHITE);
+    return true;
 }
 
 void display_coords(Camera2D *camera, bool over_legend) {
@@ -184,10 +487,14 @@ void display_coords(Camera2D *camera, bool over_legend) {
     // Get mouse position in math units
     Vector2 mouse_screen = GetMousePosition();
     Vector2 mouse_world = GetScreenToWorld2D(mouse_screen, *camera);
-    Vector2 mouse_math = {pixels_to_math(mouse_world.x), pixels_to_math(-mouse_world.y)};
+    double mouse_x = world_to_math_x(mouse_world.x), mouse_y = world_to_math_y(mouse_world.y);
+
+    // Show decimals down to a pixel when zoomed in
+    int decimals = (int)ceil(log10(GRID_PIXELS_PER_UNIT * (double)camera->zoom));
+    if (decimals < COORDS_DISPLAY_DECIMALS) decimals = COORDS_DISPLAY_DECIMALS;
 
     // Compute text size and position
-    const char *text = TextFormat("(%.4f, %.4f)", mouse_math.x, mouse_math.y);
+    const char *text = TextFormat("(%.*f, %.*f)", decimals, mouse_x, decimals, mouse_y);
     int text_width = MeasureText(text, COORDS_DISPLAY_SIZE);
     Vector2 text_pos = Vector2Add(mouse_screen, (Vector2){-text_width / 2.0f, -COORDS_DISPLAY_OFFSET});
 
@@ -0,0 +1,578 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expression.h"
+#include "field.h"
+#include "implicit.h"
+#include "jit.h"
+#include "parametric.h"
+
+// Tree walks bind x in a table of their own thread, since expressions are evaluated on the worker pool
+static _Thread_local SymbolTable thread_symbols;
+static _Thread_local bool thread_symbols_ready = false;
+
+static SymbolTable *symbols(void) {
+    if (!thread_symbols_ready) {
+        thread_symbols = symbol_table_init();
+        thread_symbols_ready = true;
+    }
+
+    return &thread_symbols;
+}
+
+static bool agrees(double expected, double actual) {
+    // Same non-finite value, or within a few ulps like the vector kernels
+    if (isnan(expected) || isnan(actual)) return isnan(expected) && isnan(actual);
+    if (expected == actual) return true;
+    if (isinf(expected) || isinf(actual)) return false;
+
+    double magnitude = fmax(1.0, fmax(fabs(expected), fabs(actual)));
+    return fabs(expected - actual) <= PROGRAM_JIT_TOLERANCE * magnitude;
+}
+
+const char *expression_strip_derivatives(const char *text, int *order) {
+    size_t length = strlen(EXPRESSION_DERIVATIVE_PREFIX);
+    *order = 0;
+
+    for (;; (*order)++, text += length) {
+        while (*text == ' ') text++;
+        if (strncmp(text, EXPRESSION_DERIVATIVE_PREFIX, length) != 0) return text;
+    }
+}
+
+bool expression_jit(Program *program, Node **roots, const int *orders, int count, bool relation) {
+    if (!jit_compile(program)) return false;
+
+    // Probe a spread of points on both sides of the origin, covering poles and domain edges of the usual functions
+    double xs[PROGRAM_JIT_CHECKS], ys[PROGRAM_JIT_CHECKS];
+    for (int i = 0; i < PROGRAM_JIT_CHECKS; i++) {
+        xs[i] = -10.0 + 20.0 * i / (PROGRAM_JIT_CHECKS - 1);
+        ys[i] = 7.5 - 15.0 * ((i * 37) % PROGRAM_JIT_CHECKS) / (PROGRAM_JIT_CHECKS - 1);
+    }
+
+    double *values = malloc(sizeof(double) * PROGRAM_JIT_CHECKS * count);
+    if (relation) program_evaluate_relation(program, xs, ys, values, PROGRAM_JIT_CHECKS);
+    else program_evaluate_shared(program, xs, values, PROGRAM_JIT_CHECKS, PROGRAM_JIT_CHECKS);
+
+    // Derivatives have no tree to walk, so they're checked against the interpreter instead
+    double *reference = NULL;
+    for (int i = 0; i < count && orders != NULL && reference == NULL; i++) {
+        if (orders[i] == 0) continue;
+
+        Program interpreted = *program;
+        interpreted.native = NULL;
+        reference = malloc(sizeof(double) * PROGRAM_JIT_CHECKS * count);
+        program_evaluate_shared(&interpreted, xs, reference, PROGRAM_JIT_CHECKS, PROGRAM_JIT_CHECKS);
+    }
+
+    // Every output must match the tree walk
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        for (int j = 0; j < PROGRAM_JIT_CHECKS && ok; j++) {
+            symbol_table_set(symbols(), "x", 1, xs[j]);
+            if (relation) symbol_table_set(symbols(), "y", 1, ys[j]);
+
+            double expected = orders != NULL && orders[i] > 0 ? reference[i * PROGRAM_JIT_CHECKS + j]
+                                                              : env_evaluate(roots[i], symbols());
+            ok = agrees(expected, values[i * PROGRAM_JIT_CHECKS + j]);
+            if (!ok) TraceLog(LOG_WARNING, "Native code gives %g instead of %g at x = %g, interpreting instead",
+                              values[i * PROGRAM_JIT_CHECKS + j], expected, xs[j]);
+        }
+    }
+
+    free(values);
+    free(reference);
+    if (!ok) jit_free(program);
+    return ok;
+}
+
+bool expression_compile_tangent(Program *tangent, Node *root, int order) {
+    *tangent = (Program){0};
+    if (!SAMPLE_TANGENTS) return false;
+
+    // The function and its derivative share every subexpression, so the slope costs a fraction of a second pass
+    Node *roots[] = {root, root};
+    int orders[] = {order, order + 1};
+    if (!program_compile_shared(tangent, roots, orders, 2, NULL)) return false;
+
+    expression_jit(tangent, roots, orders, 2, false);
+    return true;
+}
+
+static bool compile_curve(ParsedExpression *expression) {
+    // Components of a curve and their derivatives come out of one program, the radius and its derivative for
+    // polar curves. Derivatives bound how far the curve strays between samples
+    ParametricCurve *curve = expression->parametric;
+    Node *components[] = {expression->root, curve->y_root};
+    int count = curve->y_root != NULL ? 2 : 1;
+    Node *roots[4];
+    int orders[4];
+    for (int i = 0; i < 2 * count; i++) {
+        roots[i] = components[i % count];
+        orders[i] = i / count;
+    }
+
+    Program *program = &expression->program;
+    curve->derivatives = SAMPLE_TANGENTS && program_compile_shared(program, roots, orders, 2 * count, NULL);
+    if (curve->derivatives) {
+        expression_jit(program, roots, orders, 2 * count, false);
+        return true;
+    }
+
+    // Without them the curve is sampled from its points alone
+    if (!program_compile_shared(program, roots, NULL, count, NULL)) return false;
+    expression_jit(program, roots, NULL, count, false);
+    return true;
+}
+
+bool expression_compile(ParsedExpression *expression) {
+    expression->tangents = false;
+    if (expression->parametric != NULL) {
+        expression->compiled = compile_curve(expression);
+        return expression->compiled;
+    }
+
+    // Relations and fields read y as well
+    bool relation = expression_planar(expression);
+    if (relation) expression->compiled = program_compile_relation(&expression->program, expression->root);
+    else expression->compiled = program_compile_derivative(&expression->program, expression->root, expression->order);
+
+    if (expression->compiled) expression_jit(&expression->program, &expression->root, &expression->order, 1, relation);
+
+    // Functions are sampled along their tangents where they can be differentiated
+    if (expression->compiled && !relation)
+        expression->tangents = expression_compile_tangent(&expression->tangent, expression->root, expression->order);
+
+    return expression->compiled;
+}
+
+static char *rewrite_equation(const char *text) {
+    // The parser has no equals sign, so `lhs = rhs` becomes `(lhs) - (rhs)`, traced where it's zero
+    const char *equals = strchr(text, '=');
+    if (equals == NULL) return NULL;
+
+    char *source = malloc(strlen(text) + 6);
+    sprintf(source, "(%.*s)-(%s)", (int)(equals - text), text, equals + 1);
+    return source;
+}
+
+static bool check_syntax(const char *text, const char *function, char *error) {
+    // The parser only tells whether it failed, so the usual mistakes are caught here to point at them.
+    // Columns count from the start of the text, prefixes included
+    int depth = 0, open = 0;
+    bool empty = true;
+    for (const char *c = function; *c != '\0'; c++) {
+        int column = (int)(c - text) + 1;
+        if (*c != ' ' && *c != '=') empty = false;
+
+        if (*c == '(' && depth++ == 0) open = column;
+        if (*c == ')' && --depth < 0) {
+            snprintf(error, EXPRESSION_ERROR_LENGTH, "Unmatched ')' at column %d", column);
+            return false;
+        }
+    }
+
+    if (empty) snprintf(error, EXPRESSION_ERROR_LENGTH, "Empty expression");
+    else if (depth > 0) snprintf(error, EXPRESSION_ERROR_LENGTH, "Missing ')' for '(' at column %d", open);
+    return !empty && depth == 0;
+}
+
+bool expression_parse(ParsedExpression *expression, Parser *parser, const char *text) {
+    // Tree nodes point into the text they were parsed from, so the expression keeps its own copies
+    size_t length = strlen(text);
+    expression->buffer = malloc(length + 1);
+    memcpy(expression->buffer, text, length + 1);
+    expression->text = expression->buffer;
+    expression->error[0] = '\0';
+
+    // Fields are whatever follows their `z =`, curves are rewritten as functions of x and other prefixes ask for
+    // derivatives of the function after them. Equations are parsed as the difference of their sides
+    const char *function = field_strip_prefix(expression->buffer);
+    bool field = function != NULL;
+    ParametricKind kind = PARAMETRIC_XY;
+    if (!field) expression->equation = parametric_rewrite(expression->buffer, &kind, expression->error);
+    if (expression->error[0] != '\0') return false;
+
+    bool curve = expression->equation != NULL;
+    if (curve) {
+        function = expression->buffer;
+    } else if (!field) {
+        function = expression_strip_derivatives(expression->buffer, &expression->order);
+        expression->equation = rewrite_equation(function);
+    }
+
+    if (!check_syntax(expression->buffer, function, expression->error)) return false;
+    Node *root = parser_parse(parser, expression->equation != NULL ? expression->equation : function);
+
+    // The y component of a parametric curve follows the x one
+    Node *y_root = NULL;
+    if (root != NULL && curve && kind == PARAMETRIC_XY)
+        y_root = parser_parse(parser, expression->equation + strlen(expression->equation) + 1);
+    if (root == NULL || (curve && kind == PARAMETRIC_XY && y_root == NULL)) {
+        snprintf(expression->error, EXPRESSION_ERROR_LENGTH, "Invalid expression");
+        return false;
+    }
+
+    // Fields are colored over the plane, curves are swept along their parameter, and relations between x and y are
+    // traced over the plane instead of sampled along x
+    if (field) {
+        expression->field = malloc(sizeof(FieldCache));
+        field_init(expression->field);
+    } else if (curve) {
+        expression->parametric = malloc(sizeof(ParametricCurve));
+        parametric_init(expression->parametric, kind, y_root);
+    } else if (expression->equation != NULL || implicit_is_relation(root)) {
+        if (expression->order > 0) {
+            snprintf(expression->error, EXPRESSION_ERROR_LENGTH, "Unable to differentiate a relation");
+            return false;
+        }
+
+        expression->implicit = malloc(sizeof(ImplicitCache));
+        implicit_init(expression->implicit);
+    }
+
+    // Lower tree into a flat program, keeping the tree walk for anything it can't represent except derivatives
+    expression->root = root;
+    if (expression_compile(expression)) return true;
+    if (expression->order > 0) {
+        snprintf(expression->error, EXPRESSION_ERROR_LENGTH, "Unable to differentiate");
+        expression->root = NULL;
+        return false;
+    }
+
+    TraceLog(LOG_WARNING, "Unable to compile '%s', falling back to tree evaluation", text);
+    return true;
+}
+
+void expression_edit(ParsedExpression *expression, Parser *parser, const char *text) {
+    Color color = expression->color;
+    bool visible = expression->visible;
+
+    // Nothing but the expression's own job reads its state, and it's waited for
+    expression_free(expression);
+    *expression = (ParsedExpression){.color = color, .visible = visible};
+    expression_parse(expression, parser, text);
+}
+
+void expression_evaluate(ParsedExpression *expression, const double *xs, double *ys, int count) {
+    if (expression->compiled) {
+        program_evaluate(&expression->program, xs, ys, count);
+        return;
+    }
+
+    // Fall back to walking the tree through the symbol table
+    for (int i = 0; i < count; i++) {
+        symbol_table_set(symbols(), "x", 1, xs[i]);
+        ys[i] = env_evaluate(expression->root, symbols());
+    }
+}
+
+void expression_evaluate_tangent(ParsedExpression *expression, const double *xs, double *ys, double *slopes,
+                                 int count) {
+    // Both outputs are written a batch apart, then copied to their arrays
+    double rows[2][PROGRAM_BATCH];
+
+    for (int start = 0; start < count; start += PROGRAM_BATCH) {
+        int n = count - start < PROGRAM_BATCH ? count - start : PROGRAM_BATCH;
+        program_evaluate_shared(&expression->tangent, xs + start, rows[0], PROGRAM_BATCH, n);
+        memcpy(ys + start, rows[0], sizeof(double) * n);
+        memcpy(slopes + start, rows[1], sizeof(double) * n);
+    }
+}
+
+void expression_evaluate_curve(ParsedExpression *expression, const double *ts, CurveSample *samples, int count) {
+    // Components are written a batch apart, followed by their derivatives if the program has them
+    ParametricCurve *curve = expression->parametric;
+    int components = curve->y_root != NULL ? 2 : 1;
+    bool derivatives = expression->compiled && curve->derivatives;
+    double rows[4][PROGRAM_BATCH];
+
+    for (int start = 0; start < count; start += PROGRAM_BATCH) {
+        int n = count - start < PROGRAM_BATCH ? count - start : PROGRAM_BATCH;
+        if (expression->compiled) {
+            program_evaluate_shared(&expression->program, ts + start, rows[0], PROGRAM_BATCH, n);
+        } else {
+            for (int i = 0; i < n; i++) {
+                symbol_table_set(symbols(), "x", 1, ts[start + i]);
+                rows[0][i] = env_evaluate(expression->root, symbols());
+                if (curve->y_root != NULL) rows[1][i] = env_evaluate(curve->y_root, symbols());
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            double t = ts[start + i];
+            CurveSample *sample = &samples[start + i];
+            sample->t = t;
+            sample->dx = NAN;
+            sample->dy = NAN;
+
+            if (curve->kind == PARAMETRIC_XY) {
+                sample->x = rows[0][i];
+                sample->y = rows[1][i];
+                if (!derivatives) continue;
+
+                sample->dx = rows[components][i];
+                sample->dy = rows[components + 1][i];
+                continue;
+            }
+
+            // Polar curves turn with their angle, which adds to the derivative of the radius along the curve
+            double r = rows[0][i], c = cos(t), s = sin(t);
+            sample->x = r * c;
+            sample->y = r * s;
+            if (!derivatives) continue;
+
+            double dr = rows[components][i];
+            sample->dx = dr * c - r * s;
+            sample->dy = dr * s + r * c;
+        }
+    }
+}
+
+void expression_evaluate_relation(ParsedExpression *expression, const double *xs, const double *ys, double *values,
+                                  int count) {
+    if (expression->compiled) {
+        program_evaluate_relation(&expression->program, xs, ys, values, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        symbol_table_set(symbols(), "x", 1, xs[i]);
+        symbol_table_set(symbols(), "y", 1, ys[i]);
+        values[i] = env_evaluate(expression->root, symbols());
+    }
+}
+
+// Slice of a column block evaluated by one task
+struct ColumnChunk {
+    const Program *program;
+    const double *xs;
+    double *ys;
+    int stride;
+    int count;
+};
+
+static void evaluate_column_chunk(void *arg) {
+    struct ColumnChunk *chunk = arg;
+    program_evaluate_shared(chunk->program, chunk->xs, chunk->ys, chunk->stride, chunk->count);
+}
+
+static ColumnBlock *find_block(ExpressionGroup *group, double step, long long first, int count, bool *fresh) {
+    ColumnBlock *reuse = NULL;
+    *fresh = false;
+
+    for (int i = 0; i < SAMPLE_SHARED_BLOCKS; i++) {
+        ColumnBlock *block = &group->blocks[i];
+        if (block->valid && block->step == step && block->first == first && block->count == count) return block;
+
+        // Least recently used block nobody is reading
+        if (block->readers > 0) continue;
+        if (reuse == NULL || !block->valid || (reuse->valid && block->stamp < reuse->stamp)) reuse = block;
+    }
+
+    if (reuse == NULL) return NULL;
+
+    // Claim block, its values are evaluated by whoever asked for it first
+    int size = count * group->program.outputs;
+    if (size > reuse->capacity) {
+        reuse->capacity = size;
+        reuse->values = realloc(reuse->values, sizeof(double) * size);
+    }
+
+    int chunks = (count + SAMPLE_CHUNK - 1) / SAMPLE_CHUNK;
+    if (chunks > reuse->chunk_capacity) {
+        reuse->chunk_capacity = chunks;
+        reuse->chunks = realloc(reuse->chunks, sizeof(struct ColumnChunk) * chunks);
+    }
+
+    *reuse = (ColumnBlock){
+        .step = step,
+        .first = first,
+        .count = count,
+        .values = reuse->values,
+        .capacity = reuse->capacity,
+        .chunks = reuse->chunks,
+        .chunk_capacity = reuse->chunk_capacity,
+        .valid = true,
+    };
+
+    *fresh = true;
+    return reuse;
+}
+
+bool expression_evaluate_columns(ParsedExpression *expression, double step, long long first, const double *xs,
+                                 double *ys, double *slopes, int count) {
+    ExpressionGroup *group = expression->group;
+    if (group == NULL) return false;
+
+    pthread_mutex_lock(&group->lock);
+    bool fresh;
+    ColumnBlock *block = find_block(group, step, first, count, &fresh);
+    if (block == NULL) {
+        pthread_mutex_unlock(&group->lock);
+        return false;
+    }
+
+    block->readers++;
+    block->stamp = ++group->stamp;
+
+    // Split a fresh block across the pool, every reader then waits on the same chunks
+    if (fresh) {
+        for (int start = 0, c = 0; start < count; start += SAMPLE_CHUNK, c++) {
+            int n = count - start < SAMPLE_CHUNK ? count - start : SAMPLE_CHUNK;
+            block->chunks[c] = (struct ColumnChunk){&group->program, xs + start, block->values + start, count, n};
+            pool_submit(&block->job, evaluate_column_chunk, &block->chunks[c]);
+        }
+    }
+
+    pthread_mutex_unlock(&group->lock);
+    pool_wait(&block->job);
+
+    pthread_mutex_lock(&group->lock);
+    memcpy(ys, block->values + (size_t)expression->output * count, sizeof(double) * count);
+    if (slopes != NULL) {
+        const double *row = block->values + (size_t)expression->slope_output * count;
+        for (int i = 0; i < count; i++) slopes[i] = expression->slope_output >= 0 ? row[i] : NAN;
+    }
+    block->readers--;
+    pthread_mutex_unlock(&group->lock);
+
+    return true;
+}
+
+void expression_group_init(ExpressionGroup *group) {
+    *group = (ExpressionGroup){0};
+    pthread_mutex_init(&group->lock, NULL);
+}
+
+void expression_group_build(ExpressionGroup *group, ParsedExpression *expressions, int count) {
+    // Jobs may be reading the current program or blocks
+    for (int i = 0; i < count; i++) pool_wait(&expressions[i].job);
+
+    if (group->compiled) program_free(&group->program);
+    group->compiled = false;
+    group->members = 0;
+    for (int i = 0; i < SAMPLE_SHARED_BLOCKS; i++) group->blocks[i].valid = false;
+
+    // Members are the visible functions of x that compiled on their own, with their slope if they have tangents.
+    // Curves and relations evaluate programs of their own
+    Node **roots = malloc(sizeof(Node *) * (count > 0 ? 2 * count : 1));
+    int *orders = malloc(sizeof(int) * (count > 0 ? 2 * count : 1));
+    int outputs = 0;
+    for (int i = 0; i < count; i++) {
+        ParsedExpression *expression = &expressions[i];
+        expression->group = NULL;
+        expression->slope_output = -1;
+        if (!expression->compiled || !expression->visible || !expression_columnar(expression)) continue;
+
+        group->members++;
+        expression->output = outputs;
+        roots[outputs] = expression->root;
+        orders[outputs++] = expression->order;
+
+        if (!expression->tangents) continue;
+        expression->slope_output = outputs;
+        roots[outputs] = expression->root;
+        orders[outputs++] = expression->order + 1;
+    }
+
+    // A single curve has nothing to share with. Slopes need more registers, so the group may do without them.
+    ProgramSharing sharing;
+    bool compiled = group->members > 1 && program_compile_shared(&group->program, roots, orders, outputs, &sharing);
+    if (!compiled && group->members > 1) {
+        outputs = 0;
+        for (int i = 0; i < count; i++) {
+            ParsedExpression *expression = &expressions[i];
+            if (!expression->compiled || !expression->visible || !expression_columnar(expression)) continue;
+
+            expression->output = outputs;
+            expression->slope_output = -1;
+            roots[outputs] = expression->root;
+            orders[outputs++] = expression->order;
+        }
+
+        compiled = program_compile_shared(&group->program, roots, orders, outputs, &sharing);
+    }
+
+    if (compiled) {
+        group->compiled = true;
+        expression_jit(&group->program, roots, orders, outputs, false);
+        for (int i = 0; i < count; i++) {
+            if (expressions[i].compiled && expressions[i].visible && expression_columnar(&expressions[i]))
+                expressions[i].group = group;
+        }
+
+        TraceLog(LOG_INFO, "Merged %d expressions: %d nodes evaluated as %d (%.2fx shared), %d folded into constants",
+                 group->members, sharing.tree_nodes, sharing.nodes, (double)sharing.tree_nodes / sharing.nodes,
+                 sharing.folded);
+    }
+
+    free(orders);
+    free(roots);
+}
+
+void expression_group_free(ExpressionGroup *group) {
+    if (group->compiled) program_free(&group->program);
+
+    for (int i = 0; i < SAMPLE_SHARED_BLOCKS; i++) {
+        free(group->blocks[i].values);
+        free(group->blocks[i].chunks);
+    }
+
+    pthread_mutex_destroy(&group->lock);
+    *group = (ExpressionGroup){0};
+}
+
+void expression_thread_free(void) {
+    implicit_thread_free();
+    if (!thread_symbols_ready) return;
+
+    symbol_table_free(&thread_symbols);
+    thread_symbols_ready = false;
+}
+
+void expression_free(ParsedExpression *expression) {
+    pool_wait(&expression->job);
+
+    if (expression->compiled) program_free(&expression->program);
+    if (expression->tangents) program_free(&expression->tangent);
+    expression->compiled = false;
+    expression->tangents = false;
+    if (expression->buffer != NULL) {
+        free(expression->buffer);
+        free(expression->equation);
+        expression->text = NULL;
+        expression->buffer = NULL;
+        expression->equation = NULL;
+    }
+    if (expression->series != NULL) {
+        series_close(expression->series);
+        free(expression->series);
+        expression->series = NULL;
+    }
+    if (expression->implicit != NULL) {
+        implicit_free(expression->implicit);
+        free(expression->implicit);
+        expression->implicit = NULL;
+    }
+    if (expression->field != NULL) {
+        field_free(expression->field);
+        free(expression->field);
+        expression->field = NULL;
+    }
+    if (expression->parametric != NULL) {
+        parametric_free(expression->parametric);
+        free(expression->parametric);
+        expression->parametric = NULL;
+    }
+    if (expression->pyramid != NULL) {
+        pyramid_close(expression->pyramid);
+        free(expression->pyramid);
+        expression->pyramid = NULL;
+    }
+    sample_cache_free(&expression->cache);
+    sample_path_free(&expression->path);
+    curve_mesh_unload(&expression->mesh);
+}
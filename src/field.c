@@ -0,0 +1,395 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "field.h"
+#include "pool.h"
+
+#define TEXELS (FIELD_TILE_TEXELS * FIELD_TILE_TEXELS) // Texels in a tile
+
+// Viridis, from the lowest value to the highest
+static const Color colormap[] = {
+    { 68,   1,  84, 255},
+    { 72,  40, 120, 255},
+    { 62,  74, 137, 255},
+    { 49, 104, 142, 255},
+    { 38, 130, 142, 255},
+    { 31, 158, 137, 255},
+    { 53, 183, 121, 255},
+    {109, 205,  89, 255},
+    {180, 222,  44, 255},
+    {253, 231,  37, 255},
+};
+
+#define COLORMAP_STOPS ((int)(sizeof(colormap) / sizeof(colormap[0])))
+
+// Tiles of one level covering a region
+typedef struct {
+    int level;
+    long long min_tx, max_tx;
+    long long min_ty, max_ty;
+} TileRange;
+
+const char *field_strip_prefix(const char *text) {
+    // A single equals sign after the z, comparisons aren't fields
+    while (*text == ' ') text++;
+    if (*text++ != 'z') return NULL;
+    while (*text == ' ') text++;
+    if (*text != '=' || text[1] == '=') return NULL;
+
+    return text + 1;
+}
+
+void field_init(FieldCache *cache) {
+    *cache = (FieldCache){.newest = -1, .oldest = -1, .lo = INFINITY, .hi = -INFINITY};
+
+    // Every tile holds its values and a texture of the same size
+    size_t tile_bytes = TEXELS * (sizeof(float) + sizeof(Color));
+    cache->capacity = (int)((size_t)FIELD_CACHE_MEGABYTES * 1024 * 1024 / tile_bytes);
+    if (cache->capacity < 1) cache->capacity = 1;
+    cache->tiles = calloc(cache->capacity, sizeof(FieldTile));
+    for (int i = 0; i < cache->capacity; i++) atomic_init(&cache->tiles[i].state, TILE_FREE);
+
+    // At most half full
+    int buckets = 1;
+    while (buckets < 2 * cache->capacity) buckets *= 2;
+    cache->buckets = malloc(sizeof(int) * buckets);
+    memset(cache->buckets, -1, sizeof(int) * buckets);
+    cache->bucket_mask = buckets - 1;
+}
+
+/* ------------------------------- Evaluation ------------------------------- */
+
+static int compare_floats(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static void evaluate_tile(void *arg) {
+    FieldTile *tile = arg;
+    ParsedExpression *expression = tile->expression;
+
+    // Values sit at texel centers, on the same lattice for every tile of a level
+    double cell = ldexp(1.0, tile->level);
+    long long first_i = tile->tx * FIELD_TILE_TEXELS, first_j = tile->ty * FIELD_TILE_TEXELS;
+    double xs[FIELD_TILE_TEXELS], ys[FIELD_TILE_TEXELS], values[FIELD_TILE_TEXELS];
+    for (int i = 0; i < FIELD_TILE_TEXELS; i++) xs[i] = (first_i + i + 0.5) * cell;
+
+    // Rows are stored from the top, like the texture
+    bool based = false;
+    tile->base = 0.0;
+    for (int row = 0; row < FIELD_TILE_TEXELS; row++) {
+        double y = (first_j + FIELD_TILE_TEXELS - 1 - row + 0.5) * cell;
+        for (int i = 0; i < FIELD_TILE_TEXELS; i++) ys[i] = y;
+
+        expression_evaluate_relation(expression, xs, ys, values, FIELD_TILE_TEXELS);
+
+        // Values are kept as offsets from the first finite one, which floats hold precisely even when zoomed in
+        // on a region where they barely change. Rows before it only hold values that aren't finite.
+        for (int i = 0; i < FIELD_TILE_TEXELS && !based; i++) {
+            if (!isfinite(values[i])) continue;
+            tile->base = values[i];
+            based = true;
+        }
+        for (int i = 0; i < FIELD_TILE_TEXELS; i++)
+            tile->values[row * FIELD_TILE_TEXELS + i] = (float)(values[i] - tile->base);
+    }
+    atomic_fetch_add(&expression->evaluations, TEXELS);
+
+    // Range of a spread of finite values, the extremes near poles would wash out the colors
+    float samples[FIELD_RANGE_SAMPLES];
+    int count = 0, stride = TEXELS / FIELD_RANGE_SAMPLES + 1;
+    for (int k = 0; k < FIELD_RANGE_SAMPLES; k++) {
+        float value = tile->values[(long)k * stride % TEXELS];
+        if (isfinite(value)) samples[count++] = value;
+    }
+
+    tile->lo = INFINITY;
+    tile->hi = -INFINITY;
+    if (count > 0) {
+        qsort(samples, count, sizeof(float), compare_floats);
+        int cut = (int)(count * FIELD_RANGE_CUTOFF);
+        tile->lo = tile->base + samples[cut];
+        tile->hi = tile->base + samples[count - 1 - cut];
+    }
+
+    atomic_store(&tile->state, TILE_READY);
+}
+
+/* -------------------------------- Coloring -------------------------------- */
+
+static Color map_color(double value, double lo, double hi) {
+    // Undefined values leave the background showing
+    if (isnan(value)) return BLANK;
+
+    float t = hi > lo ? (float)((value - lo) / (hi - lo)) : 0.5f;
+    t = fminf(fmaxf(t, 0.0f), 1.0f) * (COLORMAP_STOPS - 1);
+    int stop = (int)t;
+    if (stop == COLORMAP_STOPS - 1) stop--;
+
+    float weight = t - stop;
+    Color a = colormap[stop], b = colormap[stop + 1];
+    return (Color){
+        (unsigned char)(a.r + (b.r - a.r) * weight),
+        (unsigned char)(a.g + (b.g - a.g) * weight),
+        (unsigned char)(a.b + (b.b - a.b) * weight),
+        255,
+    };
+}
+
+static void color_tile(FieldCache *cache, FieldTile *tile) {
+    // Pixels only live until they're uploaded
+    Color *pixels = arena_alloc(&frame_arena, sizeof(Color) * TEXELS);
+    for (int i = 0; i < TEXELS; i++) pixels[i] = map_color(tile->base + tile->values[i], cache->lo, cache->hi);
+
+    // Textures stay with their slot, replaced tiles update them in place
+    if (tile->texture.id == 0) {
+        Image image = {
+            .data = pixels,
+            .width = FIELD_TILE_TEXELS,
+            .height = FIELD_TILE_TEXELS,
+            .mipmaps = 1,
+            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+        };
+        tile->texture = LoadTextureFromImage(image);
+    } else {
+        UpdateTexture(tile->texture, pixels);
+    }
+
+    tile->colored = true;
+    tile->colored_lo = cache->lo;
+    tile->colored_hi = cache->hi;
+}
+
+/* -------------------------------- Caching --------------------------------- */
+
+static void reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return;
+
+    *capacity = count * 2;
+    *buffer = realloc(*buffer, size * *capacity);
+}
+
+static int bucket_of(FieldCache *cache, int level, long long tx, long long ty) {
+    unsigned long long hash = (unsigned long long)tx * 0x9E3779B97F4A7C15ull;
+    hash ^= (unsigned long long)ty * 0xC2B2AE3D27D4EB4Full;
+    hash ^= (unsigned long long)level * 0x165667B19E3779F9ull;
+    return (int)((hash ^ (hash >> 32)) & cache->bucket_mask);
+}
+
+static FieldTile *find_tile(FieldCache *cache, int level, long long tx, long long ty) {
+    for (int i = cache->buckets[bucket_of(cache, level, tx, ty)]; i >= 0; i = cache->tiles[i].bucket_next) {
+        FieldTile *tile = &cache->tiles[i];
+        if (tile->level == level && tile->tx == tx && tile->ty == ty) return tile;
+    }
+
+    return NULL;
+}
+
+static void unlink_recent(FieldCache *cache, int index) {
+    FieldTile *tile = &cache->tiles[index];
+    if (tile->newer >= 0) cache->tiles[tile->newer].older = tile->older;
+    else cache->newest = tile->older;
+    if (tile->older >= 0) cache->tiles[tile->older].newer = tile->newer;
+    else cache->oldest = tile->newer;
+}
+
+static void push_recent(FieldCache *cache, int index) {
+    FieldTile *tile = &cache->tiles[index];
+    tile->newer = -1;
+    tile->older = cache->newest;
+    if (cache->newest >= 0) cache->tiles[cache->newest].newer = index;
+    else cache->oldest = index;
+    cache->newest = index;
+}
+
+static void touch_tile(FieldCache *cache, FieldTile *tile) {
+    if (tile->stamp == cache->frame) return;
+
+    int index = (int)(tile - cache->tiles);
+    unlink_recent(cache, index);
+    push_recent(cache, index);
+    tile->stamp = cache->frame;
+}
+
+static void unlink_bucket(FieldCache *cache, FieldTile *tile) {
+    int index = (int)(tile - cache->tiles);
+    int *link = &cache->buckets[bucket_of(cache, tile->level, tile->tx, tile->ty)];
+    while (*link != index) link = &cache->tiles[*link].bucket_next;
+    *link = tile->bucket_next;
+}
+
+static FieldTile *claim_tile(FieldCache *cache) {
+    // Unused slots first, then the least recently visible tile that isn't on screen or being evaluated
+    if (cache->used < cache->capacity) {
+        FieldTile *tile = &cache->tiles[cache->used++];
+        tile->values = malloc(sizeof(float) * TEXELS);
+        push_recent(cache, (int)(tile - cache->tiles));
+        return tile;
+    }
+
+    for (int i = cache->oldest; i >= 0; i = cache->tiles[i].newer) {
+        FieldTile *tile = &cache->tiles[i];
+        if (tile->stamp == cache->frame) return NULL;
+        if (atomic_load(&tile->state) == TILE_PENDING) continue;
+
+        unlink_bucket(cache, tile);
+        return tile;
+    }
+
+    return NULL;
+}
+
+static TileRange tile_range(SampleView view, int level) {
+    double size = ldexp(FIELD_TILE_TEXELS, level);
+    return (TileRange){
+        .level = level,
+        .min_tx = (long long)floor(view.min_x / size),
+        .max_tx = (long long)floor(view.max_x / size),
+        .min_ty = (long long)floor(view.min_y / size),
+        .max_ty = (long long)floor(view.max_y / size),
+    };
+}
+
+static long long range_tiles(TileRange range) {
+    return (range.max_tx - range.min_tx + 1) * (range.max_ty - range.min_ty + 1);
+}
+
+static void touch_range(FieldCache *cache, TileRange range) {
+    for (long long ty = range.min_ty; ty <= range.max_ty; ty++) {
+        for (long long tx = range.min_tx; tx <= range.max_tx; tx++) {
+            FieldTile *tile = find_tile(cache, range.level, tx, ty);
+            if (tile != NULL) touch_tile(cache, tile);
+        }
+    }
+}
+
+static void request_range(FieldCache *cache, ParsedExpression *expression, TileRange range) {
+    for (long long ty = range.min_ty; ty <= range.max_ty; ty++) {
+        for (long long tx = range.min_tx; tx <= range.max_tx; tx++) {
+            if (find_tile(cache, range.level, tx, ty) != NULL) continue;
+
+            // Tiles that don't fit the cache are left out
+            FieldTile *tile = claim_tile(cache);
+            if (tile == NULL) return;
+
+            tile->level = range.level;
+            tile->tx = tx;
+            tile->ty = ty;
+            tile->expression = expression;
+            tile->colored = false;
+            touch_tile(cache, tile);
+
+            int bucket = bucket_of(cache, range.level, tx, ty);
+            tile->bucket_next = cache->buckets[bucket];
+            cache->buckets[bucket] = (int)(tile - cache->tiles);
+
+            atomic_store(&tile->state, TILE_PENDING);
+            pool_submit(&expression->job, evaluate_tile, tile);
+        }
+    }
+}
+
+static long long ancestor_of(long long t, int levels) {
+    // Floor division by a power of two, for negative positions too
+    long long size = 1LL << levels;
+    return t >= 0 ? t / size : -((-t - 1) / size) - 1;
+}
+
+static void add_patch(FieldCache *cache, int level, long long tx, long long ty) {
+    // Closest ready level at or above the visible one
+    for (int up = 0; up <= FIELD_FALLBACK_LEVELS; up++) {
+        long long ax = ancestor_of(tx, up), ay = ancestor_of(ty, up);
+        FieldTile *tile = find_tile(cache, level + up, ax, ay);
+        if (tile == NULL || atomic_load(&tile->state) != TILE_READY) continue;
+
+        if (!tile->colored || tile->colored_lo != cache->lo || tile->colored_hi != cache->hi) color_tile(cache, tile);
+        touch_tile(cache, tile);
+
+        // The visible tile covers a square of the coarser one, whose rows start at the top
+        long long size = 1LL << up;
+        float span = (float)FIELD_TILE_TEXELS / size;
+        double extent = ldexp(FIELD_TILE_TEXELS, level);
+        reserve((void **)&cache->patches, &cache->patch_capacity, cache->patch_count + 1, sizeof(FieldPatch));
+        cache->patches[cache->patch_count++] = (FieldPatch){
+            .tile = tile,
+            .source = {(tx - ax * size) * span, (size - 1 - (ty - ay * size)) * span, span, span},
+            .min_x = tx * extent,
+            .max_x = (tx + 1) * extent,
+            .min_y = ty * extent,
+            .max_y = (ty + 1) * extent,
+        };
+        return;
+    }
+}
+
+void field_schedule(ParsedExpression *expression, SampleView view) {
+    FieldCache *cache = expression->field;
+    cache->frame++;
+
+    // Power-of-two texels between half and all of the widest texel on screen, so zooming only
+    // changes level when their size doubles
+    int level = (int)floor(log2(FIELD_TEXEL_PIXELS / view.scale));
+    TileRange visible = tile_range(view, level);
+    TileRange preview = tile_range(view, level + FIELD_PREVIEW_LEVELS);
+
+    // Coarser texels on views too large for the cache to hold every visible and preview tile, which would
+    // otherwise never finish. Any view fits 2x2 tiles of some level.
+    while (range_tiles(visible) + range_tiles(preview) > cache->capacity && range_tiles(visible) > 4) {
+        visible = tile_range(view, ++level);
+        preview = tile_range(view, level + FIELD_PREVIEW_LEVELS);
+    }
+
+    // Keep cached tiles of the view from being replaced, then evaluate the missing ones with the cheap preview first
+    touch_range(cache, preview);
+    touch_range(cache, visible);
+    request_range(cache, expression, preview);
+    request_range(cache, expression, visible);
+
+    // Colors span the values of the finished tiles, and only change once the range moves noticeably
+    int ready = 0, total = 0;
+    double lo = INFINITY, hi = -INFINITY;
+    for (long long ty = visible.min_ty; ty <= visible.max_ty; ty++) {
+        for (long long tx = visible.min_tx; tx <= visible.max_tx; tx++) {
+            FieldTile *tile = find_tile(cache, level, tx, ty);
+            total++;
+            if (tile == NULL || atomic_load(&tile->state) != TILE_READY) continue;
+
+            ready++;
+            lo = fmin(lo, tile->lo);
+            hi = fmax(hi, tile->hi);
+        }
+    }
+
+    double slack = FIELD_RANGE_SLACK * (cache->hi - cache->lo);
+    bool unset = !(cache->lo <= cache->hi);
+    if (lo <= hi && (unset || fabs(lo - cache->lo) > slack || fabs(hi - cache->hi) > slack)) {
+        cache->lo = lo;
+        cache->hi = hi;
+    }
+
+    // Missing tiles are drawn from a coarser level until they're ready
+    cache->patch_count = 0;
+    for (long long ty = visible.min_ty; ty <= visible.max_ty; ty++) {
+        for (long long tx = visible.min_tx; tx <= visible.max_tx; tx++) add_patch(cache, level, tx, ty);
+    }
+
+    cache->complete = ready == total;
+}
+
+bool field_pending(ParsedExpression *expression) {
+    return pool_busy(&expression->job) || !expression->field->complete;
+}
+
+void field_free(FieldCache *cache) {
+    for (int i = 0; i < cache->used; i++) {
+        free(cache->tiles[i].values);
+        if (cache->tiles[i].texture.id != 0) UnloadTexture(cache->tiles[i].texture);
+    }
+
+    free(cache->tiles);
+    free(cache->buckets);
+    free(cache->patches);
+    *cache = (FieldCache){0};
+}
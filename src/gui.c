@@ -1,61 +1,295 @@
 #include <raylib.h>
+#include <string.h>
 
+#include "analysis.h"
 #include "common.h"
 #include "gui.h"
 
-bool display_legend(ParsedExpression *expressions, int count) {
+static bool listed(const ParsedExpression *expression) {
+    // Empty slots are left by removed expressions, anything else is listed even if it can't be plotted
+    return expression->text != NULL;
+}
+
+static int free_slot(Legend *legend) {
+    // Slot an added expression would take, -1 if there's no room
+    for (int i = 0; i < legend->count; i++) {
+        if (!listed(&legend->expressions[i])) return i;
+    }
+
+    return legend->count < legend->capacity ? legend->count : -1;
+}
+
+static Rectangle legend_box(Legend *legend) {
     int max_text_width = 0;
-    int non_null = 0;
+    int rows = 0;
 
-    // Get maximum text width and non-null expressions
-    for (int i = 0; i < count; i++) {
-        if (expressions[i].root == NULL) continue;
-        non_null++;
+    // Get maximum text width, errors included, and listed entries
+    for (int i = 0; i < legend->count; i++) {
+        ParsedExpression *expression = &legend->expressions[i];
+        if (!listed(expression)) continue;
+        rows++;
 
-        int text_width = MeasureText(expressions[i].text, LEGEND_ELEM_SIZE);
+        int text_width = MeasureText(expression->text, LEGEND_ELEM_SIZE);
+        if (expression->error[0] != '\0')
+            text_width += LEGEND_SPACING + MeasureText(expression->error, LEGEND_ERROR_SIZE);
         if (text_width > max_text_width) max_text_width = text_width;
     }
 
+    // Last row adds an expression while there's room
+    if (free_slot(legend) >= 0) rows++;
+
+    return legend_box_rect(rows, max_text_width);
+}
+
+Rectangle legend_box_rect(int rows, int text_width) {
     // Calculate legend box size
-    int width = 3 * LEGEND_SPACING + LEGEND_ELEM_SIZE + max_text_width;
-    int height = (non_null + 1) * LEGEND_SPACING + non_null * LEGEND_ELEM_SIZE;
+    int width = 3 * LEGEND_SPACING + LEGEND_ELEM_SIZE + text_width;
+    int height = (rows + 1) * LEGEND_SPACING + rows * LEGEND_ELEM_SIZE;
 
-    // Draw legend box
-    Color color = COLOR_BRIGHT_BLACK;
-    color.a = LEGEND_OPACITY;
-    Rectangle box = {LEGEND_SPACING, LEGEND_SPACING, width, height};
-    DrawRectangleRec(box, color);
+    return (Rectangle){LEGEND_SPACING, LEGEND_SPACING, width, height};
+}
 
-    Vector2 mouse_pos = GetMousePosition();
+Rectangle legend_toggle_rect(int row) {
+    // Calculate color square coordinates of the nth listed entry
+    int color_x = 2 * LEGEND_SPACING;
+    int y = 2 * LEGEND_SPACING + row * (LEGEND_ELEM_SIZE + LEGEND_SPACING);
+
+    return (Rectangle){color_x, y, LEGEND_ELEM_SIZE, LEGEND_ELEM_SIZE};
+}
+
+int legend_text_x(void) {
+    return 3 * LEGEND_SPACING + LEGEND_ELEM_SIZE;
+}
+
+void legend_init(Legend *legend, ParsedExpression *expressions, int count, int capacity, Parser *parser) {
+    *legend = (Legend){
+        .expressions = expressions,
+        .count = count,
+        .capacity = capacity,
+        .parser = parser,
+        .editing = -1,
+    };
+}
+
+bool legend_hovered(Legend *legend) {
+    bool hovering = CheckCollisionPointRec(GetMousePosition(), legend_box(legend));
 
-    // Change cursor on legend box hover
-    if (CheckCollisionPointRec(mouse_pos, box)) SetMouseCursor(MOUSE_CURSOR_DEFAULT);
+    // Change cursor on legend box hover, to a text cursor over the entry being edited
+    if (hovering && legend->editing >= 0) SetMouseCursor(MOUSE_CURSOR_IBEAM);
+    else if (hovering) SetMouseCursor(MOUSE_CURSOR_DEFAULT);
     else SetMouseCursor(MOUSE_CURSOR_CROSSHAIR);
 
-    // Draw legend entries
-    int non_null_i = 0;
-    for (int i = 0; i < count; i++) {
-        if (expressions[i].root == NULL) continue;
+    return hovering;
+}
+
+/* --------------------------------- Editing -------------------------------- */
+
+static LegendChange merge_changes(LegendChange a, LegendChange b) {
+    return a > b ? a : b;
+}
+
+static LegendChange start_edit(Legend *legend, int index, bool added) {
+    const char *text = legend->expressions[index].text;
+    int length = (int)strlen(text);
+    if (length > LEGEND_EDIT_LENGTH - 1) length = LEGEND_EDIT_LENGTH - 1;
+
+    legend->editing = index;
+    legend->length = length;
+    legend->caret = length;
+    legend->added = added;
+    memcpy(legend->text, text, length);
+    legend->text[length] = '\0';
+    memcpy(legend->original, legend->text, length + 1);
+
+    // Escape cancels the edit instead of closing the window
+    SetExitKey(KEY_NULL);
+    return LEGEND_REDRAW;
+}
+
+static void reparse(Legend *legend, int index, const char *text) {
+    // Scans of the old curve may be evaluating it, and what they found no longer holds. Only those are cancelled,
+    // within a solver step, so every keystroke still shows in the next frame however many curves are scanned.
+    analysis_invalidate(index);
+    expression_edit(&legend->expressions[index], legend->parser, text);
+}
+
+static void remove_entry(Legend *legend, int index) {
+    // Same as an edit, the entry's markers go right away
+    analysis_invalidate(index);
+    expression_free(&legend->expressions[index]);
+    legend->expressions[index] = (ParsedExpression){0};
+
+    // Trailing empty slots are given back
+    while (legend->count > 0 && !listed(&legend->expressions[legend->count - 1])) legend->count--;
+}
+
+static LegendChange finish_edit(Legend *legend, bool cancel) {
+    int index = legend->editing;
+    legend->editing = -1;
+    SetExitKey(KEY_ESCAPE);
+
+    // Cancelling puts the text back as it was, which is nothing for an added entry
+    if (cancel && legend->added) {
+        legend->text[0] = '\0';
+    } else if (cancel && strcmp(legend->text, legend->original) != 0) {
+        memcpy(legend->text, legend->original, sizeof(legend->text));
+        reparse(legend, index, legend->text);
+    }
+
+    if (legend->text[strspn(legend->text, " ")] == '\0') remove_entry(legend, index);
+    return LEGEND_REGROUP;
+}
+
+static bool key_typed(int key) {
+    return IsKeyPressed(key) || IsKeyPressedRepeat(key);
+}
+
+static LegendChange type_text(Legend *legend) {
+    char *text = legend->text;
+    bool changed = false;
+
+    // Printable characters typed this frame, in order
+    for (int c = GetCharPressed(); c != 0; c = GetCharPressed()) {
+        if (c < ' ' || c > '~' || legend->length == LEGEND_EDIT_LENGTH - 1) continue;
 
-        // Calculate entry elements coordinates
-        int color_x = 2 * LEGEND_SPACING;
-        int text_x = 3 * LEGEND_SPACING + LEGEND_ELEM_SIZE;
-        int y = 2 * LEGEND_SPACING + non_null_i * (LEGEND_ELEM_SIZE + LEGEND_SPACING);
+        memmove(text + legend->caret + 1, text + legend->caret, legend->length - legend->caret + 1);
+        text[legend->caret++] = (char)c;
+        legend->length++;
+        changed = true;
+    }
+
+    if (key_typed(KEY_BACKSPACE) && legend->caret > 0) {
+        memmove(text + legend->caret - 1, text + legend->caret, legend->length - legend->caret + 1);
+        legend->caret--;
+        legend->length--;
+        changed = true;
+    }
+    if (key_typed(KEY_DELETE) && legend->caret < legend->length) {
+        memmove(text + legend->caret, text + legend->caret + 1, legend->length - legend->caret);
+        legend->length--;
+        changed = true;
+    }
+
+    // Caret moves only redraw the legend
+    int caret = legend->caret;
+    if (key_typed(KEY_LEFT) && legend->caret > 0) legend->caret--;
+    if (key_typed(KEY_RIGHT) && legend->caret < legend->length) legend->caret++;
+    if (IsKeyPressed(KEY_HOME)) legend->caret = 0;
+    if (IsKeyPressed(KEY_END)) legend->caret = legend->length;
+    bool moved = legend->caret != caret;
+
+    // Only the edited expression is parsed again, every other curve keeps its samples
+    if (changed) {
+        reparse(legend, legend->editing, text);
+        return LEGEND_EDITED;
+    }
+
+    return moved ? LEGEND_REDRAW : LEGEND_UNCHANGED;
+}
+
+LegendChange legend_update(Legend *legend) {
+    LegendChange change = LEGEND_UNCHANGED;
+
+    // Keys go to the entry being edited
+    if (legend->editing >= 0) {
+        if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_KP_ENTER)) return finish_edit(legend, false);
+        if (IsKeyPressed(KEY_ESCAPE)) return finish_edit(legend, true);
+        change = type_text(legend);
+    }
+
+    if (!IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) return change;
+
+    Vector2 mouse_pos = GetMousePosition();
+    Rectangle box = legend_box(legend);
+    int row = 0;
+
+    for (int i = 0; i < legend->count; i++) {
+        ParsedExpression *expression = &legend->expressions[i];
+        if (!listed(expression)) continue;
 
         // Check for click on color square
-        Rectangle toggle = {color_x, y, LEGEND_ELEM_SIZE, LEGEND_ELEM_SIZE};
+        Rectangle toggle = legend_toggle_rect(row++);
         if (CheckCollisionPointRec(mouse_pos, toggle)) {
             // Toggle visibility
-            if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT))
-                expressions[i].visible = !expressions[i].visible;
+            expression->visible = !expression->visible;
+            return LEGEND_REGROUP;
         }
 
-        DrawText(expressions[i].text, text_x, y, LEGEND_ELEM_SIZE, COLOR_BRIGHT_WHITE);
-        if (expressions[i].visible) DrawRectangleRec(toggle, expressions[i].color);
-        else DrawRectangleLinesEx(toggle, LEGEND_RECT_THICKNESS, expressions[i].color);
+        // Rest of the row edits the expression, data can't be edited
+        float text_x = toggle.x + toggle.width;
+        Rectangle text = {text_x, toggle.y, box.x + box.width - text_x, toggle.height};
+        if (!CheckCollisionPointRec(mouse_pos, text) || !expression_editable(expression)) continue;
+        if (legend->editing == i) return change;
 
-        non_null_i++;
+        if (legend->editing >= 0) change = merge_changes(change, finish_edit(legend, false));
+        return merge_changes(change, start_edit(legend, i, false));
     }
 
-    return CheckCollisionPointRec(mouse_pos, box);
+    // Last row adds an empty expression and edits it
+    if (free_slot(legend) >= 0 && CheckCollisionPointRec(mouse_pos, legend_toggle_rect(row))) {
+        if (legend->editing >= 0) change = merge_changes(change, finish_edit(legend, false));
+
+        Color colors[] = COLOR_POOL;
+        int slot = free_slot(legend);
+        legend->expressions[slot] = (ParsedExpression){
+            .color = colors[slot % (sizeof(colors) / sizeof(Color))],
+            .visible = true,
+        };
+        expression_parse(&legend->expressions[slot], legend->parser, "");
+        if (slot == legend->count) legend->count++;
+
+        return merge_changes(change, start_edit(legend, slot, true));
+    }
+
+    // Clicking off the legend finishes the edit
+    if (legend->editing >= 0 && !CheckCollisionPointRec(mouse_pos, box)) return finish_edit(legend, false);
+    return change;
+}
+
+void display_legend(Legend *legend) {
+    // Draw legend box
+    Color color = COLOR_BRIGHT_BLACK;
+    color.a = LEGEND_OPACITY;
+    DrawRectangleRec(legend_box(legend), color);
+
+    // Draw legend entries
+    int row = 0;
+    for (int i = 0; i < legend->count; i++) {
+        ParsedExpression *expression = &legend->expressions[i];
+        if (!listed(expression)) continue;
+
+        Rectangle toggle = legend_toggle_rect(row++);
+        int text_x = legend_text_x();
+        int text_width = MeasureText(expression->text, LEGEND_ELEM_SIZE);
+
+        DrawText(expression->text, text_x, toggle.y, LEGEND_ELEM_SIZE, COLOR_BRIGHT_WHITE);
+        if (expression->visible) DrawRectangleRec(toggle, expression->color);
+        else DrawRectangleLinesEx(toggle, LEGEND_RECT_THICKNESS, expression->color);
+
+        // Caret of the entry being edited
+        if (legend->editing == i) {
+            char before[LEGEND_EDIT_LENGTH];
+            memcpy(before, legend->text, legend->caret);
+            before[legend->caret] = '\0';
+
+            int caret_x = text_x + MeasureText(before, LEGEND_ELEM_SIZE);
+            DrawRectangle(caret_x, toggle.y, LEGEND_CARET_WIDTH, LEGEND_ELEM_SIZE, COLOR_BRIGHT_WHITE);
+        }
+
+        // Why the expression isn't plotted, after its text
+        if (expression->error[0] != '\0') {
+            int error_y = toggle.y + (LEGEND_ELEM_SIZE - LEGEND_ERROR_SIZE) / 2;
+            DrawText(expression->error, text_x + text_width + LEGEND_SPACING, error_y, LEGEND_ERROR_SIZE,
+                     COLOR_BRIGHT_RED);
+        }
+    }
+
+    // Row adding an expression
+    if (free_slot(legend) >= 0) {
+        Rectangle toggle = legend_toggle_rect(row);
+        int plus_x = toggle.x + (LEGEND_ELEM_SIZE - MeasureText("+", LEGEND_ELEM_SIZE)) / 2;
+
+        DrawRectangleLinesEx(toggle, LEGEND_RECT_THICKNESS, COLOR_BRIGHT_WHITE);
+        DrawText("+", plus_x, toggle.y, LEGEND_ELEM_SIZE, COLOR_BRIGHT_WHITE);
+    }
 }
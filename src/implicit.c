@@ -0,0 +1,585 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "implicit.h"
+#include "pool.h"
+
+#define NODES  (IMPLICIT_TILE_CELLS + 1)                    // Lattice nodes along each side of a tile
+#define EDGES  (2 * IMPLICIT_TILE_CELLS * NODES)            // Cell edges in a tile, horizontal ones first
+#define BLOCKS (IMPLICIT_TILE_CELLS / IMPLICIT_BLOCK_CELLS) // Blocks along each side of a tile
+
+static const double pi = 3.14159265358979323846;
+
+bool implicit_is_relation(const Node *root) {
+    if (root == NULL) return false;
+
+    switch (root->type) {
+        case NODE_VARIABLE:
+            return root->as.variable.length == 1 && root->as.variable.name[0] == 'y';
+        case NODE_UNARY:
+            return implicit_is_relation(root->as.unary.operand);
+        case NODE_BINARY:
+            return implicit_is_relation(root->as.binary.left) || implicit_is_relation(root->as.binary.right);
+        case NODE_CALL:
+            return implicit_is_relation(root->as.call.argument);
+        default:
+            return false;
+    }
+}
+
+void implicit_init(ImplicitCache *cache) {
+    *cache = (ImplicitCache){.level = INT_MIN};
+}
+
+/* -------------------------------- Intervals ------------------------------- */
+
+// Range of values, empty if lo > hi
+typedef struct {
+    double lo, hi;
+} Interval;
+
+static const Interval whole = {-INFINITY, INFINITY};
+static const Interval empty = {INFINITY, -INFINITY};
+
+static bool is_empty(Interval a) {
+    return !(a.lo <= a.hi);
+}
+
+static Interval span(const double *values, int count) {
+    // Undefined combinations like 0 * inf could be anything
+    Interval result = empty;
+    for (int i = 0; i < count; i++) {
+        if (isnan(values[i])) return whole;
+        if (values[i] < result.lo) result.lo = values[i];
+        if (values[i] > result.hi) result.hi = values[i];
+    }
+
+    return result;
+}
+
+static Interval interval_mul(Interval a, Interval b) {
+    double products[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+    return span(products, 4);
+}
+
+static Interval interval_div(Interval a, Interval b) {
+    if (b.lo <= 0 && b.hi >= 0) return whole;
+    return interval_mul(a, (Interval){1 / b.hi, 1 / b.lo});
+}
+
+static Interval interval_abs(Interval a) {
+    if (a.lo >= 0) return a;
+    if (a.hi <= 0) return (Interval){-a.hi, -a.lo};
+    return (Interval){0, fmax(-a.lo, a.hi)};
+}
+
+static Interval interval_pow(Interval a, Interval b) {
+    // Integer powers of any base
+    if (b.lo == b.hi && b.lo == floor(b.lo) && fabs(b.lo) < 1e9) {
+        double n = b.lo;
+        bool odd = fmod(n, 2) != 0;
+        if (n == 0) return (Interval){1, 1};
+        if (n < 0 && a.lo <= 0 && a.hi >= 0) return whole;
+
+        // Odd powers are monotonic, even ones depend on the distance from zero
+        Interval base = odd ? a : interval_abs(a);
+        double ends[] = {pow(base.lo, n), pow(base.hi, n)};
+        return span(ends, 2);
+    }
+
+    // Other powers are only defined for non-negative bases, where they are monotonic in both arguments
+    if (a.lo < 0) return whole;
+    double corners[] = {pow(a.lo, b.lo), pow(a.lo, b.hi), pow(a.hi, b.lo), pow(a.hi, b.hi)};
+    return span(corners, 4);
+}
+
+static Interval interval_cos(Interval a) {
+    if (!(a.hi - a.lo < 2 * pi)) return (Interval){-1, 1};
+
+    double ends[] = {cos(a.lo), cos(a.hi)};
+    Interval result = span(ends, 2);
+
+    // Maxima at even multiples of pi and minima at odd ones
+    if (ceil(a.lo / (2 * pi)) <= floor(a.hi / (2 * pi))) result.hi = 1;
+    if (ceil((a.lo - pi) / (2 * pi)) <= floor((a.hi - pi) / (2 * pi))) result.lo = -1;
+    return result;
+}
+
+static Interval interval_call(FuncId func, Interval a) {
+    double ends[2];
+
+    switch (func) {
+        case FUNC_SIN:
+            return interval_cos((Interval){a.lo - pi / 2, a.hi - pi / 2});
+        case FUNC_COS:
+            return interval_cos(a);
+        case FUNC_TAN:
+            // Poles at odd multiples of pi/2
+            if (!(a.hi - a.lo < pi) || ceil((a.lo - pi / 2) / pi) <= floor((a.hi - pi / 2) / pi)) return whole;
+            return (Interval){tan(a.lo), tan(a.hi)};
+        case FUNC_ASIN:
+        case FUNC_ACOS: {
+            Interval domain = {fmax(a.lo, -1), fmin(a.hi, 1)};
+            if (is_empty(domain)) return empty;
+            if (func == FUNC_ASIN) return (Interval){asin(domain.lo), asin(domain.hi)};
+            return (Interval){acos(domain.hi), acos(domain.lo)};
+        }
+        case FUNC_ATAN: return (Interval){atan(a.lo), atan(a.hi)};
+        case FUNC_SINH: return (Interval){sinh(a.lo), sinh(a.hi)};
+        case FUNC_TANH: return (Interval){tanh(a.lo), tanh(a.hi)};
+        case FUNC_EXP:  return (Interval){exp(a.lo), exp(a.hi)};
+        case FUNC_COSH: {
+            Interval distance = interval_abs(a);
+            return (Interval){cosh(distance.lo), cosh(distance.hi)};
+        }
+        case FUNC_LN:
+        case FUNC_LOG:
+        case FUNC_SQRT: {
+            // Negative arguments have no value, ln(0) is only -inf
+            if (a.hi < 0 || (a.hi == 0 && func != FUNC_SQRT)) return empty;
+            ends[0] = fmax(a.lo, 0);
+            ends[1] = a.hi;
+            if (func == FUNC_LN) return (Interval){log(ends[0]), log(ends[1])};
+            if (func == FUNC_LOG) return (Interval){log10(ends[0]), log10(ends[1])};
+            return (Interval){sqrt(ends[0]), sqrt(ends[1])};
+        }
+        case FUNC_ABS:
+            return interval_abs(a);
+        default:
+            return whole;
+    }
+}
+
+static Interval interval_evaluate(const Program *program, Interval x, Interval y) {
+    Interval registers[PROGRAM_MAX_REGISTERS] = {0};
+    Interval result = whole;
+
+    for (int pc = 0; pc < program->count; pc++) {
+        const Instruction *in = &program->code[pc];
+        Interval a = registers[in->a], b = registers[in->b];
+        Interval *dst = &registers[in->dst];
+
+        // Gaps in the domain propagate through every operation
+        bool unary = in->op == OP_NEG || in->op == OP_CALL || in->op == OP_STORE;
+        bool binary = in->op >= OP_ADD && in->op <= OP_POW;
+        if ((unary && is_empty(a)) || (binary && (is_empty(a) || is_empty(b)))) {
+            if (in->op == OP_STORE) result = empty;
+            else *dst = empty;
+            continue;
+        }
+
+        switch (in->op) {
+            case OP_CONST: *dst = (Interval){in->value, in->value}; break;
+            case OP_X:     *dst = x; break;
+            case OP_Y:     *dst = y; break;
+            case OP_NEG:   *dst = (Interval){-a.hi, -a.lo}; break;
+            case OP_ADD:   *dst = (Interval){a.lo + b.lo, a.hi + b.hi}; break;
+            case OP_SUB:   *dst = (Interval){a.lo - b.hi, a.hi - b.lo}; break;
+            case OP_MUL:   *dst = interval_mul(a, b); break;
+            case OP_DIV:   *dst = interval_div(a, b); break;
+            case OP_POW:   *dst = interval_pow(a, b); break;
+            case OP_CALL:  *dst = interval_call(in->func, a); break;
+            case OP_STORE: result = a; continue;
+        }
+
+        // inf - inf and the like
+        if (isnan(dst->lo) || isnan(dst->hi)) *dst = whole;
+    }
+
+    return result;
+}
+
+static bool may_vanish(const Program *program, Interval x, Interval y) {
+    Interval value = interval_evaluate(program, x, y);
+    if (is_empty(value)) return false;
+
+    // Widen by a little more than the rounding error of the point evaluation
+    double slack = 1e-12 * fmax(fabs(value.lo), fabs(value.hi)) + 1e-300;
+    return value.lo - slack <= 0 && value.hi + slack >= 0;
+}
+
+/* ------------------------------ Tile tracing ------------------------------ */
+
+// Sign change along a cell edge, narrowed down by regula falsi
+typedef struct {
+    double x0, y0; // Start of the edge
+    double dx, dy; // Edge direction and length
+    double t_lo, f_lo;
+    double t_hi, f_hi;
+    double t, f;   // Latest estimate and its value
+    double limit;  // Largest value the estimate may have before it's taken for a pole
+    int side;      // Bracket end replaced last, -1 for the low one and 1 for the high one
+    int links[2];  // Crossings joined by segments, -1 if none
+    bool used;     // Already part of a polyline
+} Crossing;
+
+// Scratch buffers reused across tiles, one set per thread since tiles are traced on the worker pool
+static _Thread_local struct {
+    double values[NODES * NODES];
+    double xs[EDGES]; // Points evaluated at once, every node or every crossing
+    double ys[EDGES];
+    double results[EDGES];
+    int nodes[NODES * NODES]; // Lattice node of each evaluated point
+    int edges[EDGES];         // Crossing on each edge, -1 if none
+    Crossing *crossings;
+    int crossing_count;
+    int crossing_capacity;
+} scratch;
+
+static void reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return;
+
+    *capacity = count * 2;
+    *buffer = realloc(*buffer, size * *capacity);
+}
+
+static void push_point(ImplicitTile *tile, SamplePoint point) {
+    reserve((void **)&tile->points, &tile->capacity, tile->count + 1, sizeof(SamplePoint));
+    tile->points[tile->count++] = point;
+}
+
+static int add_crossing(int edge, double x0, double y0, double dx, double dy, double f0, double f1) {
+    if (scratch.edges[edge] >= 0) return scratch.edges[edge];
+
+    reserve((void **)&scratch.crossings, &scratch.crossing_capacity, scratch.crossing_count + 1, sizeof(Crossing));
+    scratch.crossings[scratch.crossing_count] = (Crossing){
+        .x0 = x0, .y0 = y0, .dx = dx, .dy = dy,
+        .t_lo = 0, .f_lo = f0, .t_hi = 1, .f_hi = f1,
+        .t = f0 / (f0 - f1),
+        .limit = fmax(fabs(f0), fabs(f1)),
+        .links = {-1, -1},
+    };
+
+    scratch.edges[edge] = scratch.crossing_count;
+    return scratch.crossing_count++;
+}
+
+static void link_crossings(int a, int b) {
+    Crossing *first = &scratch.crossings[a], *second = &scratch.crossings[b];
+    first->links[first->links[0] < 0 ? 0 : 1] = b;
+    second->links[second->links[0] < 0 ? 0 : 1] = a;
+}
+
+static int march_cells(bool live[BLOCKS][BLOCKS], double origin_x, double origin_y, double cell) {
+    scratch.crossing_count = 0;
+    memset(scratch.edges, -1, sizeof(scratch.edges));
+
+    // Edge k of a cell joins these corners, counted counter-clockwise from the bottom left
+    static const int ends[4][2] = {{0, 1}, {1, 2}, {3, 2}, {0, 3}};
+    static const double starts[4][2] = {{0, 0}, {1, 0}, {0, 1}, {0, 0}};
+
+    for (int j = 0; j < IMPLICIT_TILE_CELLS; j++) {
+        for (int i = 0; i < IMPLICIT_TILE_CELLS; i++) {
+            if (!live[j / IMPLICIT_BLOCK_CELLS][i / IMPLICIT_BLOCK_CELLS]) continue;
+
+            double f[4] = {
+                scratch.values[j * NODES + i],
+                scratch.values[j * NODES + i + 1],
+                scratch.values[(j + 1) * NODES + i + 1],
+                scratch.values[(j + 1) * NODES + i],
+            };
+            if (isnan(f[0]) || isnan(f[1]) || isnan(f[2]) || isnan(f[3])) continue;
+
+            bool positive[4];
+            for (int k = 0; k < 4; k++) positive[k] = f[k] > 0;
+            if (positive[0] == positive[1] && positive[1] == positive[2] && positive[2] == positive[3]) continue;
+
+            // Horizontal edges are numbered first, then vertical ones
+            int edge_ids[4] = {
+                j * IMPLICIT_TILE_CELLS + i,
+                IMPLICIT_TILE_CELLS * NODES + j * NODES + i + 1,
+                (j + 1) * IMPLICIT_TILE_CELLS + i,
+                IMPLICIT_TILE_CELLS * NODES + j * NODES + i,
+            };
+
+            int crossings[4], found[4], found_count = 0;
+            for (int k = 0; k < 4; k++) {
+                crossings[k] = -1;
+                if (positive[ends[k][0]] == positive[ends[k][1]]) continue;
+
+                double x = origin_x + (i + starts[k][0]) * cell, y = origin_y + (j + starts[k][1]) * cell;
+                double dx = k % 2 == 0 ? cell : 0, dy = k % 2 == 0 ? 0 : cell;
+                crossings[k] = add_crossing(edge_ids[k], x, y, dx, dy, f[ends[k][0]], f[ends[k][1]]);
+                found[found_count++] = crossings[k];
+            }
+
+            if (found_count == 2) {
+                link_crossings(found[0], found[1]);
+                continue;
+            }
+
+            // Saddles cut off the two corners on the other side of the center, judged by the mean of the corners.
+            // Corner k lies between edges k - 1 and k
+            bool center = f[0] + f[1] + f[2] + f[3] > 0;
+            for (int k = 0; k < 4; k++) {
+                if (positive[k] != center) link_crossings(crossings[(k + 3) % 4], crossings[k]);
+            }
+        }
+    }
+
+    return scratch.crossing_count;
+}
+
+static void refine_crossings(ParsedExpression *expression) {
+    int count = scratch.crossing_count;
+
+    for (int step = 0; step < IMPLICIT_REFINE_STEPS; step++) {
+        for (int c = 0; c < count; c++) {
+            Crossing *crossing = &scratch.crossings[c];
+            scratch.xs[c] = crossing->x0 + crossing->t * crossing->dx;
+            scratch.ys[c] = crossing->y0 + crossing->t * crossing->dy;
+        }
+
+        expression_evaluate_relation(expression, scratch.xs, scratch.ys, scratch.results, count);
+        atomic_fetch_add(&expression->evaluations, count);
+
+        for (int c = 0; c < count; c++) {
+            Crossing *crossing = &scratch.crossings[c];
+            crossing->f = scratch.results[c];
+            if (crossing->f == 0 || isnan(crossing->f)) continue;
+
+            // Illinois variant, halving the value of a bracket end kept twice in a row
+            if ((crossing->f > 0) == (crossing->f_lo > 0)) {
+                crossing->t_lo = crossing->t;
+                crossing->f_lo = crossing->f;
+                if (crossing->side < 0) crossing->f_hi /= 2;
+                crossing->side = -1;
+            } else {
+                crossing->t_hi = crossing->t;
+                crossing->f_hi = crossing->f;
+                if (crossing->side > 0) crossing->f_lo /= 2;
+                crossing->side = 1;
+            }
+
+            // Last estimate stays where it was evaluated
+            if (step + 1 < IMPLICIT_REFINE_STEPS) {
+                crossing->t = (crossing->t_lo * crossing->f_hi - crossing->t_hi * crossing->f_lo) /
+                              (crossing->f_hi - crossing->f_lo);
+            }
+        }
+    }
+}
+
+static bool crossing_valid(int index) {
+    // Sign changes that grow instead of vanishing are poles, not the curve
+    const Crossing *crossing = &scratch.crossings[index];
+    return !isnan(crossing->f) && fabs(crossing->f) <= crossing->limit;
+}
+
+static SamplePoint crossing_point(int index) {
+    const Crossing *crossing = &scratch.crossings[index];
+    return (SamplePoint){crossing->x0 + crossing->t * crossing->dx, crossing->y0 + crossing->t * crossing->dy};
+}
+
+static void emit_polylines(ImplicitTile *tile) {
+    // Open polylines start at a crossing linked once, closed loops anywhere
+    for (int pass = 0; pass < 2; pass++) {
+        for (int c = 0; c < scratch.crossing_count; c++) {
+            Crossing *start = &scratch.crossings[c];
+            if (start->used || !crossing_valid(c)) continue;
+
+            int degree = 0;
+            for (int k = 0; k < 2; k++) degree += start->links[k] >= 0 && crossing_valid(start->links[k]);
+            if (degree == 0 || (pass == 0 && degree == 2)) continue;
+
+            // Follow the links until they run out or come back around
+            int previous = -1, current = c;
+            start->used = true;
+            push_point(tile, crossing_point(c));
+
+            for (;;) {
+                int next = -1;
+                bool closed = false;
+                for (int k = 0; k < 2; k++) {
+                    int link = scratch.crossings[current].links[k];
+                    if (link < 0 || link == previous || !crossing_valid(link)) continue;
+                    if (link == c) closed = true;
+                    else if (!scratch.crossings[link].used) next = link;
+                }
+
+                if (next < 0) {
+                    if (closed) push_point(tile, crossing_point(c));
+                    break;
+                }
+
+                scratch.crossings[next].used = true;
+                push_point(tile, crossing_point(next));
+                previous = current;
+                current = next;
+            }
+
+            push_point(tile, (SamplePoint){NAN, NAN});
+        }
+    }
+}
+
+static void trace_tile(void *arg) {
+    ImplicitTile *tile = arg;
+    ParsedExpression *expression = tile->expression;
+    tile->count = 0;
+
+    // Lattice coordinates are exact multiples of the cell size, so tiles agree on their shared edges
+    double cell = ldexp(1.0, tile->level);
+    long long first_i = tile->tx * IMPLICIT_TILE_CELLS, first_j = tile->ty * IMPLICIT_TILE_CELLS;
+
+    // Blocks where the value can't reach zero are skipped, only possible for compiled relations
+    bool live[BLOCKS][BLOCKS];
+    bool any = false;
+    for (int bj = 0; bj < BLOCKS; bj++) {
+        for (int bi = 0; bi < BLOCKS; bi++) {
+            long long i = first_i + bi * IMPLICIT_BLOCK_CELLS, j = first_j + bj * IMPLICIT_BLOCK_CELLS;
+            Interval x = {i * cell, (i + IMPLICIT_BLOCK_CELLS) * cell};
+            Interval y = {j * cell, (j + IMPLICIT_BLOCK_CELLS) * cell};
+
+            live[bj][bi] = !expression->compiled || may_vanish(&expression->program, x, y);
+            any |= live[bj][bi];
+        }
+    }
+
+    if (any) {
+        // Evaluate the nodes of live blocks, the rest stay NaN
+        int count = 0;
+        for (int j = 0; j < NODES; j++) {
+            for (int i = 0; i < NODES; i++) {
+                scratch.values[j * NODES + i] = NAN;
+
+                bool needed = false;
+                for (int bj = j / IMPLICIT_BLOCK_CELLS - 1; bj <= j / IMPLICIT_BLOCK_CELLS; bj++) {
+                    for (int bi = i / IMPLICIT_BLOCK_CELLS - 1; bi <= i / IMPLICIT_BLOCK_CELLS; bi++) {
+                        if (bj >= 0 && bj < BLOCKS && bi >= 0 && bi < BLOCKS && live[bj][bi]) needed = true;
+                    }
+                }
+                if (!needed) continue;
+
+                scratch.xs[count] = (first_i + i) * cell;
+                scratch.ys[count] = (first_j + j) * cell;
+                scratch.nodes[count++] = j * NODES + i;
+            }
+        }
+
+        expression_evaluate_relation(expression, scratch.xs, scratch.ys, scratch.results, count);
+        for (int n = 0; n < count; n++) scratch.values[scratch.nodes[n]] = scratch.results[n];
+        atomic_fetch_add(&expression->evaluations, count);
+
+        // Marching squares, then move every crossing from the linear estimate onto the curve
+        if (march_cells(live, first_i * cell, first_j * cell, cell) > 0) {
+            refine_crossings(expression);
+            emit_polylines(tile);
+        }
+    }
+
+    atomic_store(&tile->state, TILE_READY);
+}
+
+/* -------------------------------- Caching --------------------------------- */
+
+static ImplicitTile *claim_tile(ImplicitCache *cache) {
+    // Least recently visible tile that isn't on screen or being traced, once the cache is full
+    ImplicitTile *oldest = NULL;
+    for (int i = 0; i < cache->tile_count && cache->tile_count >= IMPLICIT_CACHE_TILES; i++) {
+        ImplicitTile *tile = cache->tiles[i];
+        if (atomic_load(&tile->state) == TILE_PENDING || tile->stamp == cache->frame) continue;
+        if (oldest == NULL || tile->stamp < oldest->stamp) oldest = tile;
+    }
+    if (oldest != NULL) return oldest;
+
+    // Otherwise add one, so views with more tiles than the cache holds have no holes
+    reserve((void **)&cache->tiles, &cache->tile_capacity, cache->tile_count + 1, sizeof(ImplicitTile *));
+    ImplicitTile *tile = calloc(1, sizeof(ImplicitTile));
+    atomic_init(&tile->state, TILE_FREE);
+    cache->tiles[cache->tile_count++] = tile;
+
+    return tile;
+}
+
+void implicit_schedule(ParsedExpression *expression, SampleView view) {
+    ImplicitCache *cache = expression->implicit;
+    cache->frame++;
+
+    // Power-of-two cells between half and all of the widest cell size on screen, so zooming only
+    // changes level when their size doubles
+    int level = (int)floor(log2(IMPLICIT_CELL_PIXELS / view.scale));
+    double size = ldexp(IMPLICIT_TILE_CELLS, level);
+    long long min_tx = (long long)floor(view.min_x / size), max_tx = (long long)floor(view.max_x / size);
+    long long min_ty = (long long)floor(view.min_y / size), max_ty = (long long)floor(view.max_y / size);
+    int columns = (int)(max_tx - min_tx + 1), rows = (int)(max_ty - min_ty + 1);
+
+    // Find cached tiles of the view
+    reserve((void **)&cache->visible, &cache->visible_capacity, columns * rows, sizeof(ImplicitTile *));
+    memset(cache->visible, 0, sizeof(ImplicitTile *) * columns * rows);
+    for (int i = 0; i < cache->tile_count; i++) {
+        ImplicitTile *tile = cache->tiles[i];
+        if (atomic_load(&tile->state) == TILE_FREE || tile->level != level) continue;
+        if (tile->tx < min_tx || tile->tx > max_tx || tile->ty < min_ty || tile->ty > max_ty) continue;
+
+        cache->visible[(tile->ty - min_ty) * columns + (tile->tx - min_tx)] = tile;
+        tile->stamp = cache->frame;
+    }
+
+    // Trace the missing ones in the background
+    int ready = 0, total = 0;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            ImplicitTile **slot = &cache->visible[row * columns + column];
+            if (*slot == NULL) {
+                ImplicitTile *tile = *slot = claim_tile(cache);
+                tile->level = level;
+                tile->tx = min_tx + column;
+                tile->ty = min_ty + row;
+                tile->stamp = cache->frame;
+                tile->expression = expression;
+                atomic_store(&tile->state, TILE_PENDING);
+                pool_submit(&expression->job, trace_tile, tile);
+            }
+
+            total++;
+            if (atomic_load(&(*slot)->state) == TILE_READY) ready++;
+        }
+    }
+
+    // Panning shows tiles as they finish, a new level waits until it's complete to replace the old one
+    bool same = level == cache->level && min_tx == cache->min_tx && max_tx == cache->max_tx &&
+                min_ty == cache->min_ty && max_ty == cache->max_ty;
+    cache->complete = same && ready == cache->ready && ready == total;
+    if (same && ready == cache->ready) return;
+    if (level != cache->level && ready < total) return;
+
+    SamplePath *path = &expression->path;
+    path->count = 0;
+    for (int i = 0; i < columns * rows; i++) {
+        ImplicitTile *tile = cache->visible[i];
+        if (tile == NULL || atomic_load(&tile->state) != TILE_READY) continue;
+        for (int p = 0; p < tile->count; p++) sample_path_push(path, tile->points[p]);
+    }
+    path->version++;
+
+    cache->level = level;
+    cache->min_tx = min_tx;
+    cache->max_tx = max_tx;
+    cache->min_ty = min_ty;
+    cache->max_ty = max_ty;
+    cache->ready = ready;
+    cache->complete = ready == total;
+}
+
+bool implicit_pending(ParsedExpression *expression) {
+    return pool_busy(&expression->job) || !expression->implicit->complete;
+}
+
+void implicit_thread_free(void) {
+    free(scratch.crossings);
+    scratch.crossings = NULL;
+    scratch.crossing_capacity = 0;
+}
+
+void implicit_free(ImplicitCache *cache) {
+    for (int i = 0; i < cache->tile_count; i++) {
+        free(cache->tiles[i]->points);
+        free(cache->tiles[i]);
+    }
+    free(cache->tiles);
+    free(cache->visible);
+    *cache = (ImplicitCache){0};
+}
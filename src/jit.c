@@ -0,0 +1,416 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jit.h"
+#include "kernels.h"
+
+#if PROGRAM_JIT && defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+// Registers holding the arguments for the whole call, all of them callee-saved
+#define REG_SLOTS 3  // rbx, program registers
+#define REG_XS    12 // r12
+#define REG_YS_IN 13 // r13
+
+// Bytes between program registers, each holding a whole batch
+#define SLOT_BYTES (PROGRAM_BATCH * (int)sizeof(double))
+
+// Packed double opcodes, prefixed by 66 0F or the equivalent VEX prefix
+#define OPCODE_LOAD  0x10 // movupd
+#define OPCODE_STORE 0x11
+#define OPCODE_MOVE  0x28 // movapd between registers
+#define OPCODE_SQRT  0x51
+#define OPCODE_AND   0x54
+#define OPCODE_XOR   0x57
+#define OPCODE_ADD   0x58
+#define OPCODE_MUL   0x59
+#define OPCODE_SUB   0x5C
+#define OPCODE_DIV   0x5E
+
+// Constant pool entries hold a value for every lane of the widest vector
+#define POOL_LANES 4
+#define POOL_ENTRY (POOL_LANES * (int)sizeof(double))
+
+// Where an operand is read from
+typedef enum {
+    OPERAND_REGISTER, // Vector register
+    OPERAND_SLOT,     // Program register, at the current vector
+    OPERAND_INPUT,    // Array passed by the caller, at the current vector
+    OPERAND_POOL,     // Constant repeated over every lane
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int index; // Vector register, slot, base register or pool entry
+} Operand;
+
+// Constant pool reference to patch once the code size is known
+typedef struct {
+    int position; // Offset of the 32-bit displacement
+    int entry;
+} Fixup;
+
+// Machine code of one program being generated
+typedef struct {
+    uint8_t *bytes;
+    int count;
+    int capacity;
+    bool avx; // Four lanes with VEX encodings, otherwise two with SSE2
+    int lanes;
+
+    uint64_t *pool; // Bits of each constant
+    int pool_count;
+    int pool_capacity;
+    Fixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+
+    int cached; // Slot whose value register 0 still holds from the last instruction, -1 if none
+} Assembler;
+
+static void reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return;
+
+    *capacity = count * 2;
+    *buffer = realloc(*buffer, size * *capacity);
+}
+
+static void emit_bytes(Assembler *as, const uint8_t *bytes, int count) {
+    reserve((void **)&as->bytes, &as->capacity, as->count + count, 1);
+    memcpy(as->bytes + as->count, bytes, count);
+    as->count += count;
+}
+
+#define EMIT(as, ...) emit_bytes(as, (const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+static void emit_u32(Assembler *as, uint32_t value) {
+    EMIT(as, value, value >> 8, value >> 16, value >> 24);
+}
+
+static void emit_u64(Assembler *as, uint64_t value) {
+    emit_u32(as, (uint32_t)value);
+    emit_u32(as, (uint32_t)(value >> 32));
+}
+
+static Operand pool_operand(Assembler *as, uint64_t bits) {
+    for (int i = 0; i < as->pool_count; i++) {
+        if (as->pool[i] == bits) return (Operand){OPERAND_POOL, i};
+    }
+
+    reserve((void **)&as->pool, &as->pool_capacity, as->pool_count + 1, sizeof(uint64_t));
+    as->pool[as->pool_count] = bits;
+    return (Operand){OPERAND_POOL, as->pool_count++};
+}
+
+static void emit_instruction(Assembler *as, uint8_t opcode, int dst, int src, Operand operand) {
+    // Only vector registers 0 and 1 are used, so REX.R is never needed
+    int base = operand.kind == OPERAND_INPUT ? operand.index : REG_SLOTS;
+    bool extended = operand.kind == OPERAND_INPUT && base >= 8;
+
+    if (as->avx) {
+        // Three-byte VEX for 256-bit vectors with the 66 prefix, `src` being the first source
+        EMIT(as, 0xC4, extended ? 0xC1 : 0xE1, 0x05 | (~src & 15) << 3, opcode);
+    } else if (extended) {
+        EMIT(as, 0x66, 0x41, 0x0F, opcode);
+    } else {
+        EMIT(as, 0x66, 0x0F, opcode);
+    }
+
+    switch (operand.kind) {
+        case OPERAND_REGISTER:
+            EMIT(as, 0xC0 | dst << 3 | operand.index);
+            break;
+
+        case OPERAND_SLOT:
+        case OPERAND_INPUT:
+            // [base + rax + displacement], rax being the byte offset of the current vector
+            EMIT(as, 0x84 | dst << 3, base & 7);
+            emit_u32(as, (uint32_t)(operand.kind == OPERAND_SLOT ? operand.index * SLOT_BYTES : 0));
+            break;
+
+        case OPERAND_POOL:
+            // [rip + displacement], patched once the pool is placed after the code
+            EMIT(as, 0x05 | dst << 3);
+            reserve((void **)&as->fixups, &as->fixup_capacity, as->fixup_count + 1, sizeof(Fixup));
+            as->fixups[as->fixup_count++] = (Fixup){as->count, operand.index};
+            emit_u32(as, 0);
+            break;
+    }
+}
+
+static void emit_vzeroupper(Assembler *as) {
+    // Dirty upper halves slow down the SSE code in libm and the kernels
+    if (as->avx) EMIT(as, 0xC5, 0xF8, 0x77);
+}
+
+static int lane_shift(Assembler *as) {
+    return as->lanes == 4 ? 2 : 1;
+}
+
+static int emit_loop_start(Assembler *as) {
+    // xor eax, eax; mov rdx, r15; shl rdx, log2(vector bytes)
+    EMIT(as, 0x31, 0xC0, 0x4C, 0x89, 0xFA, 0x48, 0xC1, 0xE2, 3 + lane_shift(as));
+    as->cached = -1;
+    return as->count;
+}
+
+static void emit_loop_end(Assembler *as, int start) {
+    // add rax, vector bytes; cmp rax, rdx; jb start
+    EMIT(as, 0x48, 0x83, 0xC0, as->lanes * sizeof(double), 0x48, 0x39, 0xD0, 0x0F, 0x82);
+    emit_u32(as, (uint32_t)(start - (as->count + 4)));
+    as->cached = -1;
+}
+
+static void emit_call(Assembler *as, const Instruction *in) {
+    emit_vzeroupper(as);
+
+    // Kernels work on the whole batch in place: lea rdi, [rbx + dst]
+    EMIT(as, 0x48, 0x8D, 0xBB);
+    emit_u32(as, (uint32_t)(in->dst * SLOT_BYTES));
+
+    // Function pointers can't be cast to integers in ISO C, so their bits are copied
+    uint64_t function;
+    if (in->op == OP_POW) {
+        // lea rsi, [rbx + b]; mov edx, r15d; shl edx, log2(lanes)
+        EMIT(as, 0x48, 0x8D, 0xB3);
+        emit_u32(as, (uint32_t)(in->b * SLOT_BYTES));
+        EMIT(as, 0x44, 0x89, 0xFA, 0xC1, 0xE2, lane_shift(as));
+        memcpy(&function, &kernels->pow, sizeof(function));
+    } else {
+        // mov esi, r15d; shl esi, log2(lanes)
+        EMIT(as, 0x44, 0x89, 0xFE, 0xC1, 0xE6, lane_shift(as));
+        memcpy(&function, &kernels->call[in->func], sizeof(function));
+    }
+
+    // mov rax, function; call rax
+    EMIT(as, 0x48, 0xB8);
+    emit_u64(as, function);
+    EMIT(as, 0xFF, 0xD0);
+}
+
+static bool is_inline(const Instruction *in) {
+    // Everything but libm functions has a packed instruction
+    return in->op != OP_POW && (in->op != OP_CALL || in->func == FUNC_SQRT || in->func == FUNC_ABS);
+}
+
+static bool reads(const Instruction *in, int slot) {
+    switch (in->op) {
+        case OP_CONST:
+        case OP_X:
+        case OP_Y:
+            return false;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_POW:
+            return in->a == slot || in->b == slot;
+
+        default:
+            return in->a == slot;
+    }
+}
+
+static bool writes(const Instruction *in, int slot) {
+    return in->op != OP_STORE && in->dst == slot;
+}
+
+static bool needs_store(const Program *program, int pc) {
+    // The next packed instruction takes the value straight from register 0
+    int slot = program->code[pc].dst;
+    int next = pc + 1;
+    if (next < program->count && is_inline(&program->code[next])) {
+        if (writes(&program->code[next], slot)) return false;
+        next++;
+    }
+
+    // Otherwise the slot is only written if something reads it before it's overwritten
+    for (; next < program->count; next++) {
+        if (reads(&program->code[next], slot)) return true;
+        if (writes(&program->code[next], slot)) return false;
+    }
+
+    return false;
+}
+
+static void load_operand(Assembler *as, int slot) {
+    if (slot == as->cached) return;
+    emit_instruction(as, OPCODE_LOAD, 0, 0, (Operand){OPERAND_SLOT, slot});
+}
+
+static Operand second_operand(Assembler *as, const Instruction *in) {
+    // A cached second operand moves to register 1 before the first one is loaded over it
+    if (in->b == as->cached && in->a != as->cached) {
+        emit_instruction(as, OPCODE_MOVE, 1, 0, (Operand){OPERAND_REGISTER, 0});
+        as->cached = -1;
+        load_operand(as, in->a);
+        return (Operand){OPERAND_REGISTER, 1};
+    }
+
+    load_operand(as, in->a);
+    if (in->b == in->a) return (Operand){OPERAND_REGISTER, 0};
+    return (Operand){OPERAND_SLOT, in->b};
+}
+
+static void emit_inline(Assembler *as, const Program *program, int pc) {
+    const Instruction *in = &program->code[pc];
+    uint64_t bits;
+
+    // Every result is computed in register 0
+    switch (in->op) {
+        case OP_CONST:
+            memcpy(&bits, &in->value, sizeof(bits));
+            emit_instruction(as, OPCODE_LOAD, 0, 0, pool_operand(as, bits));
+            break;
+
+        case OP_X: emit_instruction(as, OPCODE_LOAD, 0, 0, (Operand){OPERAND_INPUT, REG_XS}); break;
+        case OP_Y: emit_instruction(as, OPCODE_LOAD, 0, 0, (Operand){OPERAND_INPUT, REG_YS_IN}); break;
+
+        case OP_NEG:
+            load_operand(as, in->a);
+            emit_instruction(as, OPCODE_XOR, 0, 0, pool_operand(as, 0x8000000000000000ULL));
+            break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV: {
+            static const uint8_t opcodes[] = {[OP_ADD] = OPCODE_ADD, [OP_SUB] = OPCODE_SUB, [OP_MUL] = OPCODE_MUL,
+                                              [OP_DIV] = OPCODE_DIV};
+            Operand b = second_operand(as, in);
+            emit_instruction(as, opcodes[in->op], 0, 0, b);
+            break;
+        }
+
+        case OP_CALL:
+            load_operand(as, in->a);
+            if (in->func == FUNC_SQRT) emit_instruction(as, OPCODE_SQRT, 0, 0, (Operand){OPERAND_REGISTER, 0});
+            else emit_instruction(as, OPCODE_AND, 0, 0, pool_operand(as, 0x7FFFFFFFFFFFFFFFULL));
+            break;
+
+        case OP_STORE:
+            // imul rcx, rbp, output; add rcx, r14; movupd [rcx + rax], register 0
+            load_operand(as, in->a);
+            as->cached = in->a;
+            EMIT(as, 0x48, 0x69, 0xCD);
+            emit_u32(as, (uint32_t)in->dst);
+            EMIT(as, 0x4C, 0x01, 0xF1);
+            if (as->avx) EMIT(as, 0xC4, 0xE1, 0x7D, OPCODE_STORE, 0x04, 0x01);
+            else EMIT(as, 0x66, 0x0F, OPCODE_STORE, 0x04, 0x01);
+            return;
+
+        default:
+            return;
+    }
+
+    if (needs_store(program, pc)) emit_instruction(as, OPCODE_STORE, 0, 0, (Operand){OPERAND_SLOT, in->dst});
+    as->cached = in->dst;
+}
+
+static void assemble(Assembler *as, const Program *program) {
+    // Save callee-saved registers, keeping the stack aligned for calls
+    EMIT(as, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x48, 0x83, 0xEC, 0x08);
+
+    // mov rbx, rdi; mov r12, rsi; mov r13, rdx; mov r14, rcx; mov rbp, r8; mov r15, r9
+    EMIT(as, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xD5);
+    EMIT(as, 0x49, 0x89, 0xCE, 0x4C, 0x89, 0xC5, 0x4D, 0x89, 0xCF);
+
+    // Runs of packed instructions are fused into one loop over the vectors, kernel calls go in between
+    int loop = -1;
+    for (int pc = 0; pc < program->count; pc++) {
+        const Instruction *in = &program->code[pc];
+
+        if (is_inline(in)) {
+            if (loop < 0) loop = emit_loop_start(as);
+            emit_inline(as, program, pc);
+            continue;
+        }
+
+        // Kernels work in place, so the operand is copied over first
+        if (in->a != in->dst) {
+            if (loop < 0) loop = emit_loop_start(as);
+            load_operand(as, in->a);
+            emit_instruction(as, OPCODE_STORE, 0, 0, (Operand){OPERAND_SLOT, in->dst});
+        }
+
+        if (loop >= 0) emit_loop_end(as, loop);
+        loop = -1;
+        emit_call(as, in);
+    }
+
+    if (loop >= 0) emit_loop_end(as, loop);
+    emit_vzeroupper(as);
+
+    // add rsp, 8; restore registers; ret
+    EMIT(as, 0x48, 0x83, 0xC4, 0x08, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3);
+}
+
+bool jit_compile(Program *program) {
+    Assembler as = {.avx = __builtin_cpu_supports("avx"), .cached = -1};
+    as.lanes = as.avx ? 4 : 2;
+    assemble(&as, program);
+
+    // Constant pool goes after the code, aligned for SSE2 memory operands
+    int pool_start = (as.count + POOL_ENTRY - 1) / POOL_ENTRY * POOL_ENTRY;
+    size_t size = (size_t)pool_start + (size_t)as.pool_count * POOL_ENTRY;
+    for (int i = 0; i < as.fixup_count; i++) {
+        Fixup *fixup = &as.fixups[i];
+        uint32_t displacement = (uint32_t)(pool_start + fixup->entry * POOL_ENTRY - (fixup->position + 4));
+        memcpy(as.bytes + fixup->position, &displacement, sizeof(displacement));
+    }
+
+    // Written while writable, then only executable
+    uint8_t *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool mapped = code != MAP_FAILED;
+    if (mapped) {
+        memcpy(code, as.bytes, as.count);
+        for (int i = 0; i < as.pool_count * POOL_LANES; i++)
+            memcpy(code + pool_start + i * sizeof(double), &as.pool[i / POOL_LANES], sizeof(double));
+
+        if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(code, size);
+            mapped = false;
+        }
+    }
+
+    free(as.bytes);
+    free(as.pool);
+    free(as.fixups);
+    if (!mapped) return false;
+
+    // Object to function pointer conversion is how generated code is called on POSIX
+    memcpy(&program->native, &code, sizeof(code));
+    program->native_size = size;
+    program->native_lanes = as.lanes;
+    return true;
+}
+
+void jit_free(Program *program) {
+    if (program->native != NULL) {
+        void *code;
+        memcpy(&code, &program->native, sizeof(code));
+        munmap(code, program->native_size);
+    }
+
+    program->native = NULL;
+    program->native_size = 0;
+}
+
+#else
+
+bool jit_compile(Program *program) {
+    (void)program;
+    return false;
+}
+
+void jit_free(Program *program) {
+    program->native = NULL;
+    program->native_size = 0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "kernels.h"
+
+/* --------------------------------- Scalar --------------------------------- */
+
+// Scalar kernels go through libm exactly like the tree-walking evaluator
+#define SCALAR_BINARY(name, expr)                                              \
+    static void scalar_##name(double *a, const double *b, int n) {            \
+        for (int i = 0; i < n; i++) a[i] = expr;                               \
+    }
+
+#define SCALAR_CALL(name, func)                                                \
+    static void scalar_##name(double *a, int n) {                             \
+        for (int i = 0; i < n; i++) a[i] = func(a[i]);                         \
+    }
+
+static void scalar_neg(double *a, int n) {
+    for (int i = 0; i < n; i++) a[i] = -a[i];
+}
+
+SCALAR_BINARY(add, a[i] + b[i])
+SCALAR_BINARY(sub, a[i] - b[i])
+SCALAR_BINARY(mul, a[i] * b[i])
+SCALAR_BINARY(div, a[i] / b[i])
+SCALAR_BINARY(pow, pow(a[i], b[i]))
+
+SCALAR_CALL(sin, sin)
+SCALAR_CALL(cos, cos)
+SCALAR_CALL(tan, tan)
+SCALAR_CALL(asin, asin)
+SCALAR_CALL(acos, acos)
+SCALAR_CALL(atan, atan)
+SCALAR_CALL(sinh, sinh)
+SCALAR_CALL(cosh, cosh)
+SCALAR_CALL(tanh, tanh)
+SCALAR_CALL(exp, exp)
+SCALAR_CALL(ln, log)
+SCALAR_CALL(log, log10)
+SCALAR_CALL(sqrt, sqrt)
+SCALAR_CALL(abs, fabs)
+
+static const Kernels scalar_kernels = {
+    .name = "scalar",
+    .neg = scalar_neg,
+    .add = scalar_add,
+    .sub = scalar_sub,
+    .mul = scalar_mul,
+    .div = scalar_div,
+    .pow = scalar_pow,
+    .call = {
+        [FUNC_SIN]  = scalar_sin,
+        [FUNC_COS]  = scalar_cos,
+        [FUNC_TAN]  = scalar_tan,
+        [FUNC_ASIN] = scalar_asin,
+        [FUNC_ACOS] = scalar_acos,
+        [FUNC_ATAN] = scalar_atan,
+        [FUNC_SINH] = scalar_sinh,
+        [FUNC_COSH] = scalar_cosh,
+        [FUNC_TANH] = scalar_tanh,
+        [FUNC_EXP]  = scalar_exp,
+        [FUNC_LN]   = scalar_ln,
+        [FUNC_LOG]  = scalar_log,
+        [FUNC_SQRT] = scalar_sqrt,
+        [FUNC_ABS]  = scalar_abs,
+    },
+};
+
+/* --------------------------------- Vector --------------------------------- */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HAS_VECTOR_KERNELS 1
+
+#include <immintrin.h>
+
+// SSE2 is part of the x86-64 baseline
+#define VEC_WIDTH  2
+#define VEC_SUFFIX sse2
+#define VEC_SQRT   _mm_sqrt_pd
+#include "kernels_vec.inc"
+#undef VEC_WIDTH
+#undef VEC_SUFFIX
+#undef VEC_SQRT
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define VEC_WIDTH  4
+#define VEC_SUFFIX avx2
+#define VEC_SQRT   _mm256_sqrt_pd
+#include "kernels_vec.inc"
+#undef VEC_WIDTH
+#undef VEC_SUFFIX
+#undef VEC_SQRT
+#pragma GCC pop_options
+
+#endif
+
+/* -------------------------------- Dispatch -------------------------------- */
+
+const Kernels *kernels = &scalar_kernels;
+
+const Kernels *kernels_get(KernelLevel level) {
+    switch (level) {
+        case KERNELS_SCALAR: return &scalar_kernels;
+#ifdef HAS_VECTOR_KERNELS
+        case KERNELS_SSE2: return &kernels_sse2;
+        case KERNELS_AVX2: return __builtin_cpu_supports("avx2") ? &kernels_avx2 : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+void kernels_init(bool scalar) {
+    // Pick the widest supported instruction set, falling back to scalar
+    for (int level = scalar ? KERNELS_SCALAR : KERNELS_COUNT - 1; level >= 0; level--) {
+        const Kernels *table = kernels_get((KernelLevel)level);
+        if (table == NULL) continue;
+
+        kernels = table;
+        return;
+    }
+}
@@ -1,39 +1,231 @@
+#include <rlgl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "analysis.h"
+#include "arena.h"
 #include "common.h"
 #include "config.h"
+#include "display.h"
 #include "draw.h"
+#include "field.h"
 #include "gui.h"
+#include "implicit.h"
+#include "kernels.h"
+#include "parametric.h"
+#include "pool.h"
+#include "profiler.h"
+#include "render.h"
+#include "sampler.h"
+#include "series.h"
 #include "update.h"
 
+// Where a plotted entry comes from
+typedef enum {
+    SOURCE_EXPRESSION,
+    SOURCE_CSV,
+    SOURCE_BINARY,
+    SOURCE_PYRAMID,
+} Source;
+
+#ifdef COUNT_ALLOCATIONS
+// Heap allocations of every thread, debug builds report frames that make any once warmed up
+static atomic_long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+#endif
+
+static bool is_window_option(const char *arg) {
+    return strcmp(arg, "--trace") == 0 || strcmp(arg, "--window") == 0 || strcmp(arg, "--data") == 0 ||
+           strcmp(arg, "--data-binary") == 0 || strcmp(arg, "--pyramid") == 0 || strcmp(arg, "--deriv") == 0 ||
+           strcmp(arg, "--quality") == 0 || strcmp(arg, "--follow") == 0 || strcmp(arg, "--scalar") == 0;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--trace csv|json|chrome FILE] [--window N] [--data|--data-binary FILE|-]... [--follow] "
+                    "[--pyramid FILE]... [--deriv] [--quality SAMPLES] [--scalar] [[d/dx]EXPRESSION...]\n", program);
+}
+
 int main(int argc, char **argv) {
     // Check number of args
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s EXPRESSION [EXPRESSION...]\n", argv[0]);
+        print_usage(argv[0]);
+        fprintf(stderr, "       %s --render OUTPUT [--view XMIN,XMAX,YMIN,YMAX] [--size WxH] [--scalar] "
+                        "EXPRESSION...\n", argv[0]);
+        fprintf(stderr, "       %s --manifest FILE [--jobs N] [--scalar]\n", argv[0]);
         return 1;
     }
 
-    // Set up parser and environment
+    SetTraceLogCallback(custom_trace_log);
+
+    // Pick evaluation kernels for this CPU before either mode reads its options, scalar ones if asked for
+    bool scalar = false;
+    for (int i = 1; i < argc; i++) scalar |= strcmp(argv[i], "--scalar") == 0;
+    kernels_init(scalar);
+    TraceLog(LOG_INFO, "Using %s evaluation kernels", kernels->name);
+
+    // Other options select the headless renderer, which never opens a window
+    if (strncmp(argv[1], "--", 2) == 0 && !is_window_option(argv[1])) return render_main(argc, argv);
+
+    // Everything living as long as the window comes from one arena, freed at exit
+    arena_init(&persistent_arena, ARENA_BLOCK_SIZE);
+    arena_init(&frame_arena, ARENA_FRAME_SIZE);
+
+    // Window options may come anywhere, every other argument is an expression
+    ProfileFormat trace_format = PROFILE_CSV;
+    const char *trace_path = NULL;
+    long long window = SERIES_WINDOW;
+    bool derivatives = false;
+    bool follow = false;
+    float quality = QUALITY_DEFAULT;
+    char **texts = arena_alloc(&persistent_arena, sizeof(char *) * argc);
+    Source *sources = arena_alloc(&persistent_arena, sizeof(Source) * argc);
+    int count = 0;
+    bool valid = true;
+
+    for (int i = 1; i < argc && valid; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            valid = i + 2 < argc && profiler_format(argv[i + 1], &trace_format);
+            if (valid) trace_path = argv[i + 2];
+            i += 2;
+        } else if (strcmp(argv[i], "--window") == 0) {
+            valid = i + 1 < argc && (window = atoll(argv[i + 1])) > 0;
+            i++;
+        } else if (strcmp(argv[i], "--deriv") == 0) {
+            derivatives = true;
+        } else if (strcmp(argv[i], "--follow") == 0) {
+            follow = true;
+        } else if (strcmp(argv[i], "--scalar") == 0) {
+            // Already applied to the kernels
+        } else if (strcmp(argv[i], "--quality") == 0) {
+            valid = i + 1 < argc && (quality = (float)atof(argv[i + 1])) > 0.0f;
+            i++;
+        } else if (strcmp(argv[i], "--data") == 0 || strcmp(argv[i], "--data-binary") == 0 ||
+                   strcmp(argv[i], "--pyramid") == 0) {
+            valid = i + 1 < argc;
+            if (valid) {
+                if (strcmp(argv[i], "--data") == 0) sources[count] = SOURCE_CSV;
+                else if (strcmp(argv[i], "--data-binary") == 0) sources[count] = SOURCE_BINARY;
+                else sources[count] = SOURCE_PYRAMID;
+                texts[count++] = argv[i + 1];
+            }
+            i++;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            valid = false;
+        } else {
+            sources[count] = SOURCE_EXPRESSION;
+            texts[count++] = argv[i];
+        }
+    }
+
+    if (!valid || count == 0) {
+        print_usage(argv[0]);
+        arena_free(&persistent_arena);
+        return 1;
+    }
+
+    // Every function is followed by its derivative in the legend, equations are relations and have none
+    if (derivatives) {
+        char **all_texts = arena_alloc(&persistent_arena, sizeof(char *) * 2 * count);
+        Source *all_sources = arena_alloc(&persistent_arena, sizeof(Source) * 2 * count);
+        int all = 0;
+
+        for (int i = 0; i < count; i++) {
+            all_texts[all] = texts[i];
+            all_sources[all++] = sources[i];
+            if (sources[i] != SOURCE_EXPRESSION || strchr(texts[i], '=') != NULL) continue;
+
+            size_t length = strlen(EXPRESSION_DERIVATIVE_PREFIX) + strlen(texts[i]) + 2;
+            char *derivative = arena_alloc(&persistent_arena, length);
+            sprintf(derivative, "%s %s", EXPRESSION_DERIVATIVE_PREFIX, texts[i]);
+            all_texts[all] = derivative;
+            all_sources[all++] = SOURCE_EXPRESSION;
+        }
+
+        texts = all_texts;
+        sources = all_sources;
+        count = all;
+    }
+
+    // Set up parser and the workers that sample expressions
     Parser parser = parser_init();
-    SymbolTable symbol_table = symbol_table_init();
-    symbol_table_set(&symbol_table, "x", 1, 0.0);
+    pool_init(POOL_THREADS, expression_thread_free);
+    TraceLog(LOG_INFO, "Sampling on %d worker threads", pool_thread_count());
 
-    // Allocate array of parsed expressions and color pool
-    ParsedExpression *parsed = malloc(sizeof(ParsedExpression) * (argc - 1));
-    Color colors[] = {COLOR_BLUE, COLOR_CYAN, COLOR_GREEN, COLOR_RED, COLOR_YELLOW, COLOR_PURPLE};
+    // Allocate array of parsed expressions and color pool, with room for expressions added from the window
+    int capacity = count + LEGEND_EXTRA_SLOTS;
+    ParsedExpression *parsed = arena_calloc(&persistent_arena, capacity, sizeof(ParsedExpression));
+    Color colors[] = COLOR_POOL;
 
     // Store parsed expressions
-    for (int i = 1; i < argc; i++) {
-        Node *root = parser_parse(&parser, argv[i]);
-        Color color = colors[(i - 1) % (sizeof(colors) / sizeof(Color))];
-        parsed[i - 1] = (ParsedExpression){argv[i], root, color, true};
+    for (int i = 0; i < count; i++) {
+        Color color = colors[i % (sizeof(colors) / sizeof(Color))];
+        parsed[i] = (ParsedExpression){.text = texts[i], .color = color, .visible = true};
+
+        // Pyramid files are mapped, not read
+        if (sources[i] == SOURCE_PYRAMID) {
+            Pyramid *pyramid = malloc(sizeof(Pyramid));
+            if (pyramid_open(pyramid, texts[i])) parsed[i].pyramid = pyramid;
+            else free(pyramid);
+        }
+
+        // Data series start streaming right away, in the legend under their path
+        if (sources[i] == SOURCE_CSV || sources[i] == SOURCE_BINARY) {
+            DataSeries *series = malloc(sizeof(DataSeries));
+            if (strcmp(texts[i], "-") == 0) parsed[i].text = "stdin";
+
+            if (series_open(series, texts[i], sources[i] == SOURCE_BINARY, follow, window)) parsed[i].series = series;
+            else free(series);
+        }
+
+        if (sources[i] != SOURCE_EXPRESSION) {
+            if (!expression_plottable(&parsed[i])) snprintf(parsed[i].error, EXPRESSION_ERROR_LENGTH, "Unable to open");
+            continue;
+        }
+
+        // Expressions that can't be plotted stay in the legend with their error, to be fixed from the window
+        if (!expression_parse(&parsed[i], &parser, texts[i]))
+            TraceLog(LOG_WARNING, "Unable to plot '%s': %s", texts[i], parsed[i].error);
     }
 
-    // Initialization
-    SetTraceLogCallback(custom_trace_log);
+    Legend legend;
+    legend_init(&legend, parsed, count, capacity, &parser);
+
+    // Merge visible expressions so their common subexpressions are evaluated once per column
+    ExpressionGroup group;
+    expression_group_init(&group);
+    expression_group_build(&group, parsed, count);
+
+    // Timings are only recorded while the overlay is shown or a trace is written
+    profiler_init(parsed, capacity, trace_format, trace_path);
+
+    // Roots, extrema and intersections are searched for on the worker pool once curves settle
+    analysis_init(parsed, capacity);
+
+    // Initialization, everything is laid out in screen coordinates and drawn at the framebuffer's resolution
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_WINDOW_HIGHDPI);
     InitWindow(WIDTH, HEIGHT, "Graphing Calculator");
     SetTargetFPS(FPS);
+    display_init(quality);
 
     // Set resources directory and app icon
     char *resource_dir = "resources";
@@ -49,47 +241,174 @@ int main(int argc, char **argv) {
     Camera2D camera = {0};
     camera_reset(&camera);
 
+    // Everything but the coords display is drawn into a cached frame, redrawn only when it changes
+    RenderTexture2D frame = display_load_texture(display.width, display.height);
+    GridCache grid;
+    grid_cache_load(&grid);
+    bool dirty = true;
+
     // Main loop
+#ifdef COUNT_ALLOCATIONS
+    long frames = 0;
+#endif
     while (!WindowShouldClose()) {
+        profile_frame_begin();
+        double frame_start = GetTime();
+#ifdef COUNT_ALLOCATIONS
+        long allocated = allocations;
+#endif
+
+        // Scratch memory of the previous frame is no longer referenced
+        arena_reset(&frame_arena);
+
         /* --------------------------------- Update --------------------------------- */
-        pan(&camera);
-        zoom(&camera);
-        shortcuts(&camera);
+        profile_begin(PROFILE_UPDATE);
+
+        // Textures covering the window follow its size
+        if (resize(&camera)) {
+            UnloadRenderTexture(frame);
+            frame = display_load_texture(display.width, display.height);
+            grid_cache_unload(&grid);
+            grid_cache_load(&grid);
+            dirty = true;
+        }
+
+        if (pan(&camera)) dirty = true;
+        if (zoom(&camera)) dirty = true;
+        if (legend.editing < 0 && shortcuts(&camera)) dirty = true; // Keys are typed into the legend while editing
+        if (camera_rebase(&camera)) dirty = true; // Keeps world coordinates small enough for floats when zoomed in
+
+        // Streamed points are drawn as they arrive
+        bool streaming = false;
+        for (int i = 0; i < legend.count; i++) {
+            if (parsed[i].series == NULL) continue;
+            if (parsed[i].visible && series_pending(parsed[i].series)) dirty = true;
+            if (series_live(parsed[i].series)) streaming = true;
+        }
 
-        // Increase/Decrease adaptive spacing when zooming out/in
-        float dynamic_spacing = GRID_INITIAL_SPACING;
-        while (dynamic_spacing * camera.zoom < GRID_MIN_SPACING) dynamic_spacing *= 2.0f;
-        while (dynamic_spacing * camera.zoom > GRID_MAX_SPACING) dynamic_spacing /= 2.0f;
+        // Edits only start the edited curve over, the group is built again once they're finished
+        LegendChange change = legend_update(&legend);
+        if (change == LEGEND_REGROUP) expression_group_build(&group, parsed, legend.count);
+        if (change != LEGEND_UNCHANGED) dirty = true;
+
+        float dynamic_spacing = grid_spacing(camera.zoom);
+        profile_end(PROFILE_UPDATE);
 
         /* ---------------------------------- Draw ---------------------------------- */
-        BeginDrawing();
-        ClearBackground(COLOR_BLACK);
+        bool drawn = dirty;
+        if (dirty) {
+            profile_begin(PROFILE_GRID);
+            grid_cache_update(&grid, &camera, dynamic_spacing);
+
+            display_begin_texture(frame);
+            ClearBackground(COLOR_BLACK);
+
+            // Fields are part of the background, under the grid
+            BeginMode2D(camera);
+            for (int i = 0; i < legend.count; i++) {
+                if (parsed[i].field == NULL || parsed[i].root == NULL || !parsed[i].visible) continue;
+
+                profile_curve_begin(i);
+                plot_field(&camera, &parsed[i]);
+                profile_curve_end(i);
+            }
+            EndMode2D();
+
+            draw_grid(&grid, &camera);
+            profile_end(PROFILE_GRID);
+
+            // World space
+            profile_begin(PROFILE_CURVES);
+            BeginMode2D(camera);
+
+            for (int i = 0; i < legend.count; i++) {
+                if (!expression_plottable(&parsed[i]) || !parsed[i].visible || parsed[i].field != NULL) continue;
+
+                profile_curve_begin(i);
+                if (parsed[i].series != NULL) plot_series(&camera, &parsed[i]);
+                else if (parsed[i].pyramid != NULL) plot_pyramid(&camera, &parsed[i]);
+                else if (parsed[i].implicit != NULL) plot_relation(&camera, &parsed[i]);
+                else if (parsed[i].parametric != NULL) plot_curve(&camera, &parsed[i]);
+                else plot_function(&camera, &parsed[i]);
+                profile_curve_end(i);
+            }
 
-        // World space
-        BeginMode2D(camera);
-        draw_grid(&camera, dynamic_spacing);
+            EndMode2D();
+            profile_end(PROFILE_CURVES);
 
-        for (int i = 0; i < argc - 1; i++) {
-            if (parsed[i].root == NULL) continue;
-            if (parsed[i].visible) plot_function(&camera, parsed[i].root, &symbol_table, parsed[i].color);
+            // Screen space
+            profile_begin(PROFILE_LABELS);
+            draw_grid_labels(&grid, &camera);
+            profile_end(PROFILE_LABELS);
+
+            profile_begin(PROFILE_LEGEND);
+            display_legend(&legend);
+            EndTextureMode();
+            profile_end(PROFILE_LEGEND);
+
+            // Keep redrawing while samples are on their way
+            dirty = false;
+            for (int i = 0; i < legend.count; i++) {
+                if (parsed[i].root == NULL || !parsed[i].visible) continue;
+
+                ParsedExpression *expression = &parsed[i];
+                bool pending;
+                if (expression->field != NULL) pending = field_pending(expression);
+                else if (expression->implicit != NULL) pending = implicit_pending(expression);
+                else if (expression->parametric != NULL) pending = parametric_pending(expression);
+                else pending = sampler_pending(expression);
+                if (pending) dirty = true;
+            }
         }
 
-        EndMode2D();
+        BeginDrawing();
+
+        // Copy cached frame as is, it already holds blended colors
+        rlDrawRenderBatchActive();
+        rlDisableColorBlend();
+        display_draw_texture(frame, (Vector2){0, 0});
+        rlDrawRenderBatchActive();
+        rlEnableColorBlend();
+
+        bool hovering = legend_hovered(&legend);
+        bool tooltip = draw_features(&camera, hovering);
+        display_coords(&camera, hovering || tooltip);
+        profiler_draw_overlay();
 
-        // Screen space
-        draw_grid_labels(&camera, dynamic_spacing);
+        // Frames running over budget lower the sampling quality, which takes another pass
+        if (drawn && display_adapt(GetTime() - frame_start)) dirty = true;
 
-        bool hovering = display_legend(parsed, argc - 1);
-        display_coords(&camera, hovering);
+        // Sleep until the next input event while nothing is left to redraw, stream in or analyze
+        if (dirty || streaming || analysis_pending()) DisableEventWaiting();
+        else EnableEventWaiting();
 
+        // Includes the buffer swap and waiting for the next frame or input event
+        profile_begin(PROFILE_END_DRAWING);
         EndDrawing();
+        profile_end(PROFILE_END_DRAWING);
+
+        profile_frame_end(drawn);
+
+#ifdef COUNT_ALLOCATIONS
+        allocated = allocations - allocated;
+        if (++frames > ARENA_WARMUP_FRAMES && allocated > 0)
+            TraceLog(LOG_WARNING, "Frame %ld made %ld heap allocations", frames, allocated);
+#endif
     }
 
-    // Cleanup
+    // Cleanup, curve meshes live on the GPU so they go before the window
+    analysis_free();
+    for (int i = 0; i < legend.count; i++) expression_free(&parsed[i]);
+    expression_group_free(&group);
+    profiler_free();
+    UnloadRenderTexture(frame);
+    grid_cache_unload(&grid);
     CloseWindow();
-    symbol_table_free(&symbol_table);
+    pool_free();
+    expression_thread_free();
     parser_free(&parser);
-    free(parsed);
+    arena_free(&frame_arena);
+    arena_free(&persistent_arena);
 
     return 0;
 }
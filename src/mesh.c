@@ -0,0 +1,187 @@
+#include <math.h>
+#include <raymath.h>
+#include <rlgl.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "common.h"
+#include "mesh.h"
+
+// Vertices the 16-bit element buffer can address, indices 0 to 65535
+#define MESH_MAX_VERTICES 65536
+
+static void push_vertex(CurveMesh *mesh, Vector2 v) {
+    // Grow vertex array if needed
+    if (mesh->vertex_count == mesh->vertex_capacity) {
+        mesh->vertex_capacity = mesh->vertex_capacity == 0 ? 1024 : mesh->vertex_capacity * 2;
+        mesh->vertices = realloc(mesh->vertices, sizeof(float) * 2 * mesh->vertex_capacity);
+    }
+
+    mesh->vertices[2 * mesh->vertex_count] = v.x;
+    mesh->vertices[2 * mesh->vertex_count + 1] = v.y;
+    mesh->vertex_count++;
+}
+
+static void push_index(CurveMesh *mesh, int index) {
+    // Grow index array if needed
+    if (mesh->index_count == mesh->index_capacity) {
+        mesh->index_capacity = mesh->index_capacity == 0 ? 2048 : mesh->index_capacity * 2;
+        mesh->indices = realloc(mesh->indices, sizeof(unsigned short) * mesh->index_capacity);
+    }
+
+    mesh->indices[mesh->index_count++] = (unsigned short)index;
+}
+
+static void push_pair(CurveMesh *mesh, Vector2 center, Vector2 offset, bool connect) {
+    // Add both sides of the line and the quad joining them to the previous pair
+    int base = mesh->vertex_count;
+    push_vertex(mesh, Vector2Add(center, offset));
+    push_vertex(mesh, Vector2Subtract(center, offset));
+    if (!connect) return;
+
+    push_index(mesh, base - 2);
+    push_index(mesh, base - 1);
+    push_index(mesh, base);
+    push_index(mesh, base - 1);
+    push_index(mesh, base + 1);
+    push_index(mesh, base);
+}
+
+static Vector2 segment_normal(Vector2 a, Vector2 b) {
+    Vector2 d = Vector2Normalize(Vector2Subtract(b, a));
+    return (Vector2){-d.y, d.x};
+}
+
+static void build_run(CurveMesh *mesh, const Vector2 *points, int count, float half) {
+    if (count < 2) return;
+    mesh->segment_count += count - 1;
+
+    // Square off both ends and join the segments in between
+    push_pair(mesh, points[0], Vector2Scale(segment_normal(points[0], points[1]), half), false);
+
+    for (int i = 1; i < count - 1; i++) {
+        Vector2 n0 = segment_normal(points[i - 1], points[i]);
+        Vector2 n1 = segment_normal(points[i], points[i + 1]);
+        Vector2 miter = Vector2Normalize(Vector2Add(n0, n1));
+        float cosine = Vector2DotProduct(miter, n0);
+
+        // Sharp turns get a bevel, which the quad between two pairs on the same point covers
+        if (cosine * LINE_MITER_LIMIT < 1.0f) {
+            push_pair(mesh, points[i], Vector2Scale(n0, half), true);
+            push_pair(mesh, points[i], Vector2Scale(n1, half), true);
+        } else {
+            push_pair(mesh, points[i], Vector2Scale(miter, half / cosine), true);
+        }
+    }
+
+    push_pair(mesh, points[count - 1], Vector2Scale(segment_normal(points[count - 2], points[count - 1]), half), true);
+}
+
+bool curve_mesh_build(CurveMesh *mesh, const Vector2 *points, int count, float thickness) {
+    mesh->vertex_count = 0;
+    mesh->index_count = 0;
+    mesh->segment_count = 0;
+    mesh->uploaded = false;
+
+    // Split points into runs, skipping repeated points that have no direction. Compared exactly, since points
+    // less than a pixel apart are tiny in world space when zoomed in
+    Vector2 *run = arena_alloc(&frame_arena, sizeof(Vector2) * count);
+
+    int run_count = 0;
+    for (int i = 0; i <= count; i++) {
+        bool end = i == count || isnan(points[i].x) || isnan(points[i].y);
+        if (!end) {
+            bool repeated = run_count > 0 && run[run_count - 1].x == points[i].x && run[run_count - 1].y == points[i].y;
+            if (!repeated) run[run_count++] = points[i];
+            continue;
+        }
+
+        build_run(mesh, run, run_count, thickness / 2.0f);
+        run_count = 0;
+    }
+
+    if (mesh->vertex_count > MESH_MAX_VERTICES) {
+        mesh->vertex_count = 0;
+        mesh->index_count = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void curve_mesh_upload(CurveMesh *mesh) {
+    int vertex_size = sizeof(float) * 2 * mesh->vertex_count;
+    int index_size = sizeof(unsigned short) * mesh->index_count;
+
+    // Recreate buffers only when they are too small
+    if (mesh->vao == 0 || mesh->vertex_count > mesh->gpu_vertex_capacity || mesh->index_count > mesh->gpu_index_capacity) {
+        if (mesh->vao != 0) {
+            rlUnloadVertexArray(mesh->vao);
+            rlUnloadVertexBuffer(mesh->vbo);
+            rlUnloadVertexBuffer(mesh->ebo);
+        }
+
+        mesh->gpu_vertex_capacity = mesh->vertex_capacity;
+        mesh->gpu_index_capacity = mesh->index_capacity;
+
+        mesh->vao = rlLoadVertexArray();
+        rlEnableVertexArray(mesh->vao);
+        mesh->vbo = rlLoadVertexBuffer(NULL, sizeof(float) * 2 * mesh->gpu_vertex_capacity, true);
+        rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+        rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+        mesh->ebo = rlLoadVertexBufferElement(NULL, sizeof(unsigned short) * mesh->gpu_index_capacity, true);
+        rlDisableVertexArray();
+    }
+
+    if (vertex_size > 0) rlUpdateVertexBuffer(mesh->vbo, mesh->vertices, vertex_size, 0);
+    if (index_size > 0) rlUpdateVertexBufferElements(mesh->ebo, mesh->indices, index_size, 0);
+    mesh->uploaded = true;
+}
+
+void curve_mesh_draw(CurveMesh *mesh, Color color) {
+    if (!mesh->uploaded || mesh->index_count == 0) return;
+
+    // Flush immediate mode geometry so drawing order is kept
+    rlDrawRenderBatchActive();
+
+    // Draw with the default shader, its white texture and a constant vertex color
+    int *locs = rlGetShaderLocsDefault();
+    float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float tint[4] = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f};
+    Matrix mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+
+    rlEnableShader(rlGetShaderIdDefault());
+    rlSetUniformMatrix(locs[SHADER_LOC_MATRIX_MVP], mvp);
+    rlSetUniform(locs[SHADER_LOC_COLOR_DIFFUSE], white, RL_SHADER_UNIFORM_VEC4, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(rlGetTextureIdDefault());
+
+    // Bind buffers by hand where vertex arrays aren't supported
+    if (!rlEnableVertexArray(mesh->vao)) {
+        rlEnableVertexBuffer(mesh->vbo);
+        rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT, false, 0, 0);
+        rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+        rlEnableVertexBufferElement(mesh->ebo);
+    }
+
+    rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, tint, RL_SHADER_ATTRIB_VEC4, 4);
+    rlDrawVertexArrayElements(0, mesh->index_count, 0);
+
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    rlDisableVertexBufferElement();
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+void curve_mesh_unload(CurveMesh *mesh) {
+    if (mesh->vao != 0) {
+        rlUnloadVertexArray(mesh->vao);
+        rlUnloadVertexBuffer(mesh->vbo);
+        rlUnloadVertexBuffer(mesh->ebo);
+    }
+
+    free(mesh->vertices);
+    free(mesh->indices);
+    *mesh = (CurveMesh){0};
+}
@@ -0,0 +1,481 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parametric.h"
+#include "pool.h"
+
+// Region of the plane in math units
+typedef struct {
+    double min_x, max_x;
+    double min_y, max_y;
+} Bounds;
+
+// Limits of one sweep of the parameter, for the view it's sampled for
+typedef struct {
+    Bounds kept;      // Pieces are sampled a little beyond the view
+    Bounds far;       // And clipped a screen beyond it
+    double tolerance; // Math units
+    double spacing;   // Between seeds
+    double min_step;  // Shortest interval
+} Sweep;
+
+// What becomes of an interval between two samples
+typedef enum {
+    INTERVAL_DRAWN,  // Close enough to the curve
+    INTERVAL_HIDDEN, // Outside the view, a hole in the domain or a discontinuity
+    INTERVAL_SPLIT,  // Too far from the curve, split into pieces
+} IntervalState;
+
+/* -------------------------------- Rewriting ------------------------------- */
+
+static bool letter(char c) {
+    // Bytes of multibyte characters like θ are letters
+    return isalpha((unsigned char)c) || c == '_' || (unsigned char)c >= 0x80;
+}
+
+static bool digit(char c) {
+    return isdigit((unsigned char)c) || c == '.';
+}
+
+static bool word_equals(const char *word, int length, const char *other) {
+    return (int)strlen(other) == length && strncmp(word, other, length) == 0;
+}
+
+static bool is_parameter(const char *word, int length, ParametricKind kind) {
+    if (kind == PARAMETRIC_XY) return word_equals(word, length, "t");
+    return word_equals(word, length, "θ") || word_equals(word, length, "theta");
+}
+
+static const char *skip_number(const char *c, const char *end) {
+    while (c < end && digit(*c)) c++;
+
+    // An exponent needs its digits, otherwise the letter starts a name as in `2exp(t)`
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        const char *exponent = c + 1;
+        if (exponent < end && (*exponent == '+' || *exponent == '-')) exponent++;
+        if (exponent < end && isdigit((unsigned char)*exponent)) {
+            c = exponent;
+            while (c < end && isdigit((unsigned char)*c)) c++;
+        }
+    }
+
+    return c;
+}
+
+static char *rewrite_component(const char *from, const char *to, ParametricKind kind, char *out, char *error) {
+    // The parameter is read as x, multiplied explicitly after a number as in `3t`. The variables of the plane
+    // would be taken for the parameter, so they're refused
+    bool number = false, empty = true;
+    for (const char *c = from; c < to;) {
+        const char *start = c;
+        if (digit(*c)) {
+            c = skip_number(c, to);
+            memcpy(out, start, c - start);
+            out += c - start;
+            number = true;
+            empty = false;
+            continue;
+        }
+
+        if (letter(*c)) {
+            while (c < to && (letter(*c) || isdigit((unsigned char)*c))) c++;
+            int length = (int)(c - start);
+
+            if (word_equals(start, length, "x") || word_equals(start, length, "y")) {
+                if (kind == PARAMETRIC_XY) snprintf(error, EXPRESSION_ERROR_LENGTH, "Parametric curves only use t");
+                else snprintf(error, EXPRESSION_ERROR_LENGTH, "Polar curves only use theta");
+                return NULL;
+            }
+
+            if (!is_parameter(start, length, kind)) {
+                memcpy(out, start, length);
+                out += length;
+            } else {
+                if (number) *out++ = '*';
+                *out++ = 'x';
+            }
+
+            number = false;
+            empty = false;
+            continue;
+        }
+
+        if (*c != ' ') {
+            number = false;
+            empty = false;
+        }
+        *out++ = *c++;
+    }
+
+    if (empty) {
+        snprintf(error, EXPRESSION_ERROR_LENGTH, "Empty expression");
+        return NULL;
+    }
+
+    *out++ = '\0';
+    return out;
+}
+
+static const char *strip_polar(const char *text) {
+    // A single equals sign after the r, like the prefix of fields
+    while (*text == ' ') text++;
+    if (*text++ != 'r') return NULL;
+    while (*text == ' ') text++;
+    if (*text != '=' || text[1] == '=') return NULL;
+
+    return text + 1;
+}
+
+static bool split_pair(const char *text, const char **open, const char **comma, const char **close) {
+    // The whole text is in parentheses, with a single comma outside any nested ones
+    while (*text == ' ') text++;
+    if (*text != '(') return false;
+
+    *open = text;
+    *comma = NULL;
+    int depth = 0;
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '(') depth++;
+        if (*c == ')' && --depth == 0) {
+            *close = c;
+            return *comma != NULL && c[1 + strspn(c + 1, " ")] == '\0';
+        }
+
+        if (*c == ',' && depth == 1) {
+            if (*comma != NULL) return false;
+            *comma = c;
+        }
+    }
+
+    return false;
+}
+
+char *parametric_rewrite(const char *text, ParametricKind *kind, char *error) {
+    const char *radius = strip_polar(text);
+    const char *open, *comma, *close;
+    if (radius != NULL) *kind = PARAMETRIC_POLAR;
+    else if (split_pair(text, &open, &comma, &close)) *kind = PARAMETRIC_XY;
+    else return NULL;
+
+    // Every character takes at most two, `t` becoming `*x`
+    char *source = malloc(2 * strlen(text) + 2);
+    char *end;
+    if (*kind == PARAMETRIC_POLAR) {
+        end = rewrite_component(radius, radius + strlen(radius), *kind, source, error);
+    } else {
+        end = rewrite_component(open + 1, comma, *kind, source, error);
+        if (end != NULL) end = rewrite_component(comma + 1, close, *kind, end, error);
+    }
+
+    if (end == NULL) {
+        free(source);
+        return NULL;
+    }
+
+    return source;
+}
+
+void parametric_init(ParametricCurve *curve, ParametricKind kind, Node *y_root) {
+    *curve = (ParametricCurve){.kind = kind, .y_root = y_root};
+}
+
+/* -------------------------------- Sampling -------------------------------- */
+
+static void reserve_samples(ParametricCurve *curve, int count) {
+    // Both arrays of samples have the same capacity, passes swap them
+    if (count <= curve->capacity) return;
+
+    curve->capacity = count * 2;
+    curve->samples = realloc(curve->samples, sizeof(CurveSample) * curve->capacity);
+    curve->spare_samples = realloc(curve->spare_samples, sizeof(CurveSample) * curve->capacity);
+}
+
+static void reserve_pending(ParametricCurve *curve, int count) {
+    if (count <= curve->pending_capacity) return;
+
+    curve->pending_capacity = count * 2;
+    curve->ts = realloc(curve->ts, sizeof(double) * curve->pending_capacity);
+    curve->slots = realloc(curve->slots, sizeof(int) * curve->pending_capacity);
+}
+
+static bool finite_point(const CurveSample *sample) {
+    return isfinite(sample->x) && isfinite(sample->y);
+}
+
+static void estimate_tangents(ParametricCurve *curve) {
+    // Without derivatives, tangents are taken from the neighbors of each sample
+    for (int i = 0; i < curve->count; i++) {
+        const CurveSample *before = &curve->samples[i > 0 ? i - 1 : i];
+        const CurveSample *after = &curve->samples[i < curve->count - 1 ? i + 1 : i];
+        double dt = after->t - before->t;
+
+        curve->samples[i].dx = (after->x - before->x) / dt;
+        curve->samples[i].dy = (after->y - before->y) / dt;
+    }
+}
+
+static void tangent(const CurveSample *sample, const CurveSample *a, const CurveSample *b, double *dx, double *dy) {
+    // Tangents running off to infinity and unknown ones follow the chord instead
+    *dx = sample->dx;
+    *dy = sample->dy;
+    if (isfinite(*dx) && isfinite(*dy)) return;
+
+    *dx = (b->x - a->x) / (b->t - a->t);
+    *dy = (b->y - a->y) / (b->t - a->t);
+}
+
+static double segment_distance(double px, double py, const CurveSample *a, const CurveSample *b) {
+    double dx = b->x - a->x, dy = b->y - a->y;
+    double length = dx * dx + dy * dy;
+    double s = length > 0.0 ? ((px - a->x) * dx + (py - a->y) * dy) / length : 0.0;
+    s = fmin(fmax(s, 0.0), 1.0);
+
+    return hypot(px - (a->x + s * dx), py - (a->y + s * dy));
+}
+
+static bool outside(const Bounds *bounds, const CurveSample *sample) {
+    return sample->x < bounds->min_x || sample->x > bounds->max_x || sample->y < bounds->min_y ||
+           sample->y > bounds->max_y;
+}
+
+static IntervalState classify(const CurveSample *a, const CurveSample *b, const Sweep *sweep, int *pieces) {
+    const Bounds *view = &sweep->kept;
+    double tolerance = sweep->tolerance;
+    double h = b->t - a->t;
+    bool splittable = h / 2.0 >= sweep->min_step;
+    *pieces = 2;
+
+    // Edges of the domain in view are located by halving towards them, until the end on the curve barely moves
+    bool finite_a = finite_point(a), finite_b = finite_point(b);
+    if (!finite_a && !finite_b) return INTERVAL_HIDDEN;
+    if (!finite_a || !finite_b) {
+        const CurveSample *end = finite_a ? a : b;
+        double reach = hypot(end->dx, end->dy) * h;
+        double outside = fmax(fmax(view->min_x - end->x, end->x - view->max_x),
+                              fmax(view->min_y - end->y, end->y - view->max_y));
+        if (outside > reach) return INTERVAL_HIDDEN;
+
+        return splittable && !(reach <= tolerance) ? INTERVAL_SPLIT : INTERVAL_HIDDEN;
+    }
+
+    // Control points of the cubic leaving each sample along its tangent, the curve stays within their hull
+    double dx0, dy0, dx1, dy1;
+    tangent(a, a, b, &dx0, &dy0);
+    tangent(b, a, b, &dx1, &dy1);
+    double c1x = a->x + dx0 * h / 3.0, c1y = a->y + dy0 * h / 3.0;
+    double c2x = b->x - dx1 * h / 3.0, c2y = b->y - dy1 * h / 3.0;
+
+    // Pieces whose hull misses the view are dropped without being split
+    double min_x = fmin(fmin(a->x, b->x), fmin(c1x, c2x)), max_x = fmax(fmax(a->x, b->x), fmax(c1x, c2x));
+    double min_y = fmin(fmin(a->y, b->y), fmin(c1y, c2y)), max_y = fmax(fmax(a->y, b->y), fmax(c1y, c2y));
+    if (max_x < view->min_x || min_x > view->max_x || max_y < view->min_y || min_y > view->max_y)
+        return INTERVAL_HIDDEN;
+
+    // Straight runs have their control points on the chord, tight bends far from it. The cubic strays at most
+    // three quarters as far as they do
+    double deviation = 0.75 * fmax(segment_distance(c1x, c1y, a, b), segment_distance(c2x, c2y, a, b));
+    if (deviation <= tolerance) return INTERVAL_DRAWN;
+    if (!splittable) return INTERVAL_HIDDEN;
+
+    // Both ends heading away from the chord look like a pole, which is halved until it's narrowed down from the
+    // seeds. Then there's nothing to see between its ends if both are off the view
+    double chord_x = b->x - a->x, chord_y = b->y - a->y;
+    if (dx0 * chord_x + dy0 * chord_y < 0.0 && dx1 * chord_x + dy1 * chord_y < 0.0) {
+        bool narrowed = h < sweep->spacing / 2.0;
+        return narrowed && outside(view, a) && outside(view, b) ? INTERVAL_HIDDEN : INTERVAL_SPLIT;
+    }
+
+    // Deviation shrinks with the square of the step, so a few passes reach the tolerance
+    double wanted = ceil(sqrt(deviation / tolerance));
+    double most = fmin(PARAMETRIC_MAX_SPLIT, floor(h / sweep->min_step));
+    *pieces = (int)fmax(2.0, fmin(wanted, most));
+    return INTERVAL_SPLIT;
+}
+
+static void push_pending(ParametricCurve *curve, CurveSample *samples, int *count, double t) {
+    // Sample is filled in once its parameter value is evaluated with the rest of the pass
+    curve->ts[curve->pending] = t;
+    curve->slots[curve->pending++] = *count;
+    samples[(*count)++] = (CurveSample){t, NAN, NAN, NAN, NAN};
+}
+
+static int evaluate_pending(ParsedExpression *expression) {
+    ParametricCurve *curve = expression->parametric;
+    CurveSample values[PROGRAM_BATCH];
+
+    for (int start = 0; start < curve->pending; start += PROGRAM_BATCH) {
+        int n = curve->pending - start < PROGRAM_BATCH ? curve->pending - start : PROGRAM_BATCH;
+        expression_evaluate_curve(expression, curve->ts + start, values, n);
+        for (int i = 0; i < n; i++) curve->samples[curve->slots[start + i]] = values[i];
+    }
+
+    int evaluated = curve->pending;
+    curve->pending = 0;
+    return evaluated;
+}
+
+static int split_pass(ParsedExpression *expression, const Sweep *sweep, int budget) {
+    ParametricCurve *curve = expression->parametric;
+
+    // Worst case every interval is split into the most pieces
+    int most = (curve->count - 1) * PARAMETRIC_MAX_SPLIT + 1;
+    reserve_samples(curve, most);
+    reserve_pending(curve, most);
+
+    // Samples are copied to the spare array in order, with the ones to evaluate in between
+    CurveSample *next = curve->spare_samples;
+    int count = 0;
+    for (int i = 0; i < curve->count; i++) {
+        const CurveSample *a = &curve->samples[i];
+        next[count++] = *a;
+        if (i == curve->count - 1) break;
+
+        int pieces;
+        const CurveSample *b = &curve->samples[i + 1];
+        if (classify(a, b, sweep, &pieces) != INTERVAL_SPLIT) continue;
+        if (curve->pending + pieces - 1 > budget) continue;
+
+        for (int j = 1; j < pieces; j++) push_pending(curve, next, &count, a->t + (b->t - a->t) * j / pieces);
+    }
+
+    curve->spare_samples = curve->samples;
+    curve->samples = next;
+    curve->count = count;
+
+    return evaluate_pending(expression);
+}
+
+static bool clip_segment(SamplePoint *p0, SamplePoint *p1, const Bounds *bounds) {
+    // Clip to the vertical band, then to the horizontal one with the axes swapped
+    if (!sample_clip_segment(p0, p1, bounds->min_y, bounds->max_y)) return false;
+
+    SamplePoint q0 = {p0->y, p0->x}, q1 = {p1->y, p1->x};
+    if (!sample_clip_segment(&q0, &q1, bounds->min_x, bounds->max_x)) return false;
+
+    *p0 = (SamplePoint){q0.y, q0.x};
+    *p1 = (SamplePoint){q1.y, q1.x};
+    return true;
+}
+
+static void build_path(ParametricCurve *curve, const Sweep *sweep) {
+    SamplePath *path = &curve->path;
+    bool connected = false;
+    path->count = 0;
+
+    for (int i = 1; i < curve->count; i++) {
+        const CurveSample *a = &curve->samples[i - 1], *b = &curve->samples[i];
+
+        // Pieces still too far from the curve once the budget ran out are drawn as they are
+        int pieces;
+        IntervalState state = classify(a, b, sweep, &pieces);
+        if (state == INTERVAL_HIDDEN || !finite_point(a) || !finite_point(b)) {
+            connected = false;
+            continue;
+        }
+
+        // Far points are clipped so they don't overflow floats
+        SamplePoint p0 = {a->x, a->y}, p1 = {b->x, b->y};
+        if (!clip_segment(&p0, &p1, &sweep->far)) {
+            connected = false;
+            continue;
+        }
+
+        // Start a new run after a break or where the curve comes back from far away
+        if (!connected || p0.x != a->x || p0.y != a->y) {
+            if (path->count > 0) sample_path_push(path, (SamplePoint){NAN, NAN});
+            sample_path_push(path, p0);
+        }
+
+        sample_path_push(path, p1);
+        connected = p1.x == b->x && p1.y == b->y;
+    }
+
+    path->version = ++curve->version;
+}
+
+int parametric_update(ParsedExpression *expression, SampleView view) {
+    ParametricCurve *curve = expression->parametric;
+
+    // Seeds are spread evenly over the range, so loops smaller than their spacing may be missed
+    double width = view.max_x - view.min_x, height = view.max_y - view.min_y;
+    double spacing = (PARAMETRIC_T_MAX - PARAMETRIC_T_MIN) / (PARAMETRIC_SEEDS - 1);
+    Sweep sweep = {
+        .kept = {view.min_x - PARAMETRIC_MARGIN * width, view.max_x + PARAMETRIC_MARGIN * width,
+                 view.min_y - PARAMETRIC_MARGIN * height, view.max_y + PARAMETRIC_MARGIN * height},
+        .far = {view.min_x - width, view.max_x + width, view.min_y - height, view.max_y + height},
+        .tolerance = SAMPLE_TOLERANCE / view.scale,
+        .spacing = spacing,
+        .min_step = ldexp(spacing, -PARAMETRIC_MAX_DEPTH),
+    };
+
+    reserve_samples(curve, PARAMETRIC_SEEDS);
+    reserve_pending(curve, PARAMETRIC_SEEDS);
+    curve->count = 0;
+    for (int i = 0; i < PARAMETRIC_SEEDS; i++) {
+        double t = i < PARAMETRIC_SEEDS - 1 ? PARAMETRIC_T_MIN + i * spacing : PARAMETRIC_T_MAX;
+        push_pending(curve, curve->samples, &curve->count, t);
+    }
+
+    int evaluations = evaluate_pending(expression);
+
+    // Split every interval too far from the curve at once, until none are left or the budget is used up
+    for (;;) {
+        if (!curve->derivatives) estimate_tangents(curve);
+
+        int evaluated = split_pass(expression, &sweep, PARAMETRIC_MAX_SAMPLES - evaluations);
+        if (evaluated == 0) break;
+        evaluations += evaluated;
+    }
+
+    build_path(curve, &sweep);
+    return evaluations;
+}
+
+static void curve_job(void *arg) {
+    ParsedExpression *expression = arg;
+    int evaluations = parametric_update(expression, expression->view);
+
+    atomic_fetch_add_explicit(&expression->evaluations, evaluations, memory_order_relaxed);
+    expression->settled = true;
+}
+
+void parametric_schedule(ParsedExpression *expression, SampleView view) {
+    // Renderer keeps drawing the published path while a job is running
+    if (pool_busy(&expression->job)) return;
+
+    // The finished job no longer touches its path, so it can be swapped with the published one
+    ParametricCurve *curve = expression->parametric;
+    if (curve->path.version > expression->path.version) {
+        SamplePath published = expression->path;
+        expression->path = curve->path;
+        curve->path = published;
+    }
+
+    // Every job samples its view from the seeds, so there's nothing to do until the view moves
+    SampleView *last = &expression->view;
+    bool moved = last->min_x != view.min_x || last->max_x != view.max_x || last->min_y != view.min_y ||
+                 last->max_y != view.max_y || last->scale != view.scale;
+    if (expression->settled && !moved) return;
+
+    expression->view = view;
+    expression->settled = false;
+    pool_submit(&expression->job, curve_job, expression);
+}
+
+bool parametric_pending(ParsedExpression *expression) {
+    // The job's path can only be read once it's done
+    if (pool_busy(&expression->job)) return true;
+    return !expression->settled || expression->parametric->path.version > expression->path.version;
+}
+
+void parametric_free(ParametricCurve *curve) {
+    free(curve->samples);
+    free(curve->spare_samples);
+    free(curve->ts);
+    free(curve->slots);
+    sample_path_free(&curve->path);
+    *curve = (ParametricCurve){0};
+}
@@ -0,0 +1,214 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+// Queued unit of work
+typedef struct {
+    void (*run)(void *arg);
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+// Ring of tasks, the owner works from the back and thieves take from the front
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    int head;
+    int count;
+    int capacity;
+} TaskQueue;
+
+static struct {
+    pthread_t *threads;
+    TaskQueue *queues;
+    int count;
+    atomic_uint next_queue; // Queue given the next task submitted from outside the pool
+    atomic_int queued;
+    atomic_bool stopping;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+    void (*thread_exit)(void);
+} pool;
+
+// Index of the worker running on this thread, -1 outside the pool
+static _Thread_local int worker_index = -1;
+
+static void queue_push(TaskQueue *queue, Task task) {
+    pthread_mutex_lock(&queue->lock);
+
+    // Grow ring if needed, unwrapping it into the new array
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        Task *tasks = malloc(sizeof(Task) * capacity);
+        for (int i = 0; i < queue->count; i++) tasks[i] = queue->tasks[(queue->head + i) % queue->capacity];
+
+        free(queue->tasks);
+        queue->tasks = tasks;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+
+    queue->tasks[(queue->head + queue->count) % queue->capacity] = task;
+    queue->count++;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool queue_pop(TaskQueue *queue, Task *task, bool steal, TaskGroup *group) {
+    pthread_mutex_lock(&queue->lock);
+
+    // Owners take their newest task while it's still warm, thieves the oldest one, skipping tasks of other groups
+    // when waiting on one, which may have been queued on top of its tasks
+    int found = -1;
+    for (int i = 0; i < queue->count && found < 0; i++) {
+        int index = steal ? i : queue->count - 1 - i;
+        if (group == NULL || queue->tasks[(queue->head + index) % queue->capacity].group == group) found = index;
+    }
+
+    // Close the gap left behind, moving the head past the oldest task
+    if (found >= 0) {
+        Task *tasks = queue->tasks;
+        int head = queue->head, capacity = queue->capacity;
+        *task = tasks[(head + found) % capacity];
+
+        if (found == 0) queue->head = (head + 1) % capacity;
+        for (int i = found; i > 0 && i < queue->count - 1; i++)
+            tasks[(head + i) % capacity] = tasks[(head + i + 1) % capacity];
+        queue->count--;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return found >= 0;
+}
+
+static bool find_task(Task *task, TaskGroup *group) {
+    // Threads waiting on a group only run its tasks, anything else could reuse the state of the task waiting
+    if (worker_index >= 0 && queue_pop(&pool.queues[worker_index], task, false, group)) return true;
+
+    // Steal from the other workers, starting past our own queue. Waiters look there too, since tasks of their group
+    // may have been queued by another thread
+    int start = worker_index >= 0 ? worker_index + 1 : 0;
+    for (int i = 0; i < pool.count; i++) {
+        int victim = (start + i) % pool.count;
+        if (victim != worker_index && queue_pop(&pool.queues[victim], task, true, group)) return true;
+    }
+
+    return false;
+}
+
+static bool take_task(Task *task, TaskGroup *group) {
+    if (pool.count == 0 || !find_task(task, group)) return false;
+
+    atomic_fetch_sub(&pool.queued, 1);
+    return true;
+}
+
+static void run_task(Task *task) {
+    task->run(task->arg);
+    atomic_fetch_sub_explicit(&task->group->pending, 1, memory_order_release);
+}
+
+static void *worker_main(void *arg) {
+    worker_index = (int)(size_t)arg;
+
+    while (true) {
+        Task task;
+        if (take_task(&task, NULL)) {
+            run_task(&task);
+            continue;
+        }
+
+        // Sleep until more work is queued, leaving once the queues are drained
+        pthread_mutex_lock(&pool.sleep_lock);
+        while (atomic_load(&pool.queued) == 0 && !atomic_load(&pool.stopping))
+            pthread_cond_wait(&pool.wake, &pool.sleep_lock);
+        bool stop = atomic_load(&pool.queued) == 0 && atomic_load(&pool.stopping);
+        pthread_mutex_unlock(&pool.sleep_lock);
+
+        if (stop) break;
+    }
+
+    if (pool.thread_exit != NULL) pool.thread_exit();
+    return NULL;
+}
+
+void pool_init(int threads, void (*thread_exit)(void)) {
+    // Leave a core to the calling thread
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (threads < 1) threads = 1;
+
+    pool.threads = malloc(sizeof(pthread_t) * threads);
+    pool.queues = calloc(threads, sizeof(TaskQueue));
+    pool.thread_exit = thread_exit;
+    atomic_init(&pool.next_queue, 0);
+    atomic_init(&pool.queued, 0);
+    atomic_init(&pool.stopping, false);
+    pthread_mutex_init(&pool.sleep_lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+
+    for (int i = 0; i < threads; i++) pthread_mutex_init(&pool.queues[i].lock, NULL);
+
+    // Queues must all exist before any worker starts stealing
+    pool.count = threads;
+    for (int i = 0; i < threads; i++) pthread_create(&pool.threads[i], NULL, worker_main, (void *)(size_t)i);
+}
+
+void pool_submit(TaskGroup *group, void (*run)(void *arg), void *arg) {
+    if (pool.count == 0) {
+        run(arg);
+        return;
+    }
+
+    // Workers keep their subtasks local, other threads spread tasks round robin
+    atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+    int queue = worker_index >= 0 ? worker_index : (int)(atomic_fetch_add(&pool.next_queue, 1) % pool.count);
+    queue_push(&pool.queues[queue], (Task){run, arg, group});
+
+    // Increment under the lock so a worker about to sleep can't miss it
+    pthread_mutex_lock(&pool.sleep_lock);
+    atomic_fetch_add(&pool.queued, 1);
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.sleep_lock);
+}
+
+bool pool_busy(TaskGroup *group) {
+    return atomic_load_explicit(&group->pending, memory_order_acquire) > 0;
+}
+
+void pool_wait(TaskGroup *group) {
+    while (pool_busy(group)) {
+        Task task;
+        if (take_task(&task, group)) run_task(&task);
+        else sched_yield();
+    }
+}
+
+int pool_thread_count(void) {
+    return pool.count;
+}
+
+void pool_free(void) {
+    if (pool.count == 0) return;
+
+    pthread_mutex_lock(&pool.sleep_lock);
+    atomic_store(&pool.stopping, true);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.sleep_lock);
+
+    for (int i = 0; i < pool.count; i++) pthread_join(pool.threads[i], NULL);
+
+    for (int i = 0; i < pool.count; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+        free(pool.queues[i].tasks);
+    }
+
+    pthread_mutex_destroy(&pool.sleep_lock);
+    pthread_cond_destroy(&pool.wake);
+    free(pool.threads);
+    free(pool.queues);
+    pool.count = 0;
+}
@@ -0,0 +1,345 @@
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "display.h"
+#include "profiler.h"
+
+// Timings of one frame, in seconds since the window opened
+typedef struct {
+    long index;
+    double start;
+    double duration;
+    bool drawn; // Cached frame was redrawn
+    double stage_start[PROFILE_STAGE_COUNT];
+    double stage_time[PROFILE_STAGE_COUNT];
+    bool stage_ran[PROFILE_STAGE_COUNT];
+} ProfileFrame;
+
+// Cost of one curve within a frame
+typedef struct {
+    double start;
+    double time;
+    int evaluations; // Finished by sampling jobs since the curve was last drawn
+    int segments;
+    bool ran;
+} ProfileCurve;
+
+static const char *stage_names[PROFILE_STAGE_COUNT] = {"update", "grid", "curves", "labels", "legend", "end_drawing"};
+
+bool profiler_active = false;
+
+static struct {
+    ParsedExpression *expressions;
+    int count;
+
+    // Frame being recorded, the last one and the last one that redrew the cached frame
+    ProfileFrame frame;
+    ProfileFrame last;
+    ProfileFrame drawn;
+    ProfileCurve *curves;
+    ProfileCurve *drawn_curves;
+    bool recording;
+    long frame_count;
+
+    // Ring of recent frame durations
+    double history[PROFILER_HISTORY];
+    int history_count;
+    int history_next;
+
+    FILE *trace;
+    ProfileFormat format;
+    bool overlay;
+} profiler;
+
+static void write_string(FILE *file, const char *text) {
+    // Slots of removed expressions have no text
+    if (text == NULL) text = "";
+
+    fputc('"', file);
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') fputc('\\', file);
+        fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+static void write_header(void) {
+    switch (profiler.format) {
+        case PROFILE_CSV:
+            fprintf(profiler.trace, "frame,time_ms,frame_ms,drawn");
+            for (int s = 0; s < PROFILE_STAGE_COUNT; s++) fprintf(profiler.trace, ",%s_ms", stage_names[s]);
+            for (int i = 0; i < profiler.count; i++) {
+                fprintf(profiler.trace, ",curve%d_ms,curve%d_evaluations,curve%d_segments", i + 1, i + 1, i + 1);
+            }
+            fprintf(profiler.trace, "\n");
+            break;
+        case PROFILE_JSON:
+            fprintf(profiler.trace, "[\n");
+            break;
+        case PROFILE_CHROME:
+            fprintf(profiler.trace, "{\"traceEvents\": [\n");
+            fprintf(profiler.trace, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+                                    "\"args\": {\"name\": \"render\"}}");
+            break;
+    }
+}
+
+static void write_event(const char *category, const char *name, double start, double duration) {
+    // Complete events, timestamps in microseconds
+    fprintf(profiler.trace, ",\n{\"cat\": \"%s\", \"name\": ", category);
+    write_string(profiler.trace, name);
+    fprintf(profiler.trace, ", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f", start * 1e6,
+            duration * 1e6);
+}
+
+static void write_frame(ProfileFrame *frame) {
+    FILE *file = profiler.trace;
+
+    switch (profiler.format) {
+        case PROFILE_CSV:
+            fprintf(file, "%ld,%.4f,%.4f,%d", frame->index, frame->start * 1e3, frame->duration * 1e3, frame->drawn);
+            for (int s = 0; s < PROFILE_STAGE_COUNT; s++) fprintf(file, ",%.4f", frame->stage_time[s] * 1e3);
+            for (int i = 0; i < profiler.count; i++) {
+                ProfileCurve *curve = &profiler.curves[i];
+                fprintf(file, ",%.4f,%d,%d", curve->time * 1e3, curve->evaluations, curve->segments);
+            }
+            fprintf(file, "\n");
+            break;
+
+        case PROFILE_JSON:
+            fprintf(file, "%s{\"frame\": %ld, \"time_ms\": %.4f, \"frame_ms\": %.4f, \"drawn\": %s, \"stages\": {",
+                    frame->index == 0 ? "" : ",\n", frame->index, frame->start * 1e3, frame->duration * 1e3,
+                    frame->drawn ? "true" : "false");
+            for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+                fprintf(file, "%s\"%s\": %.4f", s == 0 ? "" : ", ", stage_names[s], frame->stage_time[s] * 1e3);
+            }
+            fprintf(file, "}, \"curves\": [");
+            for (int i = 0; i < profiler.count; i++) {
+                ProfileCurve *curve = &profiler.curves[i];
+                fprintf(file, "%s{\"expression\": ", i == 0 ? "" : ", ");
+                write_string(file, profiler.expressions[i].text);
+                fprintf(file, ", \"ms\": %.4f, \"evaluations\": %d, \"segments\": %d}", curve->time * 1e3,
+                        curve->evaluations, curve->segments);
+            }
+            fprintf(file, "]}");
+            break;
+
+        case PROFILE_CHROME:
+            write_event("frame", frame->drawn ? "frame" : "idle frame", frame->start, frame->duration);
+            fprintf(file, "}");
+
+            for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+                if (!frame->stage_ran[s]) continue;
+                write_event("stage", stage_names[s], frame->stage_start[s], frame->stage_time[s]);
+                fprintf(file, "}");
+            }
+
+            for (int i = 0; i < profiler.count; i++) {
+                ProfileCurve *curve = &profiler.curves[i];
+                if (!curve->ran) continue;
+
+                write_event("curve", profiler.expressions[i].text, curve->start, curve->time);
+                fprintf(file, ", \"args\": {\"evaluations\": %d, \"segments\": %d}}", curve->evaluations,
+                        curve->segments);
+            }
+            break;
+    }
+}
+
+bool profiler_format(const char *name, ProfileFormat *format) {
+    if (strcmp(name, "csv") == 0) *format = PROFILE_CSV;
+    else if (strcmp(name, "json") == 0) *format = PROFILE_JSON;
+    else if (strcmp(name, "chrome") == 0) *format = PROFILE_CHROME;
+    else return false;
+
+    return true;
+}
+
+void profiler_init(ParsedExpression *expressions, int count, ProfileFormat format, const char *path) {
+    profiler.expressions = expressions;
+    profiler.count = count;
+    profiler.curves = calloc(count, sizeof(ProfileCurve));
+    profiler.drawn_curves = calloc(count, sizeof(ProfileCurve));
+    profiler.format = format;
+
+    if (path != NULL) {
+        profiler.trace = fopen(path, "w");
+        if (profiler.trace == NULL) {
+            TraceLog(LOG_WARNING, "Unable to open trace file '%s', running without a trace", path);
+            return;
+        }
+
+        write_header();
+        profiler_active = true;
+    }
+}
+
+void profiler_toggle_overlay(void) {
+    profiler.overlay = !profiler.overlay;
+
+    // Takes effect from the next frame, work done while inactive isn't counted
+    bool active = profiler.overlay || profiler.trace != NULL;
+    if (active && !profiler_active) {
+        for (int i = 0; i < profiler.count; i++) atomic_store(&profiler.expressions[i].evaluations, 0);
+        profiler.recording = false;
+    }
+
+    profiler_active = active;
+}
+
+void profiler_record_frame_begin(void) {
+    profiler.frame = (ProfileFrame){.index = profiler.frame_count++, .start = GetTime()};
+    memset(profiler.curves, 0, sizeof(ProfileCurve) * profiler.count);
+    profiler.recording = true;
+}
+
+void profiler_record_frame_end(bool drawn) {
+    if (!profiler.recording) return;
+    profiler.recording = false;
+
+    ProfileFrame *frame = &profiler.frame;
+    frame->duration = GetTime() - frame->start;
+    frame->drawn = drawn;
+
+    // Keep what the overlay shows
+    profiler.history[profiler.history_next] = frame->duration;
+    profiler.history_next = (profiler.history_next + 1) % PROFILER_HISTORY;
+    if (profiler.history_count < PROFILER_HISTORY) profiler.history_count++;
+
+    profiler.last = *frame;
+    if (drawn) {
+        profiler.drawn = *frame;
+        memcpy(profiler.drawn_curves, profiler.curves, sizeof(ProfileCurve) * profiler.count);
+    }
+
+    if (profiler.trace != NULL) write_frame(frame);
+}
+
+void profiler_record_begin(ProfileStage stage) {
+    if (!profiler.recording) return;
+    profiler.frame.stage_start[stage] = GetTime();
+}
+
+void profiler_record_end(ProfileStage stage) {
+    if (!profiler.recording) return;
+    profiler.frame.stage_time[stage] = GetTime() - profiler.frame.stage_start[stage];
+    profiler.frame.stage_ran[stage] = true;
+}
+
+void profiler_record_curve_begin(int index) {
+    if (!profiler.recording) return;
+    profiler.curves[index].start = GetTime();
+}
+
+void profiler_record_curve_end(int index) {
+    if (!profiler.recording) return;
+
+    ParsedExpression *expression = &profiler.expressions[index];
+    ProfileCurve *curve = &profiler.curves[index];
+    curve->time = GetTime() - curve->start;
+    curve->evaluations = atomic_exchange(&expression->evaluations, 0);
+    curve->segments = expression->mesh.segment_count;
+    curve->ran = true;
+}
+
+static void draw_row(const char *label, const char *value, int x, int y, int width, Color color) {
+    // Label on the left, value aligned to the right edge
+    DrawText(label, x, y, PROFILER_TEXT_SIZE, color);
+    DrawText(value, x + width - MeasureText(value, PROFILER_TEXT_SIZE), y, PROFILER_TEXT_SIZE, COLOR_BRIGHT_WHITE);
+}
+
+static void draw_histogram(int x, int y, int width) {
+    // Frame durations binned by millisecond, slower frames fall in the last bin
+    int bins[PROFILER_HISTOGRAM_BINS] = {0};
+    int highest = 1;
+    for (int i = 0; i < profiler.history_count; i++) {
+        int bin = (int)(profiler.history[i] * 1e3);
+        if (bin >= PROFILER_HISTOGRAM_BINS) bin = PROFILER_HISTOGRAM_BINS - 1;
+        if (++bins[bin] > highest) highest = bins[bin];
+    }
+
+    float bar_width = (float)width / PROFILER_HISTOGRAM_BINS;
+    for (int b = 0; b < PROFILER_HISTOGRAM_BINS; b++) {
+        float height = (float)bins[b] / highest * PROFILER_HISTOGRAM_HEIGHT;
+        Color color = b < 1000 / FPS ? COLOR_GREEN : COLOR_RED;
+        DrawRectangleRec((Rectangle){x + b * bar_width, y + PROFILER_HISTOGRAM_HEIGHT - height, bar_width - 1, height},
+                         color);
+    }
+
+    const char *max_label = TextFormat("%d+ ms", PROFILER_HISTOGRAM_BINS - 1);
+    int label_y = y + PROFILER_HISTOGRAM_HEIGHT + PROFILER_SPACING / 2;
+    DrawText("0", x, label_y, PROFILER_TEXT_SIZE, COLOR_WHITE);
+    DrawText(max_label, x + width - MeasureText(max_label, PROFILER_TEXT_SIZE), label_y, PROFILER_TEXT_SIZE,
+             COLOR_WHITE);
+}
+
+void profiler_draw_overlay(void) {
+    if (!profiler.overlay) return;
+
+    int line = PROFILER_TEXT_SIZE + PROFILER_SPACING / 2;
+    int listed = 0;
+    for (int i = 0; i < profiler.count; i++) listed += profiler.expressions[i].text != NULL;
+
+    int rows = 2 + PROFILE_STAGE_COUNT + 2 * listed;
+    int width = PROFILER_WIDTH;
+    int height = 4 * PROFILER_SPACING + rows * line + PROFILER_HISTOGRAM_HEIGHT + PROFILER_TEXT_SIZE;
+    int x = display.width - width - PROFILER_SPACING;
+    int y = PROFILER_SPACING;
+
+    // Draw overlay box
+    Color color = COLOR_BLACK;
+    color.a = PROFILER_OPACITY;
+    DrawRectangle(x, y, width, height, color);
+
+    x += PROFILER_SPACING;
+    y += PROFILER_SPACING;
+    width -= 2 * PROFILER_SPACING;
+
+    // Whole frame and the stages run every frame come from the last one, drawing from the last redraw
+    draw_row("frame", TextFormat("%.2f ms", profiler.last.duration * 1e3), x, y, width, COLOR_BRIGHT_YELLOW);
+    y += line;
+
+    // Lowered while drawn frames run over budget
+    draw_row("quality", TextFormat("%g samples/px", display.quality), x, y, width, COLOR_WHITE);
+    y += line;
+
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        bool every_frame = s == PROFILE_UPDATE || s == PROFILE_END_DRAWING;
+        ProfileFrame *frame = every_frame ? &profiler.last : &profiler.drawn;
+        draw_row(stage_names[s], TextFormat("%.2f ms", frame->stage_time[s] * 1e3), x, y, width, COLOR_WHITE);
+        y += line;
+    }
+
+    // Two rows per curve, its expression then its cost
+    for (int i = 0; i < profiler.count; i++) {
+        ParsedExpression *expression = &profiler.expressions[i];
+        ProfileCurve *curve = &profiler.drawn_curves[i];
+        if (expression->text == NULL) continue;
+
+        DrawText(expression->text, x, y, PROFILER_TEXT_SIZE, expression->color);
+        y += line;
+
+        const char *value = curve->ran ? TextFormat("%.2f ms", curve->time * 1e3) : "-";
+        draw_row(TextFormat("  %d evaluations, %d segments", curve->evaluations, curve->segments), value, x, y, width,
+                 COLOR_WHITE);
+        y += line;
+    }
+
+    draw_histogram(x, y + PROFILER_SPACING, width);
+}
+
+void profiler_free(void) {
+    if (profiler.trace != NULL) {
+        if (profiler.format == PROFILE_JSON) fprintf(profiler.trace, "\n]\n");
+        if (profiler.format == PROFILE_CHROME) fprintf(profiler.trace, "\n]}\n");
+        fclose(profiler.trace);
+    }
+
+    free(profiler.curves);
+    free(profiler.drawn_curves);
+    memset(&profiler, 0, sizeof(profiler));
+    profiler_active = false;
+}
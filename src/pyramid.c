@@ -0,0 +1,328 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <raylib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "pyramid.h"
+#include "series.h"
+
+// Points read or written at once while building
+#define BUILD_CHUNK 65536
+
+// Extremes of the bucket being built
+typedef struct {
+    SamplePoint min, max;
+    long long min_order, max_order;
+    double start_x, end_x;
+    long long order; // Points added so far
+    bool any;        // Holds a point that isn't a gap
+} BucketBuilder;
+
+static void bucket_add(BucketBuilder *bucket, SamplePoint point) {
+    if (bucket->order == 0) bucket->start_x = point.x;
+    bucket->end_x = point.x;
+    long long order = bucket->order++;
+
+    if (isnan(point.y)) return;
+    if (!bucket->any || point.y < bucket->min.y) {
+        bucket->min = point;
+        bucket->min_order = order;
+    }
+    if (!bucket->any || point.y > bucket->max.y) {
+        bucket->max = point;
+        bucket->max_order = order;
+    }
+
+    bucket->any = true;
+}
+
+static PyramidBucket bucket_finish(BucketBuilder *bucket) {
+    PyramidBucket result;
+
+    if (!bucket->any) {
+        result = (PyramidBucket){{bucket->start_x, NAN}, {bucket->end_x, NAN}};
+    } else if (bucket->min_order <= bucket->max_order) {
+        result = (PyramidBucket){bucket->min, bucket->max};
+    } else {
+        result = (PyramidBucket){bucket->max, bucket->min};
+    }
+
+    *bucket = (BucketBuilder){0};
+    return result;
+}
+
+// Raw points buffered before they are written, in increasing x
+typedef struct {
+    FILE *output;
+    SamplePoint *points;
+    int count;
+    long long total;
+    double last_x;
+    long long dropped;
+    long long index; // X of the next point without one
+} RawWriter;
+
+static bool raw_flush(RawWriter *writer) {
+    bool written = fwrite(writer->points, sizeof(SamplePoint), writer->count, writer->output) == (size_t)writer->count;
+    writer->total += writer->count;
+    writer->count = 0;
+    return written;
+}
+
+static bool raw_add(RawWriter *writer, double x, double y) {
+    // Levels are searched by x, so it can only go forward
+    if (x < writer->last_x) {
+        writer->dropped++;
+        return true;
+    }
+
+    writer->last_x = x;
+    writer->points[writer->count++] = (SamplePoint){x, isinf(y) ? NAN : y};
+    return writer->count < BUILD_CHUNK || raw_flush(writer);
+}
+
+static bool write_raw(RawWriter *writer, FILE *input, bool binary) {
+    if (binary) {
+        double *values = malloc(sizeof(double) * BUILD_CHUNK);
+        size_t count;
+        bool written = true;
+        while (written && (count = fread(values, sizeof(double), BUILD_CHUNK, input)) > 0) {
+            for (size_t i = 0; i < count && written; i++) written = raw_add(writer, (double)writer->index++, values[i]);
+        }
+
+        free(values);
+        if (!written) return false;
+    } else {
+        char line[SERIES_MAX_LINE];
+        while (fgets(line, sizeof(line), input) != NULL) {
+            // Overlong lines are cut short
+            size_t length = strlen(line);
+            if (length > 0 && line[length - 1] != '\n') {
+                int c;
+                while ((c = fgetc(input)) != EOF && c != '\n');
+            }
+
+            double values[2];
+            int count = series_parse_line(line, values);
+            bool written = true;
+            if (count == 2) written = raw_add(writer, values[0], values[1]);
+            else if (count == 1) written = raw_add(writer, (double)writer->index++, values[0]);
+            if (!written) return false;
+        }
+    }
+
+    return !ferror(input) && raw_flush(writer);
+}
+
+static bool write_level(FILE *output, FILE *reader, PyramidHeader *header, int level) {
+    // Finest level groups raw points, every other one pairs of buckets of the level below
+    bool from_raw = level == 1;
+    long long group = from_raw ? 1LL << header->base_shift : 2;
+    long long count = header->counts[level - 1];
+    size_t item = from_raw ? sizeof(SamplePoint) : sizeof(PyramidBucket);
+
+    if (fflush(output) != 0 || fseeko(reader, (off_t)header->offsets[level - 1], SEEK_SET) != 0) return false;
+    header->offsets[level] = (uint64_t)ftello(output);
+    header->counts[level] = 0;
+
+    SamplePoint *input = malloc(sizeof(PyramidBucket) * BUILD_CHUNK);
+    PyramidBucket *buckets = malloc(sizeof(PyramidBucket) * BUILD_CHUNK);
+    BucketBuilder bucket = {0};
+    int bucket_count = 0;
+    long long members = 0;
+    bool written = true;
+
+    for (long long done = 0; done < count && written;) {
+        // Buckets are read as their two points, which hold the extremes of the whole run
+        long long chunk = count - done < BUILD_CHUNK ? count - done : BUILD_CHUNK;
+        written = fread(input, item, chunk, reader) == (size_t)chunk;
+
+        int per_item = from_raw ? 1 : 2;
+        for (long long i = 0; i < chunk && written; i++) {
+            for (int j = 0; j < per_item; j++) bucket_add(&bucket, input[i * per_item + j]);
+            if (++members < group) continue;
+
+            buckets[bucket_count++] = bucket_finish(&bucket);
+            members = 0;
+            if (bucket_count == BUILD_CHUNK) {
+                written = fwrite(buckets, sizeof(PyramidBucket), bucket_count, output) == (size_t)bucket_count;
+                header->counts[level] += bucket_count;
+                bucket_count = 0;
+            }
+        }
+
+        done += chunk;
+    }
+
+    // Last bucket holds whatever is left
+    if (members > 0) buckets[bucket_count++] = bucket_finish(&bucket);
+    written = written && fwrite(buckets, sizeof(PyramidBucket), bucket_count, output) == (size_t)bucket_count;
+    header->counts[level] += bucket_count;
+
+    free(input);
+    free(buckets);
+    return written;
+}
+
+bool pyramid_build(FILE *input, bool binary, const char *path) {
+    FILE *output = fopen(path, "wb");
+    if (output == NULL) {
+        TraceLog(LOG_ERROR, "Unable to create pyramid file '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    // Header is written last, once every level is known
+    PyramidHeader header = {.version = PYRAMID_VERSION, .base_shift = PYRAMID_BASE_SHIFT};
+    memcpy(header.magic, PYRAMID_MAGIC, sizeof(header.magic));
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1;
+
+    RawWriter writer = {.output = output, .points = malloc(sizeof(SamplePoint) * BUILD_CHUNK), .last_x = -INFINITY};
+    written = written && write_raw(&writer, input, binary);
+    free(writer.points);
+
+    header.offsets[0] = sizeof(header);
+    header.counts[0] = (uint64_t)writer.total;
+    header.level_count = 1;
+    if (writer.dropped > 0) TraceLog(LOG_WARNING, "Dropped %lld data points going back in x", writer.dropped);
+
+    // Halve the level until a single bucket covers everything
+    FILE *reader = written ? fopen(path, "rb") : NULL;
+    while (reader != NULL && written && header.level_count < PYRAMID_MAX_LEVELS) {
+        if (header.counts[header.level_count - 1] <= 1) break;
+
+        written = write_level(output, reader, &header, header.level_count);
+        header.level_count++;
+    }
+    if (reader != NULL) fclose(reader);
+
+    written = written && fseeko(output, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, output) == 1;
+    if (fclose(output) != 0) written = false;
+
+    if (!written) {
+        TraceLog(LOG_ERROR, "Unable to write pyramid file '%s'", path);
+        return false;
+    }
+
+    TraceLog(LOG_INFO, "Wrote %llu points in %u levels to '%s'", (unsigned long long)header.counts[0],
+             header.level_count, path);
+    return true;
+}
+
+bool pyramid_open(Pyramid *pyramid, const char *path) {
+    *pyramid = (Pyramid){.fd = open(path, O_RDONLY)};
+    if (pyramid->fd < 0) {
+        TraceLog(LOG_ERROR, "Unable to open pyramid file '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(pyramid->fd, &info) != 0 || (size_t)info.st_size < sizeof(PyramidHeader)) {
+        TraceLog(LOG_ERROR, "'%s' is not a pyramid file", path);
+        close(pyramid->fd);
+        return false;
+    }
+
+    // Pages are only read as the view reaches them, without readahead pulling in neighbors
+    pyramid->size = (size_t)info.st_size;
+    void *data = mmap(NULL, pyramid->size, PROT_READ, MAP_SHARED, pyramid->fd, 0);
+    if (data == MAP_FAILED) {
+        TraceLog(LOG_ERROR, "Unable to map pyramid file '%s': %s", path, strerror(errno));
+        close(pyramid->fd);
+        return false;
+    }
+    posix_madvise(data, pyramid->size, POSIX_MADV_RANDOM);
+
+    pyramid->data = data;
+    pyramid->header = data;
+    const PyramidHeader *header = pyramid->header;
+
+    // Check every level lies within the file
+    bool valid = memcmp(header->magic, PYRAMID_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == PYRAMID_VERSION && header->level_count >= 1 &&
+                 header->level_count <= PYRAMID_MAX_LEVELS && header->base_shift < 32;
+    for (uint32_t i = 0; valid && i < header->level_count; i++) {
+        size_t item = i == 0 ? sizeof(SamplePoint) : sizeof(PyramidBucket);
+        valid = header->offsets[i] % 8 == 0 && header->offsets[i] <= pyramid->size &&
+                header->counts[i] <= (pyramid->size - header->offsets[i]) / item;
+    }
+
+    if (!valid) {
+        TraceLog(LOG_ERROR, "'%s' is not a valid pyramid file", path);
+        pyramid_close(pyramid);
+        return false;
+    }
+
+    pyramid->points = (const SamplePoint *)(pyramid->data + header->offsets[0]);
+    TraceLog(LOG_INFO, "Mapped %llu points in %u levels from '%s'", (unsigned long long)header->counts[0],
+             header->level_count, path);
+    return true;
+}
+
+static long long lower_bound(const SamplePoint *points, long long first, long long last, double x) {
+    // First index in the range with a point at or past x
+    while (first < last) {
+        long long middle = first + (last - first) / 2;
+        if (points[middle].x < x) first = middle + 1;
+        else last = middle;
+    }
+
+    return first;
+}
+
+void pyramid_decimate(Pyramid *pyramid, SampleView view, SamplePath *path) {
+    const PyramidHeader *header = pyramid->header;
+    long long total = (long long)header->counts[0];
+    path->count = 0;
+
+    // Visible raw points plus one on each side, so lines leave the screen
+    long long first = lower_bound(pyramid->points, 0, total, view.min_x);
+    long long last = lower_bound(pyramid->points, first, total, view.max_x);
+    if (first > 0) first--;
+    if (last < total) last++;
+
+    // Coarsest level whose buckets are still at most one screen pixel wide on average
+    double pixels = (view.max_x - view.min_x) * view.scale;
+    double density = (last - first) / (pixels > 1.0 ? pixels : 1.0);
+    int level = 0;
+    while (level + 1 < (int)header->level_count && (double)(1LL << (header->base_shift + level)) <= density) level++;
+
+    if (level == 0) {
+        for (long long i = first; i < last; i++) sample_path_push(path, pyramid->points[i]);
+    } else {
+        const PyramidBucket *buckets = (const PyramidBucket *)(pyramid->data + header->offsets[level]);
+        int shift = header->base_shift + level - 1;
+        long long first_bucket = first >> shift;
+        long long last_bucket = last > first ? ((last - 1) >> shift) + 1 : first_bucket;
+
+        for (long long i = first_bucket; i < last_bucket; i++) {
+            const PyramidBucket *bucket = &buckets[i];
+
+            // Runs of gaps break the line once
+            if (isnan(bucket->first.y)) {
+                if (path->count > 0 && !isnan(path->points[path->count - 1].y)) sample_path_push(path, bucket->first);
+                continue;
+            }
+
+            sample_path_push(path, bucket->first);
+            if (bucket->second.x != bucket->first.x || bucket->second.y != bucket->first.y)
+                sample_path_push(path, bucket->second);
+        }
+    }
+
+    pyramid->view = view;
+    path->version++;
+}
+
+void pyramid_close(Pyramid *pyramid) {
+    if (pyramid->data != NULL) munmap((void *)pyramid->data, pyramid->size);
+    if (pyramid->fd >= 0) close(pyramid->fd);
+    *pyramid = (Pyramid){.fd = -1};
+}
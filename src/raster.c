@@ -0,0 +1,127 @@
+#include <math.h>
+#include <string.h>
+
+#include "raster.h"
+
+// Printable ASCII glyphs as 5 columns of 8 pixels, least significant bit at the top
+static const unsigned char font_glyphs[95][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x08, 0x07, 0x03, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x2A, 0x1C, 0x7F, 0x1C, 0x2A}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x80, 0x70, 0x30, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x00, 0x60, 0x60, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x72, 0x49, 0x49, 0x49, 0x46}, {0x21, 0x41, 0x49, 0x4D, 0x33}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x46, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x00, 0x14, 0x00, 0x00},
+    {0x00, 0x40, 0x34, 0x00, 0x00}, {0x00, 0x08, 0x14, 0x22, 0x41}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x59, 0x09, 0x06}, {0x3E, 0x41, 0x5D, 0x59, 0x4E},
+    {0x7C, 0x12, 0x11, 0x12, 0x7C}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x41, 0x3E}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x41, 0x51, 0x73}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x1C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x26, 0x49, 0x49, 0x49, 0x32}, {0x03, 0x01, 0x7F, 0x01, 0x03}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x59, 0x49, 0x4D, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x41},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x41, 0x7F}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x03, 0x07, 0x08, 0x00}, {0x20, 0x54, 0x54, 0x78, 0x40},
+    {0x7F, 0x28, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x28}, {0x38, 0x44, 0x44, 0x28, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x00, 0x08, 0x7E, 0x09, 0x02}, {0x18, 0xA4, 0xA4, 0x9C, 0x78},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x40, 0x3D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x78, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0xFC, 0x18, 0x24, 0x24, 0x18},
+    {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x24},
+    {0x04, 0x04, 0x3F, 0x44, 0x24}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x4C, 0x90, 0x90, 0x90, 0x7C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x77, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02},
+};
+
+// Glyph cell in font units, scaled so that a size of 10 is one pixel per unit like raylib's default font
+#define FONT_BASE_SIZE 10
+#define FONT_ADVANCE   6
+
+static void blend_pixel(Image *image, int x, int y, Color color, float coverage) {
+    if (x < 0 || y < 0 || x >= image->width || y >= image->height || coverage <= 0.0f) return;
+
+    // Source over, keeping the destination opaque
+    Color *pixel = (Color *)image->data + (size_t)y * image->width + x;
+    float alpha = color.a / 255.0f * fminf(coverage, 1.0f);
+    pixel->r = (unsigned char)(pixel->r + (color.r - pixel->r) * alpha + 0.5f);
+    pixel->g = (unsigned char)(pixel->g + (color.g - pixel->g) * alpha + 0.5f);
+    pixel->b = (unsigned char)(pixel->b + (color.b - pixel->b) * alpha + 0.5f);
+    pixel->a = 255;
+}
+
+void raster_rectangle(Image *image, Rectangle rect, Color color) {
+    int x0 = (int)ceilf(rect.x - 0.5f), x1 = (int)ceilf(rect.x + rect.width - 0.5f);
+    int y0 = (int)ceilf(rect.y - 0.5f), y1 = (int)ceilf(rect.y + rect.height - 0.5f);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > image->width) x1 = image->width;
+    if (y1 > image->height) y1 = image->height;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) blend_pixel(image, x, y, color, 1.0f);
+    }
+}
+
+void raster_rectangle_lines(Image *image, Rectangle rect, int thickness, Color color) {
+    float t = (float)thickness;
+    raster_rectangle(image, (Rectangle){rect.x, rect.y, rect.width, t}, color);
+    raster_rectangle(image, (Rectangle){rect.x, rect.y + rect.height - t, rect.width, t}, color);
+    raster_rectangle(image, (Rectangle){rect.x, rect.y + t, t, rect.height - 2 * t}, color);
+    raster_rectangle(image, (Rectangle){rect.x + rect.width - t, rect.y + t, t, rect.height - 2 * t}, color);
+}
+
+void raster_line(Image *image, Vector2 start, Vector2 end, float thickness, Color color) {
+    float half = thickness / 2.0f;
+    float dx = end.x - start.x, dy = end.y - start.y;
+    float length_sq = dx * dx + dy * dy;
+
+    // Visit pixels around the segment's bounding box
+    int x0 = (int)floorf(fminf(start.x, end.x) - half - 1.0f), x1 = (int)ceilf(fmaxf(start.x, end.x) + half + 1.0f);
+    int y0 = (int)floorf(fminf(start.y, end.y) - half - 1.0f), y1 = (int)ceilf(fmaxf(start.y, end.y) + half + 1.0f);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > image->width - 1) x1 = image->width - 1;
+    if (y1 > image->height - 1) y1 = image->height - 1;
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            // Distance from the pixel center to the segment sets its coverage
+            float px = x + 0.5f - start.x, py = y + 0.5f - start.y;
+            float t = length_sq > 0.0f ? fmaxf(0.0f, fminf(1.0f, (px * dx + py * dy) / length_sq)) : 0.0f;
+            float ex = px - t * dx, ey = py - t * dy;
+            float distance = sqrtf(ex * ex + ey * ey);
+
+            blend_pixel(image, x, y, color, half + 0.5f - distance);
+        }
+    }
+}
+
+void raster_text(Image *image, const char *text, int x, int y, int size, Color color) {
+    int scale = size / FONT_BASE_SIZE > 0 ? size / FONT_BASE_SIZE : 1;
+
+    for (const char *c = text; *c != '\0'; c++, x += FONT_ADVANCE * scale) {
+        if (*c < ' ' || *c > '~') continue;
+        const unsigned char *glyph = font_glyphs[*c - ' '];
+
+        // Fill a scaled block for every set bit
+        for (int column = 0; column < 5; column++) {
+            for (int row = 0; row < 8; row++) {
+                if (!(glyph[column] >> row & 1)) continue;
+                Rectangle block = {x + column * scale, y + (row + 1) * scale, scale, scale};
+                raster_rectangle(image, block, color);
+            }
+        }
+    }
+}
+
+int raster_measure_text(const char *text, int size) {
+    int scale = size / FONT_BASE_SIZE > 0 ? size / FONT_BASE_SIZE : 1;
+    int length = (int)strlen(text);
+    return length > 0 ? (length * FONT_ADVANCE - 1) * scale : 0;
+}
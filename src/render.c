@@ -0,0 +1,444 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "draw.h"
+#include "gui.h"
+#include "pool.h"
+#include "raster.h"
+#include "render.h"
+#include "sampler.h"
+
+// Expression parsed and compiled once, shared by every plot that uses it
+typedef struct {
+    char *text;
+    Node *root;
+    int order;
+    Program program;
+    bool compiled;
+    Program tangent;
+    bool tangents;
+} CachedExpression;
+
+// Compiled expressions keyed by their text
+typedef struct {
+    CachedExpression *entries;
+    int count;
+    int capacity;
+} ExpressionCache;
+
+// Growable array of plots to render
+typedef struct {
+    RenderJob *jobs;
+    int count;
+    int capacity;
+} RenderBatch;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long hash_text(const char *text) {
+    // FNV-1a
+    unsigned long hash = 2166136261u;
+    for (const char *c = text; *c != '\0'; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    return hash;
+}
+
+static CachedExpression *cache_get(ExpressionCache *cache, Parser *parser, const char *text) {
+    // Grow table if needed, keeping it at most half full
+    if (2 * (cache->count + 1) > cache->capacity) {
+        ExpressionCache grown = {calloc(cache->capacity == 0 ? 64 : cache->capacity * 2, sizeof(CachedExpression)),
+                                 cache->count, cache->capacity == 0 ? 64 : cache->capacity * 2};
+
+        for (int i = 0; i < cache->capacity; i++) {
+            if (cache->entries[i].text == NULL) continue;
+            unsigned long slot = hash_text(cache->entries[i].text) % grown.capacity;
+            while (grown.entries[slot].text != NULL) slot = (slot + 1) % grown.capacity;
+            grown.entries[slot] = cache->entries[i];
+        }
+
+        free(cache->entries);
+        *cache = grown;
+    }
+
+    // Probe for the expression, parsing and compiling it on a miss
+    unsigned long slot = hash_text(text) % cache->capacity;
+    while (cache->entries[slot].text != NULL) {
+        if (strcmp(cache->entries[slot].text, text) == 0) return &cache->entries[slot];
+        slot = (slot + 1) % cache->capacity;
+    }
+
+    CachedExpression *entry = &cache->entries[slot];
+    size_t length = strlen(text);
+    entry->text = malloc(length + 1);
+    memcpy(entry->text, text, length + 1);
+    entry->root = parser_parse(parser, expression_strip_derivatives(entry->text, &entry->order));
+    cache->count++;
+
+    if (entry->root == NULL) {
+        TraceLog(LOG_WARNING, "Unable to parse '%s'", text);
+    } else {
+        entry->compiled = program_compile_derivative(&entry->program, entry->root, entry->order);
+        if (entry->compiled) {
+            expression_jit(&entry->program, &entry->root, &entry->order, 1, false);
+            entry->tangents = expression_compile_tangent(&entry->tangent, entry->root, entry->order);
+        } else if (entry->order > 0) {
+            // Derivatives only exist as programs
+            TraceLog(LOG_WARNING, "Unable to differentiate '%s'", text);
+            entry->root = NULL;
+        } else {
+            TraceLog(LOG_WARNING, "Unable to compile '%s', falling back to tree evaluation", text);
+        }
+    }
+
+    return entry;
+}
+
+static void cache_free(ExpressionCache *cache) {
+    for (int i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].compiled) program_free(&cache->entries[i].program);
+        if (cache->entries[i].tangents) program_free(&cache->entries[i].tangent);
+        free(cache->entries[i].text);
+    }
+
+    free(cache->entries);
+    *cache = (ExpressionCache){0};
+}
+
+static bool add_job(RenderBatch *batch, ExpressionCache *cache, Parser *parser, RenderJob job,
+                    char **texts, int count) {
+    if (job.width <= 0 || job.height <= 0 || !(job.min_x < job.max_x) || !(job.min_y < job.max_y)) {
+        TraceLog(LOG_ERROR, "Invalid view or size for '%s'", job.output);
+        return false;
+    }
+
+    // Grow job array if needed
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity == 0 ? 16 : batch->capacity * 2;
+        batch->jobs = realloc(batch->jobs, sizeof(RenderJob) * batch->capacity);
+    }
+
+    // Expressions share the cached tree and program, but get samples of their own
+    Color colors[] = COLOR_POOL;
+    job.expressions = malloc(sizeof(ParsedExpression) * (count > 0 ? count : 1));
+    job.count = count;
+
+    for (int i = 0; i < count; i++) {
+        CachedExpression *entry = cache_get(cache, parser, texts[i]);
+        job.expressions[i] = (ParsedExpression){
+            .text = entry->text,
+            .root = entry->root,
+            .color = colors[i % (sizeof(colors) / sizeof(Color))],
+            .visible = true,
+            .order = entry->order,
+            .program = entry->program,
+            .compiled = entry->compiled,
+            .tangent = entry->tangent,
+            .tangents = entry->tangents,
+            .slope_output = -1,
+        };
+    }
+
+    batch->jobs[batch->count++] = job;
+    return true;
+}
+
+static bool parse_view(const char *text, RenderJob *job) {
+    return sscanf(text, "%lf,%lf,%lf,%lf", &job->min_x, &job->max_x, &job->min_y, &job->max_y) == 4;
+}
+
+static bool parse_size(const char *text, RenderJob *job) {
+    return sscanf(text, "%dx%d", &job->width, &job->height) == 2;
+}
+
+static bool load_manifest(RenderBatch *batch, ExpressionCache *cache, Parser *parser, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        TraceLog(LOG_ERROR, "Unable to open manifest '%s'", path);
+        return false;
+    }
+
+    // One plot per line: OUTPUT, VIEW, SIZE and the expressions, separated by tabs
+    char line[4096];
+    int number = 0;
+    bool ok = true;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        char *fields[256];
+        int count = 0;
+        for (char *field = strtok(line, "\t"); field != NULL && count < 256; field = strtok(NULL, "\t"))
+            fields[count++] = field;
+
+        // Output names are kept, so they must outlive the line buffer
+        RenderJob job = {0};
+        if (count < 3 || !parse_view(fields[1], &job) || !parse_size(fields[2], &job)) {
+            TraceLog(LOG_ERROR, "%s:%d: expected OUTPUT<TAB>XMIN,XMAX,YMIN,YMAX<TAB>WxH<TAB>EXPRESSION...", path, number);
+            ok = false;
+            continue;
+        }
+
+        size_t length = strlen(fields[0]);
+        char *output = malloc(length + 1);
+        memcpy(output, fields[0], length + 1);
+        job.output = output;
+
+        if (!add_job(batch, cache, parser, job, fields + 3, count - 3)) {
+            free(output);
+            ok = false;
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static void job_scale(RenderJob *job, double *scale_x, double *scale_y) {
+    *scale_x = job->width / (job->max_x - job->min_x);
+    *scale_y = job->height / (job->max_y - job->min_y);
+}
+
+void render_grid(Image *image, RenderJob *job) {
+    double scale_x, scale_y;
+    job_scale(job, &scale_x, &scale_y);
+
+    // Same spacing rules as the window, applied to each axis
+    double step_x = grid_spacing((float)(scale_x / GRID_PIXELS_PER_UNIT)) / GRID_PIXELS_PER_UNIT;
+    double step_y = grid_spacing((float)(scale_y / GRID_PIXELS_PER_UNIT)) / GRID_PIXELS_PER_UNIT;
+
+    // Draw vertical lines
+    GridRange x_range = grid_range(job->min_x, job->max_x, step_x);
+    for (long i = x_range.first; i <= x_range.last; i++) {
+        float x = floorf((float)((i * step_x - job->min_x) * scale_x));
+        raster_rectangle(image, (Rectangle){x, 0, 1, job->height}, grid_line_color(i));
+    }
+
+    // Draw horizontal lines
+    GridRange y_range = grid_range(job->min_y, job->max_y, step_y);
+    for (long i = y_range.first; i <= y_range.last; i++) {
+        float y = floorf((float)((job->max_y - i * step_y) * scale_y));
+        raster_rectangle(image, (Rectangle){0, y, job->width, 1}, grid_line_color(i));
+    }
+}
+
+void render_grid_labels(Image *image, RenderJob *job) {
+    double scale_x, scale_y;
+    job_scale(job, &scale_x, &scale_y);
+
+    double step_x = grid_spacing((float)(scale_x / GRID_PIXELS_PER_UNIT)) / GRID_PIXELS_PER_UNIT;
+    double step_y = grid_spacing((float)(scale_y / GRID_PIXELS_PER_UNIT)) / GRID_PIXELS_PER_UNIT;
+    float origin_x = (float)(-job->min_x * scale_x), origin_y = (float)(job->max_y * scale_y);
+    float row_y = grid_label_row_y(origin_y, (float)job->height), edge = grid_label_edge(origin_x, (float)job->width);
+    char text[32];
+
+    // Origin label stays visible at image edges along both axes, like in the window
+    int zero_width = raster_measure_text("0", GRID_LABEL_SIZE);
+    raster_text(image, "0", (int)grid_label_column_x(edge, zero_width), (int)row_y, GRID_LABEL_SIZE,
+                COLOR_BRIGHT_WHITE);
+
+    // Draw X labels on major lines, with as many digits as the window gives them
+    GridRange x_range = grid_range(job->min_x, job->max_x, step_x);
+    for (long i = x_range.first; i <= x_range.last; i++) {
+        if (i % GRID_MAJOR_STEP != 0 || i == 0) continue;
+
+        double value = i * step_x;
+        snprintf(text, sizeof(text), "%.*g", grid_label_digits(value, step_x * GRID_MAJOR_STEP), value);
+        int text_width = raster_measure_text(text, GRID_LABEL_SIZE);
+        float x = (float)((value - job->min_x) * scale_x);
+
+        raster_text(image, text, (int)x - text_width / 2, (int)row_y, GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+    }
+
+    // Draw Y labels on major lines
+    GridRange y_range = grid_range(job->min_y, job->max_y, step_y);
+    for (long i = y_range.first; i <= y_range.last; i++) {
+        if (i % GRID_MAJOR_STEP != 0 || i == 0) continue;
+
+        double value = i * step_y;
+        snprintf(text, sizeof(text), "%.*g", grid_label_digits(value, step_y * GRID_MAJOR_STEP), value);
+        int text_width = raster_measure_text(text, GRID_LABEL_SIZE);
+        float y = (float)((job->max_y - value) * scale_y);
+
+        raster_text(image, text, (int)grid_label_column_x(edge, text_width), (int)y - GRID_LABEL_SIZE / 2,
+                    GRID_LABEL_SIZE, COLOR_BRIGHT_WHITE);
+    }
+}
+
+void render_curve(Image *image, RenderJob *job, ParsedExpression *expression) {
+    double scale_x, scale_y;
+    job_scale(job, &scale_x, &scale_y);
+
+    // Sample until the curve is fully refined, finer axis setting the tolerance
+    SampleView view = {job->min_x, job->max_x, job->min_y, job->max_y, fmax(scale_x, scale_y)};
+    for (int i = 0; i < RENDER_MAX_UPDATES && sampler_update(expression, view, 0.0) > 0; i++);
+
+    // Vertical band kept when drawing, one image height beyond each edge
+    double band = job->max_y - job->min_y;
+    SamplePath *path = &expression->cache.path;
+
+    for (int i = 1; i < path->count; i++) {
+        SamplePoint p0 = path->points[i - 1], p1 = path->points[i];
+
+        // Breaks in the path are discontinuities or holes in the domain
+        if (isnan(p0.y) || isnan(p1.y)) continue;
+        if (!sample_clip_segment(&p0, &p1, job->min_y - band, job->max_y + band)) continue;
+
+        Vector2 start = {(float)((p0.x - job->min_x) * scale_x), (float)((job->max_y - p0.y) * scale_y)};
+        Vector2 end = {(float)((p1.x - job->min_x) * scale_x), (float)((job->max_y - p1.y) * scale_y)};
+        raster_line(image, start, end, LINE_THICKNESS, expression->color);
+    }
+}
+
+void render_legend(Image *image, RenderJob *job) {
+    int max_text_width = 0;
+    int non_null = 0;
+
+    // Get maximum text width and non-null expressions
+    for (int i = 0; i < job->count; i++) {
+        if (job->expressions[i].root == NULL) continue;
+        non_null++;
+
+        int text_width = raster_measure_text(job->expressions[i].text, LEGEND_ELEM_SIZE);
+        if (text_width > max_text_width) max_text_width = text_width;
+    }
+
+    // Draw legend box, laid out like the window's
+    Color color = COLOR_BRIGHT_BLACK;
+    color.a = LEGEND_OPACITY;
+    raster_rectangle(image, legend_box_rect(non_null, max_text_width), color);
+
+    // Draw legend entries
+    int row = 0;
+    for (int i = 0; i < job->count; i++) {
+        if (job->expressions[i].root == NULL) continue;
+
+        Rectangle toggle = legend_toggle_rect(row++);
+        raster_text(image, job->expressions[i].text, legend_text_x(), (int)toggle.y, LEGEND_ELEM_SIZE,
+                    COLOR_BRIGHT_WHITE);
+        raster_rectangle(image, toggle, job->expressions[i].color);
+    }
+}
+
+bool render_plot(RenderJob *job) {
+    Image image = GenImageColor(job->width, job->height, COLOR_BLACK);
+
+    // Same layers as the window, back to front
+    render_grid(&image, job);
+
+    for (int i = 0; i < job->count; i++) {
+        ParsedExpression *expression = &job->expressions[i];
+        if (expression->root == NULL) continue;
+
+        render_curve(&image, job, expression);
+
+        // Samples are only needed for this plot, the program belongs to the shared cache
+        sample_cache_free(&expression->cache);
+        sample_path_free(&expression->path);
+    }
+
+    render_grid_labels(&image, job);
+    render_legend(&image, job);
+
+    job->rendered = ExportImage(image, job->output);
+    if (!job->rendered) TraceLog(LOG_ERROR, "Unable to save '%s'", job->output);
+
+    UnloadImage(image);
+    return job->rendered;
+}
+
+static void render_task(void *arg) {
+    render_plot(arg);
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s --render OUTPUT [--view XMIN,XMAX,YMIN,YMAX] [--size WxH] [--scalar] EXPRESSION...\n",
+            program);
+    fprintf(stderr, "       %s --manifest FILE [--jobs N] [--scalar]\n", program);
+}
+
+int render_main(int argc, char **argv) {
+    Parser parser = parser_init();
+    ExpressionCache cache = {0};
+    RenderBatch batch = {0};
+    int threads = POOL_THREADS;
+    bool ok = true;
+
+    // Default view matches the window's initial camera
+    RenderJob job = {
+        .min_x = -WIDTH / 2.0 / GRID_PIXELS_PER_UNIT,
+        .max_x = WIDTH / 2.0 / GRID_PIXELS_PER_UNIT,
+        .min_y = -HEIGHT / 2.0 / GRID_PIXELS_PER_UNIT,
+        .max_y = HEIGHT / 2.0 / GRID_PIXELS_PER_UNIT,
+        .width = WIDTH,
+        .height = HEIGHT,
+    };
+
+    // Options come first, every argument after them is an expression
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--render") == 0 && has_value) job.output = argv[++i];
+        else if (strcmp(argv[i], "--view") == 0 && has_value && parse_view(argv[i + 1], &job)) i++;
+        else if (strcmp(argv[i], "--size") == 0 && has_value && parse_size(argv[i + 1], &job)) i++;
+        else if (strcmp(argv[i], "--jobs") == 0 && has_value) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scalar") == 0) continue; // Already applied to the kernels by main
+        else if (strcmp(argv[i], "--manifest") == 0 && has_value) {
+            if (!load_manifest(&batch, &cache, &parser, argv[++i])) ok = false;
+        } else {
+            print_usage(argv[0]);
+            parser_free(&parser);
+            return 1;
+        }
+    }
+
+    if (job.output != NULL && !add_job(&batch, &cache, &parser, job, argv + i, argc - i)) ok = false;
+
+    if (batch.count == 0) {
+        if (ok) print_usage(argv[0]);
+        parser_free(&parser);
+        return 1;
+    }
+
+    // Render plots in parallel, no window or GPU involved
+    pool_init(threads, expression_thread_free);
+    TraceLog(LOG_INFO, "Rendering %d plots with %d unique expressions on %d worker threads", batch.count, cache.count,
+             pool_thread_count());
+
+    // Waiting only runs render tasks, and a render task waiting on its evaluations only runs their chunks, so none
+    // starts inside another one on the same thread and its sampler scratch
+    double start = now();
+    TaskGroup group = {0};
+    for (int j = 0; j < batch.count; j++) pool_submit(&group, render_task, &batch.jobs[j]);
+    pool_wait(&group);
+    double elapsed = now() - start;
+
+    int rendered = 0;
+    for (int j = 0; j < batch.count; j++) rendered += batch.jobs[j].rendered;
+    TraceLog(LOG_INFO, "Rendered %d/%d plots in %.3f s (%.1f plots/s)", rendered, batch.count, elapsed,
+             rendered / elapsed);
+
+    // Cleanup, manifest jobs own their output names
+    pool_free();
+    expression_thread_free();
+    for (int j = 0; j < batch.count; j++) {
+        if (batch.jobs[j].output != job.output) free((char *)batch.jobs[j].output);
+        free(batch.jobs[j].expressions);
+    }
+    free(batch.jobs);
+    cache_free(&cache);
+    parser_free(&parser);
+
+    return ok && rendered == batch.count ? 0 : 1;
+}
@@ -0,0 +1,572 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "pool.h"
+#include "sampler.h"
+
+// Part of a column interval waiting for its midpoint
+typedef struct {
+    double x0, y0, s0; // Slopes are NaN where unknown
+    double x1, y1, s1;
+    int depth;
+    int interval;
+} Segment;
+
+// Growable array of segments
+typedef struct {
+    Segment *items;
+    int count;
+    int capacity;
+} SegmentList;
+
+// Point found while refining an interval
+typedef struct {
+    int interval;
+    SamplePoint point;
+} Found;
+
+// Slice of a batch evaluated by another worker
+typedef struct {
+    ParsedExpression *expression;
+    const double *xs;
+    double *ys;
+    double *slopes;
+    int count;
+} Chunk;
+
+// Scratch buffers reused across updates, one set per thread since updates run on the worker pool
+static _Thread_local struct {
+    SegmentList segments;
+    SegmentList next;
+    double *xs;
+    int x_capacity;
+    double *ys;
+    int y_capacity;
+    double *slopes;
+    int slope_capacity;
+    Found *found;
+    int found_count;
+    int found_capacity;
+    SamplePoint *points;
+    int point_capacity;
+    Chunk *chunks;
+    int chunk_capacity;
+} scratch;
+
+static void reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return;
+
+    *capacity = count * 2;
+    *buffer = realloc(*buffer, size * *capacity);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool expired(double deadline) {
+    return deadline > 0.0 && now() > deadline;
+}
+
+static bool is_finite(double y) {
+    return !isnan(y) && !isinf(y);
+}
+
+static void add_found(int interval, double x, double y) {
+    reserve((void **)&scratch.found, &scratch.found_capacity, scratch.found_count + 1, sizeof(Found));
+    scratch.found[scratch.found_count++] = (Found){interval, {x, is_finite(y) ? y : NAN}};
+}
+
+static int compare_found(const void *a, const void *b) {
+    const Found *fa = a, *fb = b;
+    if (fa->interval != fb->interval) return fa->interval < fb->interval ? -1 : 1;
+    return (fa->point.x > fb->point.x) - (fa->point.x < fb->point.x);
+}
+
+static void evaluate_values(ParsedExpression *expression, const double *xs, double *ys, double *slopes, int count) {
+    // Slopes come out of the same pass as the values, or stay unknown
+    if (expression->tangents) {
+        expression_evaluate_tangent(expression, xs, ys, slopes, count);
+        return;
+    }
+
+    expression_evaluate(expression, xs, ys, count);
+    for (int i = 0; i < count; i++) slopes[i] = NAN;
+}
+
+static void evaluate_chunk(void *arg) {
+    Chunk *chunk = arg;
+    evaluate_values(chunk->expression, chunk->xs, chunk->ys, chunk->slopes, chunk->count);
+}
+
+static void evaluate(ParsedExpression *expression, const double *xs, double *ys, double *slopes, int count) {
+    // Small batches aren't worth handing out
+    if (count < 2 * SAMPLE_CHUNK || pool_thread_count() == 0) {
+        evaluate_values(expression, xs, ys, slopes, count);
+        return;
+    }
+
+    // Split batch so idle workers can steal part of it, and help with it meanwhile
+    int chunks = (count + SAMPLE_CHUNK - 1) / SAMPLE_CHUNK;
+    reserve((void **)&scratch.chunks, &scratch.chunk_capacity, chunks, sizeof(Chunk));
+    Chunk *chunk = scratch.chunks;
+
+    TaskGroup group = {0};
+    for (int start = 0; start < count; start += SAMPLE_CHUNK, chunk++) {
+        int n = count - start < SAMPLE_CHUNK ? count - start : SAMPLE_CHUNK;
+        *chunk = (Chunk){expression, xs + start, ys + start, slopes + start, n};
+        pool_submit(&group, evaluate_chunk, chunk);
+    }
+
+    pool_wait(&group);
+}
+
+static double evaluate_point(ParsedExpression *expression, double x, double *slope) {
+    double y;
+    evaluate_values(expression, &x, &y, slope, 1);
+    return y;
+}
+
+static void evaluate_columns(ParsedExpression *expression, SampleRange range) {
+    SampleCache *cache = &expression->cache;
+
+    // Get X coordinates of every column in the range and evaluate them all at once
+    reserve((void **)&scratch.xs, &scratch.x_capacity, range.count, sizeof(double));
+    for (int i = 0; i < range.count; i++) scratch.xs[i] = (range.first + i) * cache->step;
+
+    // Columns are the same for every curve in view, so grouped curves evaluate them together
+    double *ys = cache->ys + (range.first - cache->first), *slopes = cache->slopes + (range.first - cache->first);
+    if (!expression_evaluate_columns(expression, cache->step, range.first, scratch.xs, ys, slopes, range.count))
+        evaluate(expression, scratch.xs, ys, slopes, range.count);
+
+    for (int i = 0; i < range.count; i++) sample_cache_fill(cache, (int)(range.first - cache->first) + i);
+}
+
+static bool coarse_column(SampleCache *cache, int column) {
+    // Every few lattice columns plus both ends, so the preview still spans the whole window
+    return (cache->first + column) % SAMPLE_COARSE_STRIDE == 0 || column == 0 || column == cache->count - 1;
+}
+
+static int evaluate_coarse(ParsedExpression *expression) {
+    SampleCache *cache = &expression->cache;
+    int count = 0;
+
+    reserve((void **)&scratch.xs, &scratch.x_capacity, cache->count, sizeof(double));
+    reserve((void **)&scratch.ys, &scratch.y_capacity, cache->count, sizeof(double));
+    reserve((void **)&scratch.slopes, &scratch.slope_capacity, cache->count, sizeof(double));
+    for (int i = 0; i < cache->count; i++) {
+        if (!cache->known[i] && coarse_column(cache, i)) scratch.xs[count++] = (cache->first + i) * cache->step;
+    }
+
+    evaluate(expression, scratch.xs, scratch.ys, scratch.slopes, count);
+
+    // Scatter the values back in the same order
+    for (int i = 0, j = 0; i < cache->count; i++) {
+        if (cache->known[i] || !coarse_column(cache, i)) continue;
+        cache->ys[i] = scratch.ys[j];
+        cache->slopes[i] = scratch.slopes[j++];
+        sample_cache_fill(cache, i);
+    }
+
+    return count;
+}
+
+static int fill_columns(ParsedExpression *expression, double deadline) {
+    SampleCache *cache = &expression->cache;
+    int evaluations = 0;
+
+    // After a zoom or a jump a sparse pass is drawn first, then filled in over the next updates
+    if (deadline > 0.0 && cache->unknown >= SAMPLE_FILL_COLUMNS) evaluations += evaluate_coarse(expression);
+
+    // Fill in blocks aligned to the lattice, so grouped curves ask for the same columns
+    long long last = cache->first + cache->count;
+    long long start = cache->first - (cache->first % SAMPLE_FILL_COLUMNS + SAMPLE_FILL_COLUMNS) % SAMPLE_FILL_COLUMNS;
+
+    for (; start < last && cache->unknown > 0; start += SAMPLE_FILL_COLUMNS) {
+        int from = (int)((start > cache->first ? start : cache->first) - cache->first);
+        int to = (int)((start + SAMPLE_FILL_COLUMNS < last ? start + SAMPLE_FILL_COLUMNS : last) - cache->first);
+
+        // Span of the block still unknown, evaluated at once even if it has coarse columns in it
+        while (from < to && cache->known[from]) from++;
+        while (to > from && cache->known[to - 1]) to--;
+        if (from == to) continue;
+
+        if (evaluations > 0 && expired(deadline)) break;
+        evaluate_columns(expression, (SampleRange){cache->first + from, to - from});
+        evaluations += to - from;
+    }
+
+    return evaluations;
+}
+
+static double turn_angle(SampleCache *cache, int column, double scale) {
+    // Angle between the segments meeting at a column, zero at the borders of the finite curve and of the cache,
+    // which lie past the view so the columns at its edges have both neighbors
+    if (column <= 0 || column >= cache->count - 1) return 0.0;
+
+    double y0 = cache->ys[column - 1], y1 = cache->ys[column], y2 = cache->ys[column + 1];
+    if (!is_finite(y0) || !is_finite(y1) || !is_finite(y2)) return 0.0;
+
+    double dx = cache->step * scale;
+    double dy0 = (y1 - y0) * scale, dy1 = (y2 - y1) * scale;
+    return fabs(atan2(dx * dy1 - dy0 * dx, dx * dx + dy0 * dy1));
+}
+
+static bool off_screen(SampleCache *cache, int interval, SampleView *view) {
+    // Both ends past the same edge, refined later if the view moves there
+    double y0 = cache->ys[interval], y1 = cache->ys[interval + 1];
+    return (y0 > view->max_y && y1 > view->max_y) || (y0 < view->min_y && y1 < view->min_y);
+}
+
+static bool suspicious_jump(SampleCache *cache, int interval, double scale) {
+    // Steep but smooth curves rise like their neighbors, discontinuities stand out or reverse
+    double dy = cache->ys[interval + 1] - cache->ys[interval];
+    if (fabs(dy) * scale <= SAMPLE_JUMP_PIXELS) return false;
+
+    for (int side = -1; side <= 1; side += 2) {
+        int neighbor = interval + side;
+        if (neighbor < 0 || neighbor >= cache->count - 1) continue;
+
+        double neighbor_dy = cache->ys[neighbor + 1] - cache->ys[neighbor];
+        if (!is_finite(neighbor_dy)) continue;
+        if (neighbor_dy * dy < 0.0 || fabs(dy) > SAMPLE_JUMP_RATIO * fabs(neighbor_dy)) return true;
+    }
+
+    return false;
+}
+
+static bool tangents_known(const Segment *segment) {
+    return is_finite(segment->s0) && is_finite(segment->s1);
+}
+
+static bool smooth_jump(const Segment *segment) {
+    // A smooth curve climbing this fast has comparable slopes of the same sign at both ends,
+    // while poles reverse them or leave them far below the jump
+    double secant = (segment->y1 - segment->y0) / (segment->x1 - segment->x0);
+    if (secant * segment->s0 <= 0.0 || secant * segment->s1 <= 0.0) return false;
+    return fabs(secant) <= SAMPLE_JUMP_RATIO * fmax(fabs(segment->s0), fabs(segment->s1));
+}
+
+static double tangent_deviation(const Segment *segment, double scale) {
+    // The cubic through both ends with their slopes strays from the chord by at most 4/27 of the width
+    // times how far the slopes turn from it, measured across the chord
+    double dx = segment->x1 - segment->x0;
+    double secant = (segment->y1 - segment->y0) / dx;
+    double turn = fabs(segment->s0 - secant) + fabs(segment->s1 - secant);
+    return 4.0 / 27.0 * dx * scale * turn / sqrt(1.0 + secant * secant);
+}
+
+static Segment column_segment(SampleCache *cache, int interval) {
+    double x0 = (cache->first + interval) * cache->step;
+    return (Segment){x0, cache->ys[interval], cache->slopes[interval], x0 + cache->step, cache->ys[interval + 1],
+                     cache->slopes[interval + 1], 0, interval};
+}
+
+static bool needs_refinement(SampleCache *cache, int interval, double scale) {
+    double y0 = cache->ys[interval], y1 = cache->ys[interval + 1];
+
+    // Edges of the domain must be located
+    if (is_finite(y0) != is_finite(y1)) return true;
+    if (!is_finite(y0)) return false;
+
+    // Slopes at both columns tell a steep curve from a discontinuity, and bound how far it bends between them
+    Segment segment = column_segment(cache, interval);
+    if (tangents_known(&segment)) {
+        if (fabs(y1 - y0) * scale > SAMPLE_JUMP_PIXELS && !smooth_jump(&segment)) return true;
+        return tangent_deviation(&segment, scale) > SAMPLE_TOLERANCE;
+    }
+
+    // Jumps may hide a discontinuity, and bends may hide detail
+    if (suspicious_jump(cache, interval, scale)) return true;
+    return turn_angle(cache, interval, scale) > SAMPLE_MAX_ANGLE ||
+           turn_angle(cache, interval + 1, scale) > SAMPLE_MAX_ANGLE;
+}
+
+static double segment_deviation(Segment *segment, double xm, double ym, double scale) {
+    // Distance in pixels between the midpoint and the chord, or how far it leaves the chord's vertical span
+    double dx = (segment->x1 - segment->x0) * scale, dy = (segment->y1 - segment->y0) * scale;
+    double px = (xm - segment->x0) * scale, py = (ym - segment->y0) * scale;
+    double distance = fabs(dx * py - dy * px) / sqrt(dx * dx + dy * dy);
+
+    double low = fmin(segment->y0, segment->y1), high = fmax(segment->y0, segment->y1);
+    double outside = fmax(low - ym, ym - high) * scale;
+
+    return fmax(distance, outside);
+}
+
+static int classify_jump(ParsedExpression *expression, Segment *segment, double scale) {
+    // Bisect toward the jump: it halves on continuous curves and stays put on discontinuities
+    double a = segment->x0, ya = segment->y0, sa = segment->s0;
+    double b = segment->x1, yb = segment->y1, sb = segment->s1;
+
+    for (int i = 0; i < SAMPLE_JUMP_ITERATIONS; i++) {
+        double m = (a + b) / 2.0, slope;
+        double ym = evaluate_point(expression, m, &slope);
+
+        // Holes in the domain break the curve too
+        if (!is_finite(ym)) {
+            add_found(segment->interval, m, NAN);
+            return i + 1;
+        }
+
+        if (fabs(ym - ya) > fabs(yb - ym)) {
+            b = m;
+            yb = ym;
+            sb = slope;
+        } else {
+            a = m;
+            ya = ym;
+            sa = slope;
+        }
+
+        if (fabs(yb - ya) * scale <= SAMPLE_JUMP_PIXELS) return i + 1;
+
+        // Stop once the slopes account for what's left of the jump, rather than waiting for it to shrink
+        Segment bracket = {a, ya, sa, b, yb, sb, 0, segment->interval};
+        if (tangents_known(&bracket) && smooth_jump(&bracket)) return i + 1;
+    }
+
+    // Bring the curve up to both sides of the discontinuity
+    add_found(segment->interval, a, ya);
+    add_found(segment->interval, (a + b) / 2.0, NAN);
+    add_found(segment->interval, b, yb);
+    return SAMPLE_JUMP_ITERATIONS;
+}
+
+static void push_segment(SegmentList *list, Segment segment) {
+    reserve((void **)&list->items, &list->capacity, list->count + 1, sizeof(Segment));
+    list->items[list->count++] = segment;
+}
+
+static int refine_group(ParsedExpression *expression, SampleView *view, int *next_interval) {
+    SampleCache *cache = &expression->cache;
+    double scale = view->scale;
+    int intervals = cache->count - 1;
+    int evaluations = 0;
+
+    scratch.segments.count = 0;
+    scratch.found_count = 0;
+
+    // Seed one segment per interval that shows detail, the rest are done as they are
+    int i = *next_interval;
+    for (; i < intervals && scratch.segments.count < SAMPLE_GROUP; i++) {
+        if (cache->intervals[i].refined || off_screen(cache, i, view)) continue;
+
+        if (!needs_refinement(cache, i, scale)) {
+            sample_cache_refine(cache, i, NULL, 0);
+            continue;
+        }
+
+        push_segment(&scratch.segments, column_segment(cache, i));
+    }
+    *next_interval = i;
+
+    // Split segments breadth-first so each level is evaluated as a single batch
+    while (scratch.segments.count > 0) {
+        SegmentList *list = &scratch.segments;
+        scratch.next.count = 0;
+
+        reserve((void **)&scratch.xs, &scratch.x_capacity, list->count, sizeof(double));
+        reserve((void **)&scratch.ys, &scratch.y_capacity, list->count, sizeof(double));
+        reserve((void **)&scratch.slopes, &scratch.slope_capacity, list->count, sizeof(double));
+        for (int j = 0; j < list->count; j++) scratch.xs[j] = (list->items[j].x0 + list->items[j].x1) / 2.0;
+
+        evaluate(expression, scratch.xs, scratch.ys, scratch.slopes, list->count);
+        evaluations += list->count;
+
+        for (int j = 0; j < list->count; j++) {
+            Segment *segment = &list->items[j];
+            double xm = scratch.xs[j], ym = scratch.ys[j], sm = scratch.slopes[j];
+            add_found(segment->interval, xm, ym);
+
+            Segment left = {segment->x0, segment->y0, segment->s0, xm, ym, sm, segment->depth + 1, segment->interval};
+            Segment right = {xm, ym, sm, segment->x1, segment->y1, segment->s1, segment->depth + 1, segment->interval};
+            bool finite0 = is_finite(segment->y0), finitem = is_finite(ym), finite1 = is_finite(segment->y1);
+
+            // Follow the edge of the domain down to a fraction of a pixel
+            if (finite0 != finitem || finitem != finite1) {
+                if (segment->depth + 1 >= SAMPLE_EDGE_DEPTH) continue;
+                if (finite0 != finitem) push_segment(&scratch.next, left);
+                if (finitem != finite1) push_segment(&scratch.next, right);
+                continue;
+            }
+
+            if (!finitem) continue;
+
+            // Split further while the curve strays from the segment, or its slopes say it may between samples
+            bool bent = segment_deviation(segment, xm, ym, scale) > SAMPLE_TOLERANCE;
+            if (!bent && tangents_known(&left) && tangents_known(&right))
+                bent = fmax(tangent_deviation(&left, scale), tangent_deviation(&right, scale)) > SAMPLE_TOLERANCE;
+
+            if (segment->depth + 1 < SAMPLE_MAX_DEPTH && bent) {
+                push_segment(&scratch.next, left);
+                push_segment(&scratch.next, right);
+                continue;
+            }
+
+            // Finest level reached, only tall jumps their slopes can't account for are left to classify
+            for (int side = 0; side < 2; side++) {
+                Segment *half = side == 0 ? &left : &right;
+                if (fabs(half->y1 - half->y0) * scale <= SAMPLE_JUMP_PIXELS) continue;
+                if (tangents_known(half) && smooth_jump(half)) continue;
+                evaluations += classify_jump(expression, half, scale);
+            }
+        }
+
+        // Next level becomes the current one
+        SegmentList current = scratch.segments;
+        scratch.segments = scratch.next;
+        scratch.next = current;
+    }
+
+    // Store points of every interval in order
+    qsort(scratch.found, scratch.found_count, sizeof(Found), compare_found);
+
+    for (int start = 0, end; start < scratch.found_count; start = end) {
+        int interval = scratch.found[start].interval;
+        for (end = start; end < scratch.found_count && scratch.found[end].interval == interval; end++);
+
+        int n = end - start;
+        reserve((void **)&scratch.points, &scratch.point_capacity, n, sizeof(SamplePoint));
+        for (int j = 0; j < n; j++) scratch.points[j] = scratch.found[start + j].point;
+        sample_cache_refine(cache, interval, scratch.points, n);
+    }
+
+    return evaluations;
+}
+
+static int refine(ParsedExpression *expression, SampleView *view, double deadline) {
+    int intervals = expression->cache.count - 1;
+    int budget = SAMPLE_BUDGET * expression->cache.count; // Follows the columns in view, so the window's size
+    int evaluations = 0;
+
+    // Groups always finish so every update makes progress, the rest waits for the next update
+    for (int next = 0; next < intervals && evaluations < budget && (evaluations == 0 || !expired(deadline));)
+        evaluations += refine_group(expression, view, &next);
+
+    return evaluations;
+}
+
+static bool within_tolerance(SamplePoint *path, int from, int to, double scale) {
+    // Check every point skipped by the chord between two path points
+    double dx = (path[to].x - path[from].x) * scale, dy = (path[to].y - path[from].y) * scale;
+    double length = sqrt(dx * dx + dy * dy);
+    if (length == 0.0) return true;
+
+    for (int i = from + 1; i < to; i++) {
+        double px = (path[i].x - path[from].x) * scale, py = (path[i].y - path[from].y) * scale;
+        if (fabs(dx * py - dy * px) / length > SAMPLE_TOLERANCE) return false;
+    }
+
+    return true;
+}
+
+static void merge_flat_runs(SampleCache *cache, double scale) {
+    SamplePoint *path = cache->path.points;
+    int n = cache->path.count, out = 0;
+
+    for (int i = 0; i < n;) {
+        // Collapse consecutive breaks
+        if (isnan(path[i].y)) {
+            if (out == 0 || !isnan(path[out - 1].y)) path[out++] = path[i];
+            i++;
+            continue;
+        }
+
+        // Extend the segment from this point as long as it stays on the curve
+        path[out++] = path[i];
+        int end = i + 1;
+        while (end + 1 < n && end + 1 - i <= SAMPLE_MERGE_RUN && !isnan(path[end].y) && !isnan(path[end + 1].y) &&
+               within_tolerance(path, i, end + 1, scale)) {
+            end++;
+        }
+
+        i = end;
+    }
+
+    cache->path.count = out;
+}
+
+static void build_path(SampleCache *cache, double scale) {
+    cache->path.count = 0;
+
+    // Interleave columns with the points refined between them, skipping columns a coarse pass left out
+    for (int i = 0; i < cache->count; i++) {
+        if (!cache->known[i]) continue;
+
+        double y = cache->ys[i];
+        sample_path_push(&cache->path, (SamplePoint){(cache->first + i) * cache->step, is_finite(y) ? y : NAN});
+        if (i == cache->count - 1) continue;
+
+        SampleInterval *interval = &cache->intervals[i];
+        for (int j = 0; j < interval->count; j++) sample_path_push(&cache->path, cache->points[interval->start + j]);
+    }
+
+    merge_flat_runs(cache, scale);
+    cache->path.version = ++cache->version;
+    cache->changed = false;
+}
+
+int sampler_update(ParsedExpression *expression, SampleView view, double budget) {
+    SampleCache *cache = &expression->cache;
+    double deadline = budget > 0.0 ? now() + budget : 0.0;
+    int evaluations = 0;
+
+    // Evaluate columns on a lattice fixed in math space, so pans reuse them
+    double step = SAMPLE_COLUMN_STEP / view.scale;
+    long long first = (long long)floor(view.min_x / step) - SAMPLE_EDGE_COLUMNS;
+    long long last = (long long)ceil(view.max_x / step) + SAMPLE_EDGE_COLUMNS;
+
+    if (sample_cache_move(cache, step, first, (int)(last - first + 1)) > 0)
+        evaluations += fill_columns(expression, deadline);
+
+    // Refine intervals still missing detail once every column is in, so the result doesn't depend on the budget
+    if (cache->unknown == 0 && (evaluations == 0 || !expired(deadline)))
+        evaluations += refine(expression, &view, deadline);
+    if (cache->changed) build_path(cache, view.scale);
+
+    return evaluations;
+}
+
+static void sample_job(void *arg) {
+    ParsedExpression *expression = arg;
+    int evaluations = sampler_update(expression, expression->view, SAMPLE_TIME_BUDGET);
+
+    atomic_fetch_add_explicit(&expression->evaluations, evaluations, memory_order_relaxed);
+    expression->settled = evaluations == 0;
+}
+
+void sampler_schedule(ParsedExpression *expression, SampleView view) {
+    // Renderer keeps drawing the published path while a job is running
+    if (pool_busy(&expression->job)) return;
+
+    // The finished job no longer touches its path, so it can be swapped with the published one
+    SampleCache *cache = &expression->cache;
+    if (cache->path.version > expression->path.version) {
+        SamplePath published = expression->path;
+        expression->path = cache->path;
+        cache->path = published;
+    }
+
+    // Nothing left to do until the view moves
+    SampleView *last = &expression->view;
+    bool moved = last->min_x != view.min_x || last->max_x != view.max_x || last->min_y != view.min_y ||
+                 last->max_y != view.max_y || last->scale != view.scale;
+    if (expression->settled && !moved) return;
+
+    expression->view = view;
+    expression->settled = false;
+    pool_submit(&expression->job, sample_job, expression);
+}
+
+bool sampler_pending(ParsedExpression *expression) {
+    // The job's path can only be read once it's done
+    if (pool_busy(&expression->job)) return true;
+    return !expression->settled || expression->cache.path.version > expression->path.version;
+}
@@ -0,0 +1,177 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "samples.h"
+
+static void reserve_points(SampleCache *cache, int count) {
+    if (count <= cache->point_capacity) return;
+
+    // Grow both pools together so compaction always fits
+    while (cache->point_capacity < count) cache->point_capacity = cache->point_capacity == 0 ? 256 : cache->point_capacity * 2;
+    cache->points = realloc(cache->points, sizeof(SamplePoint) * cache->point_capacity);
+    cache->spare_points = realloc(cache->spare_points, sizeof(SamplePoint) * cache->point_capacity);
+}
+
+static void compact_points(SampleCache *cache) {
+    // Copy points of refined intervals into the spare pool, then swap pools
+    int count = 0;
+    for (int i = 0; i < cache->count - 1; i++) {
+        SampleInterval *interval = &cache->intervals[i];
+        if (!interval->refined) continue;
+
+        memcpy(cache->spare_points + count, cache->points + interval->start, sizeof(SamplePoint) * interval->count);
+        interval->start = count;
+        count += interval->count;
+    }
+
+    SamplePoint *points = cache->points;
+    cache->points = cache->spare_points;
+    cache->spare_points = points;
+    cache->point_count = count;
+}
+
+int sample_cache_move(SampleCache *cache, double step, long long first, int count) {
+    // Nothing to do if the window didn't change
+    if (cache->valid && cache->step == step && cache->first == first && cache->count == count) return cache->unknown;
+
+    // Grow storage if needed
+    if (count > cache->capacity) {
+        cache->capacity = count;
+        cache->ys = realloc(cache->ys, sizeof(double) * count);
+        cache->slopes = realloc(cache->slopes, sizeof(double) * count);
+        cache->known = realloc(cache->known, sizeof(bool) * count);
+        cache->intervals = realloc(cache->intervals, sizeof(SampleInterval) * count);
+    }
+
+    // A different step means a zoom, so nothing can be reused
+    if (cache->valid && cache->step != step) sample_cache_invalidate(cache);
+
+    long long old_first = cache->first;
+    long long old_last = cache->first + cache->count;
+    long long last = first + count;
+
+    cache->step = step;
+    cache->first = first;
+    cache->count = count;
+    cache->changed = true;
+
+    // Evaluate everything without overlap
+    if (!cache->valid || old_last <= first || last <= old_first) {
+        cache->valid = true;
+        cache->point_count = 0;
+        memset(cache->known, 0, sizeof(bool) * count);
+        memset(cache->intervals, 0, sizeof(SampleInterval) * count);
+
+        cache->unknown = count;
+        return count;
+    }
+
+    // Shift overlapping columns and the intervals between them into place
+    long long keep_first = old_first > first ? old_first : first;
+    long long keep_last = old_last < last ? old_last : last;
+    int kept = (int)(keep_last - keep_first);
+
+    memmove(cache->ys + (keep_first - first), cache->ys + (keep_first - old_first), sizeof(double) * kept);
+    memmove(cache->slopes + (keep_first - first), cache->slopes + (keep_first - old_first), sizeof(double) * kept);
+    memmove(cache->known + (keep_first - first), cache->known + (keep_first - old_first), sizeof(bool) * kept);
+    memmove(cache->intervals + (keep_first - first), cache->intervals + (keep_first - old_first),
+            sizeof(SampleInterval) * (kept - 1));
+
+    // Intervals touching new columns still need refinement, and so do the ones next to an old edge the window
+    // grew past, which were checked without the neighbor beyond it
+    bool grew_left = first < old_first, grew_right = last > old_last;
+    for (int i = 0; i < count - 1; i++) {
+        long long index = first + i;
+        if (index < keep_first || index + 1 >= keep_last || (grew_left && index == keep_first) ||
+            (grew_right && index + 2 == keep_last))
+            cache->intervals[i] = (SampleInterval){0};
+    }
+
+    compact_points(cache);
+
+    // Newly exposed columns on either side, plus any the last window hadn't filled in yet
+    cache->unknown = 0;
+    for (int i = 0; i < count; i++) {
+        long long index = first + i;
+        if (index < keep_first || index >= keep_last) cache->known[i] = false;
+        if (!cache->known[i]) cache->unknown++;
+    }
+
+    return cache->unknown;
+}
+
+void sample_cache_fill(SampleCache *cache, int column) {
+    if (cache->known[column]) return;
+
+    cache->known[column] = true;
+    cache->unknown--;
+    cache->changed = true;
+}
+
+void sample_cache_refine(SampleCache *cache, int interval, const SamplePoint *points, int count) {
+    reserve_points(cache, cache->point_count + count);
+    if (count > 0) memcpy(cache->points + cache->point_count, points, sizeof(SamplePoint) * count);
+
+    cache->intervals[interval] = (SampleInterval){cache->point_count, count, true};
+    cache->point_count += count;
+    cache->changed = true;
+}
+
+void sample_path_push(SamplePath *path, SamplePoint point) {
+    // Grow path array if needed
+    if (path->count == path->capacity) {
+        path->capacity = path->capacity == 0 ? 1024 : path->capacity * 2;
+        path->points = realloc(path->points, sizeof(SamplePoint) * path->capacity);
+    }
+
+    path->points[path->count++] = point;
+}
+
+bool sample_clip_segment(SamplePoint *p0, SamplePoint *p1, double min_y, double max_y) {
+    double t0 = 0.0, t1 = 1.0, dy = p1->y - p0->y;
+
+    if (dy == 0.0) return p0->y >= min_y && p0->y <= max_y;
+
+    double ta = (min_y - p0->y) / dy, tb = (max_y - p0->y) / dy;
+    if (ta > tb) {
+        double t = ta;
+        ta = tb;
+        tb = t;
+    }
+
+    t0 = fmax(t0, ta);
+    t1 = fmin(t1, tb);
+    if (t0 > t1) return false;
+
+    // Ends inside the band are kept exactly, interpolating them could move them by an ulp and break the run
+    SamplePoint a = *p0, b = *p1;
+    if (t0 > 0.0) *p0 = (SamplePoint){a.x + (b.x - a.x) * t0, a.y + dy * t0};
+    if (t1 < 1.0) *p1 = (SamplePoint){a.x + (b.x - a.x) * t1, a.y + dy * t1};
+    return true;
+}
+
+void sample_path_free(SamplePath *path) {
+    free(path->points);
+    *path = (SamplePath){0};
+}
+
+void sample_cache_invalidate(SampleCache *cache) {
+    cache->valid = false;
+    cache->count = 0;
+    cache->unknown = 0;
+    cache->point_count = 0;
+    cache->path.count = 0;
+    cache->changed = true;
+}
+
+void sample_cache_free(SampleCache *cache) {
+    free(cache->ys);
+    free(cache->slopes);
+    free(cache->known);
+    free(cache->intervals);
+    free(cache->points);
+    free(cache->spare_points);
+    sample_path_free(&cache->path);
+    *cache = (SampleCache){0};
+}
@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <raylib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "series.h"
+
+// State of the reader thread between two reads
+typedef struct {
+    char pending[SERIES_MAX_LINE]; // Unfinished line, or bytes of an unfinished value
+    int pending_length;
+    long long index;               // X of the next point without one
+    double last_x;
+    long long dropped;
+    SamplePoint *points;
+    int count;
+} Reader;
+
+static SamplePoint *point_at(DataSeries *series, long long index) {
+    return &series->points[index % series->capacity];
+}
+
+static void push_point(DataSeries *series, SamplePoint point) {
+    // Grow ring until it reaches the window, nothing has wrapped around before that
+    if (series->total == series->capacity && series->capacity < series->window) {
+        long long capacity = series->capacity == 0 ? 64 * SERIES_BLOCK : series->capacity * 2;
+        series->capacity = capacity < series->window ? capacity : series->window;
+        series->points = realloc(series->points, sizeof(SamplePoint) * series->capacity);
+        series->blocks = realloc(series->blocks, sizeof(SeriesBlock) * (series->capacity / SERIES_BLOCK));
+    }
+
+    // Start a block summary when its first point is written
+    long long slot = series->total % series->capacity;
+    SeriesBlock *block = &series->blocks[slot / SERIES_BLOCK];
+    if (slot % SERIES_BLOCK == 0) *block = (SeriesBlock){series->total, series->total, INFINITY, -INFINITY, false};
+
+    if (isnan(point.y)) block->has_nan = true;
+    if (point.y < block->min_y) {
+        block->min_y = point.y;
+        block->min_index = series->total;
+    }
+    if (point.y > block->max_y) {
+        block->max_y = point.y;
+        block->max_index = series->total;
+    }
+
+    series->points[slot] = point;
+    series->total++;
+}
+
+static void add_point(Reader *reader, double x, double y) {
+    // Decimation relies on x only going forward
+    if (x < reader->last_x) {
+        reader->dropped++;
+        return;
+    }
+
+    reader->last_x = x;
+    reader->points[reader->count++] = (SamplePoint){x, isinf(y) ? NAN : y};
+}
+
+int series_parse_line(const char *line, double values[2]) {
+    // Skip blank lines, comments and headers
+    char *end;
+    values[0] = strtod(line, &end);
+    if (end == line) return 0;
+
+    // Another value after a separator makes the first one x
+    const char *gap = end;
+    while (*end == ' ' || *end == '\t') end++;
+    bool spaced = end > gap && *end != '\0' && *end != '\r';
+    if (*end == ',' || *end == ';' || spaced) {
+        if (*end == ',' || *end == ';') end++;
+
+        const char *value = end;
+        values[1] = strtod(value, &end);
+        if (end == value) values[1] = NAN;
+        return 2;
+    }
+
+    return 1;
+}
+
+static void parse_line(Reader *reader, const char *line) {
+    double values[2];
+    int count = series_parse_line(line, values);
+
+    if (count == 2) add_point(reader, values[0], values[1]);
+    else if (count == 1) add_point(reader, (double)reader->index++, values[0]);
+}
+
+static void parse_text(Reader *reader, const char *data, int length) {
+    for (int i = 0; i < length; i++) {
+        if (data[i] != '\n') {
+            // Overlong lines are cut short rather than overflowing
+            if (reader->pending_length < SERIES_MAX_LINE - 1) reader->pending[reader->pending_length++] = data[i];
+            continue;
+        }
+
+        reader->pending[reader->pending_length] = '\0';
+        parse_line(reader, reader->pending);
+        reader->pending_length = 0;
+    }
+}
+
+static void parse_binary(Reader *reader, const char *data, int length) {
+    for (int i = 0; i < length; i++) {
+        reader->pending[reader->pending_length++] = data[i];
+        if (reader->pending_length < (int)sizeof(double)) continue;
+
+        double y;
+        memcpy(&y, reader->pending, sizeof(double));
+        add_point(reader, (double)reader->index++, y);
+        reader->pending_length = 0;
+    }
+}
+
+static void *read_series(void *arg) {
+    DataSeries *series = arg;
+    static _Thread_local char buffer[SERIES_READ_SIZE];
+
+    // Every byte could end a line, so a read never holds more points than bytes
+    Reader reader = {.last_x = -INFINITY, .points = malloc(sizeof(SamplePoint) * SERIES_READ_SIZE)};
+
+    while (!atomic_load(&series->stopping)) {
+        // Wake up regularly to notice when the window closes
+        struct pollfd descriptor = {series->fd, POLLIN, 0};
+        if (poll(&descriptor, 1, SERIES_POLL_MS) == 0) continue;
+
+        ssize_t length = read(series->fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) continue;
+        if (length < 0) {
+            TraceLog(LOG_WARNING, "Unable to read data series: %s", strerror(errno));
+            break;
+        }
+
+        // Input is done at EOF, unless a file is followed as it's appended to
+        if (length == 0) {
+            if (!series->follow) break;
+            nanosleep(&(struct timespec){0, SERIES_POLL_MS * 1000000L}, NULL);
+            continue;
+        }
+
+        reader.count = 0;
+        if (series->binary) parse_binary(&reader, buffer, (int)length);
+        else parse_text(&reader, buffer, (int)length);
+        if (reader.count == 0) continue;
+
+        pthread_mutex_lock(&series->lock);
+        for (int i = 0; i < reader.count; i++) push_point(series, reader.points[i]);
+        pthread_mutex_unlock(&series->lock);
+        atomic_fetch_add(&series->version, 1);
+    }
+
+    // Last line of a pipe may not end with a newline
+    if (!series->binary && reader.pending_length > 0) {
+        reader.count = 0;
+        parse_text(&reader, "\n", 1);
+
+        pthread_mutex_lock(&series->lock);
+        for (int i = 0; i < reader.count; i++) push_point(series, reader.points[i]);
+        pthread_mutex_unlock(&series->lock);
+        atomic_fetch_add(&series->version, 1);
+    }
+
+    if (reader.dropped > 0) TraceLog(LOG_WARNING, "Dropped %lld data points going back in x", reader.dropped);
+
+    free(reader.points);
+    atomic_store(&series->live, false);
+    return NULL;
+}
+
+bool series_open(DataSeries *series, const char *path, bool binary, bool follow, long long window) {
+    *series = (DataSeries){.binary = binary};
+
+    series->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (series->fd < 0) {
+        TraceLog(LOG_ERROR, "Unable to open data file '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat info;
+    series->follow = follow && fstat(series->fd, &info) == 0 && S_ISREG(info.st_mode);
+
+    // Window is kept in whole blocks
+    if (window < SERIES_BLOCK) window = SERIES_BLOCK;
+    series->window = (window + SERIES_BLOCK - 1) / SERIES_BLOCK * SERIES_BLOCK;
+
+    pthread_mutex_init(&series->lock, NULL);
+    atomic_init(&series->stopping, false);
+    atomic_init(&series->live, true);
+    atomic_init(&series->version, 0);
+    pthread_create(&series->reader, NULL, read_series, series);
+
+    return true;
+}
+
+static long long lower_bound(DataSeries *series, long long first, long long last, double x) {
+    // First index in the range with a point at or past x
+    while (first < last) {
+        long long middle = first + (last - first) / 2;
+        if (point_at(series, middle)->x < x) first = middle + 1;
+        else last = middle;
+    }
+
+    return first;
+}
+
+// Extremes of the points falling in one pixel column
+typedef struct {
+    long long column;
+    long long min_index;
+    long long max_index;
+    double min_y;
+    double max_y;
+    bool used;
+} Column;
+
+static void flush_column(DataSeries *series, Column *column, SamplePath *path) {
+    if (!column->used) return;
+
+    // Keep both extremes in the order they were received
+    long long first = column->min_index < column->max_index ? column->min_index : column->max_index;
+    long long last = column->min_index < column->max_index ? column->max_index : column->min_index;
+    sample_path_push(path, *point_at(series, first));
+    if (last != first) sample_path_push(path, *point_at(series, last));
+
+    column->used = false;
+}
+
+static void add_to_column(Column *column, long long index_min, double min_y, long long index_max, double max_y) {
+    if (!column->used || min_y < column->min_y) {
+        column->min_y = min_y;
+        column->min_index = index_min;
+    }
+    if (!column->used || max_y > column->max_y) {
+        column->max_y = max_y;
+        column->max_index = index_max;
+    }
+
+    column->used = true;
+}
+
+void series_decimate(DataSeries *series, SampleView view, SamplePath *path) {
+    series->drawn_version = atomic_load(&series->version);
+    path->count = 0;
+
+    pthread_mutex_lock(&series->lock);
+    long long start = series->total > series->capacity ? series->total - series->capacity : 0;
+    long long end = series->total;
+
+    // Visible points plus one on each side, so lines leave the screen
+    long long first = lower_bound(series, start, end, view.min_x);
+    long long last = lower_bound(series, first, end, view.max_x);
+    if (first > start) first--;
+    if (last < end) last++;
+
+    // Columns are fixed in math space, so panning doesn't change which points they keep
+    double width = 1.0 / view.scale;
+    Column column = {0};
+
+    for (long long i = first; i < last;) {
+        SamplePoint *point = point_at(series, i);
+
+        // Whole blocks inside one column are merged from their summary
+        if (i % SERIES_BLOCK == 0 && i + SERIES_BLOCK <= last) {
+            SeriesBlock *block = &series->blocks[(i % series->capacity) / SERIES_BLOCK];
+            long long from = (long long)floor(point->x / width);
+            long long to = (long long)floor(point_at(series, i + SERIES_BLOCK - 1)->x / width);
+
+            if (!block->has_nan && from == to) {
+                if (column.used && column.column != from) flush_column(series, &column, path);
+                column.column = from;
+                add_to_column(&column, block->min_index, block->min_y, block->max_index, block->max_y);
+                i += SERIES_BLOCK;
+                continue;
+            }
+        }
+
+        // Gaps in the data break the line
+        if (isnan(point->y)) {
+            flush_column(series, &column, path);
+            if (path->count > 0 && !isnan(path->points[path->count - 1].y)) sample_path_push(path, *point);
+            i++;
+            continue;
+        }
+
+        long long index = (long long)floor(point->x / width);
+        if (column.used && column.column != index) flush_column(series, &column, path);
+        column.column = index;
+        add_to_column(&column, i, point->y, i, point->y);
+        i++;
+    }
+
+    flush_column(series, &column, path);
+    pthread_mutex_unlock(&series->lock);
+
+    path->version++;
+}
+
+bool series_pending(DataSeries *series) {
+    return atomic_load(&series->version) != series->drawn_version;
+}
+
+bool series_live(DataSeries *series) {
+    return atomic_load(&series->live);
+}
+
+void series_close(DataSeries *series) {
+    atomic_store(&series->stopping, true);
+    pthread_join(series->reader, NULL);
+
+    if (series->fd != STDIN_FILENO) close(series->fd);
+    pthread_mutex_destroy(&series->lock);
+    free(series->points);
+    free(series->blocks);
+    *series = (DataSeries){0};
+}
@@ -1,9 +1,15 @@
+#include <math.h>
 #include <raylib.h>
 #include <stdbool.h>
 
+#include "analysis.h"
 #include "common.h"
+#include "display.h"
+#include "profiler.h"
 #include "update.h"
 
+WorldOrigin world_origin;
+
 static void pan_delta(Camera2D *camera, Vector2 delta, bool shortcut) {
     // Pan by given delta vector
     float sensitivity = shortcut ? PAN_SHORTCUT_SENSITIVITY : PAN_SENSITIVITY;
@@ -19,23 +25,52 @@ static void zoom_log_scaling(Camera2D *camera, float value, bool shortcut) {
 }
 
 void camera_reset(Camera2D *camera) {
+    // Initial target is relative to the math origin
+    world_origin = (WorldOrigin){.version = world_origin.version + 1};
+
     camera->zoom = CAMERA_INITIAL_ZOOM;
     camera->rotation = CAMERA_INITIAL_ROTATION;
     camera->target = CAMERA_INITIAL_TARGET;
-    camera->offset = CAMERA_OFFSET_CENTER;
+    camera->offset = display_center();
+}
+
+bool camera_rebase(Camera2D *camera) {
+    // Floats place points near the target to a small fraction of a pixel, however far the zoom goes
+    Vector2 distance = Vector2Scale(camera->target, camera->zoom);
+    if (fabsf(distance.x) <= CAMERA_REBASE_PIXELS && fabsf(distance.y) <= CAMERA_REBASE_PIXELS) return false;
+
+    // Move the origin under the target in doubles, world y grows downwards
+    world_origin.x += camera->target.x / (double)GRID_PIXELS_PER_UNIT;
+    world_origin.y -= camera->target.y / (double)GRID_PIXELS_PER_UNIT;
+    world_origin.version++;
+    camera->target = (Vector2){0, 0};
+
+    return true;
 }
 
-void pan(Camera2D *camera) {
+bool resize(Camera2D *camera) {
+    // Keep the point at the center of the window in place
+    Vector2 center_world = GetScreenToWorld2D(display_center(), *camera);
+    if (!display_update()) return false;
+
+    camera->offset = display_center();
+    camera->target = center_world;
+    return true;
+}
+
+bool pan(Camera2D *camera) {
     // Left click to pan
-    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
-        pan_delta(camera, GetMouseDelta(), false);
-    }
+    Vector2 delta = GetMouseDelta();
+    if (!IsMouseButtonDown(MOUSE_BUTTON_LEFT) || (delta.x == 0 && delta.y == 0)) return false;
+
+    pan_delta(camera, delta, false);
+    return true;
 }
 
-void zoom(Camera2D *camera) {
+bool zoom(Camera2D *camera) {
     // Mouse wheel to zoom
     float wheel = GetMouseWheelMove();
-    if (wheel == 0) return;
+    if (wheel == 0) return false;
 
     // Make cursor point match in screen space and world space
     Vector2 mouse_world = GetScreenToWorld2D(GetMousePosition(), *camera);
@@ -43,9 +78,10 @@ void zoom(Camera2D *camera) {
     camera->target = mouse_world;
 
     zoom_log_scaling(camera, wheel, false);
+    return true;
 }
 
-void shortcuts(Camera2D *camera) {
+bool shortcuts(Camera2D *camera) {
     /* ---------------------------------- Pan ----------------------------------- */
     Vector2 delta = {0, 0};
     if (IsKeyDown(KEY_UP) || IsKeyDown(KEY_W))    delta.y = 1;  // Arrow up / W
@@ -56,7 +92,7 @@ void shortcuts(Camera2D *camera) {
     pan_delta(camera, delta, true);
 
     /* ---------------------------------- Zoom ---------------------------------- */
-    Vector2 center_screen = {WIDTH / 2.0f, HEIGHT / 2.0f};
+    Vector2 center_screen = display_center();
     Vector2 center_world = GetScreenToWorld2D(center_screen, *camera);
     camera->offset = center_screen;
     camera->target = center_world;
@@ -68,7 +104,16 @@ void shortcuts(Camera2D *camera) {
     zoom_log_scaling(camera, zoom, true);
 
     /* --------------------------------- Reset ---------------------------------- */
-    if (IsKeyPressed(KEY_SPACE)) {
+    bool reset = IsKeyPressed(KEY_SPACE);
+    if (reset) {
         camera_reset(camera);
     }
+
+    /* -------------------------------- Markers --------------------------------- */
+    if (IsKeyPressed(KEY_M)) analysis_toggle_markers(); // Drawn over the cached frame too
+
+    /* -------------------------------- Profiler -------------------------------- */
+    if (IsKeyPressed(KEY_F3)) profiler_toggle_overlay(); // Drawn over the cached frame, the view is unchanged
+
+    return delta.x != 0 || delta.y != 0 || zoom != 0.0f || reset;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include <raylib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pyramid.h"
+
+int main(int argc, char **argv) {
+    // Check number of args
+    bool binary = argc > 1 && strcmp(argv[1], "--binary") == 0;
+    if (argc != (binary ? 4 : 3)) {
+        fprintf(stderr, "Usage: %s [--binary] INPUT|- OUTPUT\n", argv[0]);
+        return 1;
+    }
+
+    const char *input_path = argv[binary ? 2 : 1];
+    const char *output_path = argv[binary ? 3 : 2];
+
+    // Input has the same layout as data series, CSV or raw float64 y values
+    FILE *input = strcmp(input_path, "-") == 0 ? stdin : fopen(input_path, binary ? "rb" : "r");
+    if (input == NULL) {
+        fprintf(stderr, "Unable to open '%s'\n", input_path);
+        return 1;
+    }
+
+    bool built = pyramid_build(input, binary, output_path);
+    if (input != stdin) fclose(input);
+
+    return built ? 0 : 1;
+}